@@ -86,6 +86,10 @@ bool DisassemblyControl::is_conditional_branch_instruction(const cs_insn& insn)
     case ARM64_INS_BC:    // 条件分支
       return true;
 
+    // b.cond 与 b 共用指令 ID, 只能靠条件码区分
+    case ARM64_INS_B:
+      return insn.detail != nullptr && insn.detail->arm64.cc != ARM64_CC_INVALID && insn.detail->arm64.cc != ARM64_CC_AL;
+
     default:
       return false;
   }
@@ -108,7 +112,7 @@ bool DisassemblyControl::is_return_instruction(const cs_insn& insn)
 }
 
 // 线程反汇编, 当遇到跳转指令时重新反汇编
-std::optional<std::vector<Instruction>> DisassemblyControl::disassemble(const std::vector<char>& codes)
+std::optional<std::vector<Instruction>> DisassemblyControl::disassemble(const std::vector<char>& codes, uint64_t address)
 {
   if (handle_== 0) 
   {
@@ -125,7 +129,7 @@ std::optional<std::vector<Instruction>> DisassemblyControl::disassemble(const st
   size_t count = 0;
 
   count = cs_disasm(handle_, (const uint8_t*)codes.data(), 
-  codes.size(), 0, 0, &insn_array);
+  codes.size(), address, 0, &insn_array);
 
   if (count == 0 || insn_array == nullptr)
   {
@@ -142,10 +146,10 @@ std::optional<std::vector<Instruction>> DisassemblyControl::disassemble(const st
     Instruction::Type type;
     if (insn.id == ARM64_INS_INVALID)
       type = Instruction::Type::UNKNOWN;
-    else if (is_unconditional_branch_instruction(insn))
-      type = Instruction::Type::UNCONDITIONAL_BRANCH;
     else if (is_conditional_branch_instruction(insn))
       type = Instruction::Type::CONDITIONAL_BRANCH;
+    else if (is_unconditional_branch_instruction(insn))
+      type = Instruction::Type::UNCONDITIONAL_BRANCH;
     else if (is_return_instruction(insn))
       type = Instruction::Type::RETURN;
     else if (is_syscall_instruction(insn))
@@ -157,10 +161,12 @@ std::optional<std::vector<Instruction>> DisassemblyControl::disassemble(const st
 
     Operand ops[8] = {};
     uint8_t op_count = 0;
+    int32_t cc = 0;
 
     if (insn.detail != nullptr)
     {
       const cs_arm64& arm64 = insn.detail->arm64;
+      cc = static_cast<int32_t>(arm64.cc);
       op_count = std::min(arm64.op_count, (uint8_t)8);
       for (uint8_t j = 0; j < op_count; j++)
       {
@@ -211,7 +217,7 @@ std::optional<std::vector<Instruction>> DisassemblyControl::disassemble(const st
       return std::nullopt;
     }
       
-    results.emplace_back(type, data, insn.mnemonic, insn.op_str, ops, op_count);
+    results.emplace_back(type, insn.id, insn.address, cc, data, insn.mnemonic, insn.op_str, ops, op_count);
   }
 
   // 用完必须手动释放
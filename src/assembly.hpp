@@ -44,6 +44,9 @@ struct Instruction
   };
 
   Type type;           // 指令类型
+  uint32_t id = 0;                // capstone 指令 ID
+  uint64_t address = 0;           // 指令地址
+  int32_t cc = 0;                 // 条件码, 对应 arm64_cc
   std::vector<char> data;         // 指令元数据
   std::string mnemonic;           // 指令助记符
   std::string op_str;             // 操作数字符串
@@ -53,9 +56,10 @@ struct Instruction
   // 构造函数
   Instruction() = default;
 
-  Instruction(Type type_, std::vector<char> data, const std::string& mnemonic_, 
-  const std::string& op_str_, const Operand* ops_, uint8_t op_count_)
-    : type(type_), data(data), mnemonic(mnemonic_), op_str(op_str_), op_count(op_count_)
+  Instruction(Type type_, uint32_t id_, uint64_t address_, int32_t cc_, std::vector<char> data, 
+  const std::string& mnemonic_, const std::string& op_str_, const Operand* ops_, uint8_t op_count_)
+    : type(type_), id(id_), address(address_), cc(cc_), data(data), mnemonic(mnemonic_), 
+    op_str(op_str_), op_count(op_count_)
   {
     for (int i = 0; i < op_count; i++) 
     {
@@ -95,8 +99,8 @@ private:
   csh handle_;
 
 public:
-  // 反汇编
-  std::optional<std::vector<Instruction>> disassemble(const std::vector<char>& codes);
+  // 反汇编, address 为第一条指令的地址, 跳转类操作数会按该地址计算为绝对地址
+  std::optional<std::vector<Instruction>> disassemble(const std::vector<char>& codes, uint64_t address = 0);
 
 private:
   // 系统调用指令
@@ -1,106 +1,116 @@
 #include <asm/ptrace.h>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstdint>
 #include <exception>
+#include <map>
 #include <optional>
 #include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 
 #include "breakpoint_manager.hpp"
 #include "log.hpp"
 #include "memory_control.hpp"
 #include "register_control.hpp"
+#include "relocator.hpp"
+#include "remote_control.hpp"
 #include "status.hpp"
+#include "utils.hpp"
+
+#ifndef TRAP_BRKPT
+#define TRAP_BRKPT 1
+#endif
+#ifndef TRAP_HWBKPT
+#define TRAP_HWBKPT 4
+#endif
 
 
 namespace Core 
 {
 
+namespace
+{
+
+// 按 pc 处的访存指令判断访问需要的权限, 拿不到 ESR 只能解码指令
+// 加载/存储类指令中 bit 22 为 1 是读, 原子操作(ldadd / swp / cas 等)既读又写
+int access_prot(uint32_t code)
+{
+  if ((code & 0x0A000000) != 0x08000000) return PROT_READ;
+
+  bool atomic = (code & 0x3F200C00) == 0x38200000 || (code & 0x3FA00000) == 0x08A00000;
+  if (atomic) return PROT_READ | PROT_WRITE;
+  return (code & (1U << 22)) ? PROT_READ : PROT_WRITE;
+}
+
+// 结果本来就写入 x17 的 pc 相关指令(adr / adrp, 通用寄存器的 ldr literal), 异地单步后不能恢复 x17
+bool writes_ip1(uint32_t code)
+{
+  bool is_adr = (code & 0x1F000000) == 0x10000000;
+  bool is_ldr_literal = (code & 0x3F000000) == 0x18000000;
+  return (is_adr || is_ldr_literal) && (code & 0x1F) == Assembly::Arm64Writer::IP1;
+}
+
+}
+
 BreakpointManager::BreakpointManager()
 {
   m_next_breakpoint_id_ = 1;
+  m_hardware_registers_count_ = -1;
+  m_process_hardware_registers_ = 0;
+  m_watch_registers_count_ = -1;
+  m_watch_pid_ = -1;
+  m_pid_ = -1;
 }
 
 
 int BreakpointManager::get_hardware_registers_count(pid_t tid)
 {
   if (init_hardware_register(tid).is_success())
-    return m_hardware_registers_count_[tid];
+    return m_hardware_registers_count_;
 
   return -1;
 }
 
 Base::Status BreakpointManager::init_hardware_register(pid_t tid)
 {
-  if (m_hardware_registers_count_.find(tid) != m_hardware_registers_count_.end()) 
+  if (m_hardware_registers_count_ >= 0) 
     return Base::Status::success("已经初始化"); 
 
-  m_hardware_registers_count_[tid] = 0;
-  const uint64_t test_address = 0x10000000;
-  const uint32_t test_control = DBGBCR_ENABLE | DBGBCR_TYPE_EXECUTION | DBGBCR_EL0 | DBGBCR_MATCH_FULL;
-  auto& register_control = RegisterControl::get_instance();
+  // dbg_info 低 8 位就是可用的断点寄存器数量, 所有线程相同, 不需要逐个线程写入测试值
+  auto dbg_opt = RegisterControl::get_instance().get_all_dbg(tid);
+  if (!dbg_opt)
+    return Base::Status::fail("获取调试寄存器失败");
 
-  // 获取调试寄存器
-  const auto orign_dgb_opt = register_control.get_all_dbg(tid);
-  if (!orign_dgb_opt)
-    return Base::Status::fail("获取调试寄存器原始状态失败");
+  m_hardware_registers_count_ = std::min<int>(dbg_opt->dbg_info & 0xFF, 16);
 
-  const auto& orgin_dbg = orign_dgb_opt.value();
-  struct user_hwdebug_state test_dbg = orgin_dbg;
+  if (m_hardware_registers_count_ == 0)
+    LOG_WARNING("不支持硬件断定, 调试寄存器数量为 0");
+  else  
+    LOG_DEBUG("调试寄存器数量为 {}", m_hardware_registers_count_);
 
-  // 填写 16 个调试寄存器的测试值
-  for (int index = 0; index < 16; ++index)
-  {
-    test_dbg.dbg_regs[index].addr = test_address;
-    test_dbg.dbg_regs[index].ctrl = test_control;
-  }
+  return Base::Status::success("init_hardware_register 成功");
+}
 
-  // 提交调试寄存器测试值
-  // 系统会自动忽略硬件不支持的寄存器索引, 仅对存在的寄存器生效
-  if (!register_control.set_all_dbg(tid, test_dbg))
+std::optional<DBRegister> BreakpointManager::find_free_hardware_register(const std::vector<pid_t>& tids)
+{
+  uint16_t used = m_process_hardware_registers_;
+  for (pid_t tid : tids)
   {
-    // 复原, 避免污染目标进程
-    register_control.set_all_dbg(tid, orgin_dbg);
-    return Base::Status::fail("提交调试寄存器测试值失败");
+    auto used_it = m_used_hardware_registers_.find(tid);
+    if (used_it != m_used_hardware_registers_.end())
+      used |= used_it->second;
   }
 
-  // 验证
-  const auto verify_dbg_opt = register_control.get_all_dbg(tid);
-  if (!verify_dbg_opt)
-  {
-    register_control.set_all_dbg(tid, orgin_dbg);
-    return Base::Status::fail("验证时, 获取调试寄存器失败");
-  }
-  const auto& verify_dbg = verify_dbg_opt.value();
-  for (int index = 0; index < 16; ++index)
+  for (int index = 0; index < m_hardware_registers_count_; ++index)
   {
-    // 地址和控制字都与测试值一致, 说明寄存器存在且可写
-    if (verify_dbg.dbg_regs[index].addr == test_address && verify_dbg.dbg_regs[index].ctrl == test_control) 
-    {
-      m_hardware_registers_count_[tid]++;
-      LOG_DEBUG("✅ DBG%d 验证成功", index);
-    } 
-    else 
-    {
-      LOG_DEBUG("❌ DBG%d 验证失败", index);
-      continue;
-    }
+    if ((used & (1U << index)) == 0)
+      return static_cast<DBRegister>(index);
   }
 
-  // 原所有寄存器到原始值
-  if (!register_control.set_all_dbg(tid, orgin_dbg))
-    return Base::Status::fail("set_all_dbg 失败! 目标进程调试寄存器可能被污染");
-  else  
-    LOG_DEBUG("✅ 调试寄存器已复原到原始状态");
-
-  if (m_hardware_registers_count_[tid] == 0)
-    LOG_WARNING("不支持硬件断定, 调试寄存器数量为 0");
-  else  
-    LOG_DEBUG("调试寄存器数量为 {}", m_hardware_registers_count_[tid]);
-
-  // 初始化空闲寄存器
-  for (int i = 0; i < m_hardware_registers_count_[tid]; ++i)
-    m_free_hardware_registers_[tid].insert(static_cast<DBRegister>(i));
-
-  return Base::Status::success("init_hardware_register 成功");
+  return std::nullopt;
 }
 
 int BreakpointManager::set_software_breakpoint(pid_t tid, uint64_t address)
@@ -144,35 +154,36 @@ int BreakpointManager::set_hardware_breakpoint(pid_t tid, uint64_t address, Brea
   // 检查重复断点
   if (check_duplicate_breakpoint(address)) return -1;
 
+  if (init_hardware_register(tid).is_fail()) return -1;
+
   // 分配硬件寄存器
-  if (m_free_hardware_registers_[tid].empty())
+  auto reg_opt = find_free_hardware_register({tid});
+  if (!reg_opt)
   {
     LOG_ERROR("无空闲硬件断点寄存器");
     return -1;
   }
 
-  if (init_hardware_register(tid).is_fail()) return -1;
-
   // 写入地址寄存器和控制寄存器
-  DBRegister reg = *m_free_hardware_registers_[tid].begin();
-  m_free_hardware_registers_[tid].erase(reg);
+  DBRegister reg = reg_opt.value();
 
   auto& register_control = RegisterControl::get_instance();
   uint64_t control = DBGBCR_ENABLE | DBGBCR_EL0 | DBGBCR_MATCH_FULL;
   switch (type) 
   {
     case BreakpointType::HARDWARE_EXECUTION: control |= DBGBCR_TYPE_EXECUTION; break;
-    case BreakpointType::HARDWARE_WRITE: control |= DBGBCR_TYPE_WRITE; break;
-    case BreakpointType::HARDWARE_READWRITE: control |= DBGBCR_TYPE_READWRITE; break;
-    default: LOG_ERROR("传入断点类型与调用方法不符"); return -1;
+    // 写入和读写走观察点寄存器, 见 set_watchpoint
+    default: 
+      LOG_ERROR("传入断点类型与调用方法不符"); 
+      return -1;
   }
 
   if (!register_control.set_dbg(tid, reg, {address, control}))
   {
     LOG_ERROR("配置硬件寄存器失败");
-    m_free_hardware_registers_[tid].insert(reg);  // 归还寄存器
     return -1;
   }
+  m_used_hardware_registers_[tid] |= 1U << static_cast<int>(reg);
 
   // 创建断点, 返回 id
   int id = new_breakpoint(tid, address, type, 0);
@@ -181,6 +192,299 @@ int BreakpointManager::set_hardware_breakpoint(pid_t tid, uint64_t address, Brea
   return id;
 }
 
+int BreakpointManager::set_process_hardware_breakpoint(const std::vector<pid_t>& tids, pid_t tid, uint64_t address)
+{
+  // 入参校验
+  if ((address & 0x3) != 0) 
+    throw std::invalid_argument("地址 0x" + std::to_string(address) + " 未按 4 字节对齐");
+
+  if (tids.empty())
+  {
+    LOG_ERROR("没有需要设置断点的线程");
+    return -1;
+  }
+
+  // 检查重复断点
+  if (check_duplicate_breakpoint(address)) return -1;
+
+  if (init_hardware_register(tids.front()).is_fail()) return -1;
+
+  // 所有线程都空闲的寄存器才能使用
+  auto reg_opt = find_free_hardware_register(tids);
+  if (!reg_opt)
+  {
+    LOG_ERROR("没有所有线程都空闲的硬件断点寄存器");
+    return -1;
+  }
+
+  DBRegister reg = reg_opt.value();
+  m_process_hardware_registers_ |= 1U << static_cast<int>(reg);
+  m_process_tids_ = tids;
+
+  // 创建断点后一次性写入所有线程
+  int id = new_breakpoint(tid, address, BreakpointType::HARDWARE_EXECUTION, 0);
+  Breakpoint& breakpoint = m_breakpoints_[id];
+  breakpoint.hardware_register = reg;
+  breakpoint.process_wide = true;
+
+  Base::Status s = write_process_breakpoint(breakpoint, m_process_tids_, true);
+  if (s.is_fail())
+  {
+    LOG_ERROR("设置进程级硬件断点失败: {}", s.c_str());
+    remove_breakpoint(id);
+    return -1;
+  }
+
+  return id;
+}
+
+Base::Status BreakpointManager::add_thread(pid_t tid)
+{
+  if (std::find(m_process_tids_.begin(), m_process_tids_.end(), tid) != m_process_tids_.end())
+    return Base::Status::success("线程 {} 已经存在", tid);
+  m_process_tids_.push_back(tid);
+
+  bool has_process_breakpoint = m_process_hardware_registers_ != 0;
+  bool has_watchpoint = std::any_of(m_breakpoints_.begin(), m_breakpoints_.end(), [](const auto& item) {
+    return is_watchpoint(item.second.type) && !item.second.page_protected;
+  });
+  if (!has_process_breakpoint && !has_watchpoint)
+    return Base::Status::success("没有需要同步的断点");
+
+  // 新线程的调试寄存器是空的, 进程级断点占用的寄存器由位图统一保留
+  if (has_process_breakpoint)
+  {
+    for (const auto& [id, breakpoint] : m_breakpoints_)
+    {
+      if (!breakpoint.process_wide) continue;
+      Base::Status s = write_process_breakpoint(breakpoint, {tid}, breakpoint.enabled);
+      if (s.is_fail()) return s;
+    }
+  }
+
+  if (has_watchpoint)
+  {
+    Base::Status s = apply_watchpoints({tid});
+    if (s.is_fail()) return s;
+  }
+
+  return Base::Status::success("线程 {} 已同步进程级断点", tid);
+}
+
+void BreakpointManager::remove_thread(pid_t tid)
+{
+  m_process_tids_.erase(std::remove(m_process_tids_.begin(), m_process_tids_.end(), tid), m_process_tids_.end());
+  m_used_hardware_registers_.erase(tid);
+}
+
+Base::Status BreakpointManager::write_process_breakpoint(const Breakpoint& breakpoint, const std::vector<pid_t>& tids, bool enable)
+{
+  auto& register_control = RegisterControl::get_instance();
+  uint64_t control = DBGBCR_EL0 | DBGBCR_MATCH_FULL | DBGBCR_TYPE_EXECUTION;
+  if (enable) control |= DBGBCR_ENABLE;
+
+  bool all_ok = true;
+  int success_count = 0;
+  for (pid_t tid : tids)
+  {
+    if (register_control.set_dbg(tid, breakpoint.hardware_register, {breakpoint.address, control}))
+      success_count++;
+    else
+    {
+      LOG_WARNING("写入线程 {} 的硬件断点寄存器失败", tid);
+      all_ok = false;
+    }
+  }
+
+  if (!all_ok)
+    return Base::Status::fail("部分线程硬件断点写入失败, 成功率: {} / {}", success_count, tids.size());
+
+  return Base::Status::success("进程级硬件断点已写入 {} 个线程", success_count);
+}
+
+int BreakpointManager::set_watchpoint(pid_t pid, const std::vector<pid_t>& tids, pid_t tid, uint64_t address, size_t length, BreakpointType type)
+{
+  // 入参校验
+  if (!is_watchpoint(type))
+  {
+    LOG_ERROR("传入断点类型与调用方法不符");
+    return -1;
+  }
+
+  if (length == 0)
+  {
+    LOG_ERROR("观察点长度不能为 0");
+    return -1;
+  }
+
+  if (tids.empty())
+  {
+    LOG_ERROR("没有需要设置观察点的线程");
+    return -1;
+  }
+
+  // 地址, 长度, 类型都相同才算重复, 不同的观察点可以重叠
+  for (const auto& [id, breakpoint] : m_breakpoints_)
+  {
+    if (breakpoint.type == type && breakpoint.address == address && breakpoint.length == length)
+      return -1;
+  }
+
+  // 读不到观察点寄存器时全部走页保护
+  Base::Status init_status = init_watch_register(tids.front());
+  if (init_status.is_fail())
+    LOG_WARNING("{}, 观察点将使用页保护", init_status.c_str());
+
+  // 先加入管理再统一计算寄存器, 失败时回滚
+  int id = new_breakpoint(tid, address, type, 0);
+  m_breakpoints_[id].length = length;
+  m_watch_pid_ = pid;
+  m_process_tids_ = tids;
+
+  // DBGWCR 只能表示 1 ~ 8 字节(BAS)或按大小对齐的 2 的幂(MASK), 其余长度直接用页保护
+  bool encodable = length <= 8 || ((length & (length - 1)) == 0 && (address & (length - 1)) == 0);
+  if (!encodable)
+  {
+    LOG_DEBUG("观察点长度 {} 无法用寄存器表示, 0x{:x} 改用页保护", length, address);
+    m_breakpoints_[id].page_protected = true;
+  }
+  // 寄存器放不下时改用页保护
+  else if (build_watch_slots().size() > static_cast<size_t>(std::max(m_watch_registers_count_, 0)))
+  {
+    LOG_DEBUG("观察点寄存器不足, 0x{:x} 改用页保护", address);
+    m_breakpoints_[id].page_protected = true;
+  }
+
+  Base::Status s = m_breakpoints_[id].page_protected ? apply_page_watches(tid) : apply_watchpoints(m_process_tids_);
+  if (s.is_fail())
+  {
+    LOG_ERROR("设置观察点失败: {}", s.c_str());
+    remove_breakpoint(id);
+    return -1;
+  }
+
+  return id;
+}
+
+int BreakpointManager::set_fast_tracepoint(pid_t pid, pid_t tid, uint64_t address, bool* clobbers_ip1)
+{
+  auto& memory_control = MemoryControl::get_instance();
+  auto& remote_control = RemoteControl::get_instance();
+
+  // 入参校验
+  if ((address & 0x3) != 0) 
+    throw std::invalid_argument("地址 0x" + std::to_string(address) + " 未按 4 字节对齐");
+
+  // 检查重复断点
+  if (check_duplicate_breakpoint(address)) return -1;
+
+  // 第一次使用时创建环形缓冲区
+  if (!m_trace_ring_.is_ready())
+  {
+    Base::Status s = m_trace_ring_.create(pid, tid);
+    if (s.is_fail())
+    {
+      LOG_ERROR("创建跟踪环形缓冲区失败: {}", s.c_str());
+      return -1;
+    }
+  }
+
+  // 读取原指令
+  uint32_t original_instruction = 0;
+  if (!memory_control.read_memory(pid, address, &original_instruction, 4))
+  {
+    LOG_ERROR("读取地址 0x{:x} 原指令失败", address);
+    return -1;
+  }
+
+  // 蹦床必须在 b 指令范围内(±128MB), 留出蹦床自身的大小
+  const uint64_t range = (1ULL << 27) - TraceRing::TRAMPOLINE_SIZE;
+  auto trampoline_opt = remote_control.allocate(pid, tid, TraceRing::TRAMPOLINE_SIZE, address, range);
+  if (!trampoline_opt)
+  {
+    LOG_ERROR("在 0x{:x} 附近申请蹦床内存失败", address);
+    return -1;
+  }
+  uint64_t trampoline = trampoline_opt.value();
+
+  // 生成并写入蹦床, 记录中的 hook_id 就是即将分配的断点 ID
+  int breakpoint_id = m_next_breakpoint_id_;
+  auto codes_opt = TraceRing::build_trampoline(trampoline, address, original_instruction, 
+    m_trace_ring_.remote_address(), static_cast<uint64_t>(breakpoint_id), clobbers_ip1);
+  if (!codes_opt || !memory_control.write_code(pid, trampoline, codes_opt->data(), codes_opt->size()))
+  {
+    LOG_ERROR("写入 0x{:x} 的蹦床失败", address);
+    remote_control.free(pid, trampoline);
+    return -1;
+  }
+
+  // 原指令改为跳到蹦床
+  uint32_t jump = Assembly::Arm64Writer::encode_b(static_cast<int64_t>(trampoline - address));
+  if (!memory_control.write_code(pid, address, &jump, 4))
+  {
+    LOG_ERROR("写入跳转指令到地址 0x{:x} 失败", address);
+    remote_control.free(pid, trampoline);
+    return -1;
+  }
+
+  // 创建断点, 返回 id
+  int id = new_breakpoint(tid, address, BreakpointType::FAST_TRACEPOINT, original_instruction);
+  m_breakpoints_[id].trampoline_address = trampoline;
+  if (id != breakpoint_id)
+  {
+    // 蹦床中记录的 ID 与分配的 ID 不一致, 命中记录无法对应, 撤销
+    LOG_ERROR("快速跟踪点 ID {} 与蹦床中的 ID {} 不一致", id, breakpoint_id);
+    remove_breakpoint(id);
+    return -1;
+  }
+
+  return id;
+}
+
+void BreakpointManager::reclaim_trampolines(const std::vector<pid_t>& tids)
+{
+  if (m_retired_trampolines_.empty()) return;
+
+  // 读不到寄存器说明线程没有暂停, 这次不归还
+  std::vector<std::pair<uint64_t, uint64_t>> locations;
+  auto& register_control = RegisterControl::get_instance();
+  for (pid_t tid : tids)
+  {
+    auto pc_opt = register_control.get_gpr(tid, GPRegister::PC);
+    auto lr_opt = register_control.get_gpr(tid, GPRegister::X30);
+    if (!pc_opt || !lr_opt) return;
+    locations.emplace_back(pc_opt.value(), lr_opt.value());
+  }
+
+  // 蹦床中重定位的 bl 会把 lr 指向蹦床, 从被调函数返回前也不能归还
+  auto inside = [](uint64_t address, uint64_t trampoline) {
+    return address >= trampoline && address < trampoline + TraceRing::TRAMPOLINE_SIZE;
+  };
+  for (auto it = m_retired_trampolines_.begin(); it != m_retired_trampolines_.end();)
+  {
+    bool busy = std::any_of(locations.begin(), locations.end(), [&](const auto& location) {
+      return inside(location.first, *it) || inside(location.second, *it);
+    });
+    if (busy)
+    {
+      ++it;
+      continue;
+    }
+    RemoteControl::get_instance().free(m_trace_ring_.pid(), *it);
+    it = m_retired_trampolines_.erase(it);
+  }
+}
+
+size_t BreakpointManager::read_trace_records(std::vector<TraceRecord>& records, size_t max_count)
+{
+  return m_trace_ring_.drain(records, max_count);
+}
+
+uint64_t BreakpointManager::get_trace_dropped()
+{
+  return m_trace_ring_.dropped();
+}
+
 Base::Status BreakpointManager::remove_breakpoint(int breakpoint_id)
 {
   auto& memory_control = MemoryControl::get_instance();
@@ -198,6 +502,38 @@ Base::Status BreakpointManager::remove_breakpoint(int breakpoint_id)
     // 恢复原指令
     if (!memory_control.write_memory(breakpoint.tid, breakpoint.address, &breakpoint.original_instruction, 4))
       return Base::Status::fail("恢复软件断点 [ID: {}] 原指令失败", breakpoint_id);
+    // 异地单步是同步完成的, 此时没有线程停在缓冲区中
+    if (breakpoint.trampoline_address != 0)
+      RemoteControl::get_instance().free(m_pid_, breakpoint.trampoline_address);
+  }
+  // 快速跟踪点, 恢复原指令后蹦床不会再被执行
+  // 正在蹦床中执行的线程仍然要跳回, 蹦床等到所有线程都离开后再由 reclaim_trampolines 归还
+  else if (breakpoint.type == BreakpointType::FAST_TRACEPOINT)
+  {
+    if (!memory_control.write_code(breakpoint.tid, breakpoint.address, &breakpoint.original_instruction, 4))
+      return Base::Status::fail("恢复快速跟踪点 [ID: {}] 原指令失败", breakpoint_id);
+    m_retired_trampolines_.push_back(breakpoint.trampoline_address);
+  }
+  // 观察点, 元数据清理后重新计算寄存器
+  else if (is_watchpoint(breakpoint.type))
+  {
+    pid_t tid = breakpoint.tid;
+    bool page_protected = breakpoint.page_protected;
+    erase_address_index(breakpoint.address, breakpoint_id);
+    m_tid_breakpoints_map_[tid].erase(breakpoint_id);
+    if (m_tid_breakpoints_map_[tid].empty())
+      m_tid_breakpoints_map_.erase(tid);
+    m_breakpoints_.erase(breakpont_item);
+
+    Base::Status s = page_protected ? apply_page_watches(tid) : apply_watchpoints(m_process_tids_);
+    if (s.is_fail()) return s;
+    return Base::Status::success("成功移除观察点: ID = {}, TID = {}", breakpoint_id, tid);
+  }
+  // 进程级硬件断点, 清除所有线程的寄存器后归还
+  else if (breakpoint.process_wide)
+  {
+    write_process_breakpoint(breakpoint, m_process_tids_, false);
+    m_process_hardware_registers_ &= ~(1U << static_cast<int>(breakpoint.hardware_register));
   }
   // 硬件断点
   else if (breakpoint.hardware_register != DBRegister::INVALID) 
@@ -211,17 +547,50 @@ Base::Status BreakpointManager::remove_breakpoint(int breakpoint_id)
       control &= ~DBGBCR_ENABLE;
       register_control.set_dbg(breakpoint.tid, breakpoint.hardware_register, {address, control});
     }
-    // 归还寄存器到空闲集合
-    m_free_hardware_registers_[breakpoint.tid].insert(breakpoint.hardware_register);
+    // 归还寄存器
+    m_used_hardware_registers_[breakpoint.tid] &= ~(1U << static_cast<int>(breakpoint.hardware_register));
   }
 
   // 清理断点元数据
-  m_tid_breakpoints_map_[breakpoint.tid].erase(breakpoint.id);
-  if (m_tid_breakpoints_map_[breakpoint.tid].empty())
-    m_tid_breakpoints_map_.erase(breakpoint.tid);
+  pid_t tid = breakpoint.tid;
+  uint64_t address = breakpoint.address;
+  erase_address_index(address, breakpoint_id);
+  m_tid_breakpoints_map_[tid].erase(breakpoint_id);
+  if (m_tid_breakpoints_map_[tid].empty())
+    m_tid_breakpoints_map_.erase(tid);
   m_breakpoints_.erase(breakpont_item);
 
-  return Base::Status::success("成功移除断点: ID = {}, TID = {}, 地址 = 0x{:x}", breakpoint_id, breakpoint.tid, breakpoint.address);
+  return Base::Status::success("成功移除断点: ID = {}, TID = {}, 地址 = 0x{:x}", breakpoint_id, tid, address);
+}
+
+void BreakpointManager::erase_address_index(uint64_t address, int breakpoint_id)
+{
+  auto address_it = m_address_breakpoint_map_.find(address);
+  if (address_it != m_address_breakpoint_map_.end() && address_it->second == breakpoint_id)
+    m_address_breakpoint_map_.erase(address_it);
+}
+
+int BreakpointManager::find_execution_breakpoint(uint64_t pc)
+{
+  auto address_it = m_address_breakpoint_map_.find(pc);
+  if (address_it == m_address_breakpoint_map_.end()) return -1;
+
+  auto breakpoint_it = m_breakpoints_.find(address_it->second);
+  if (breakpoint_it == m_breakpoints_.end()) return -1;
+
+  const Breakpoint& breakpoint = breakpoint_it->second;
+  if (!breakpoint.enabled) return -1;
+  if (breakpoint.type == BreakpointType::SOFTWARE || breakpoint.type == BreakpointType::HARDWARE_EXECUTION)
+    return breakpoint.id;
+  return -1;
+}
+
+Base::Status BreakpointManager::step_over(pid_t tid, int breakpoint_id)
+{
+  auto breakpoint_it = m_breakpoints_.find(breakpoint_id);
+  if (breakpoint_it == m_breakpoints_.end())
+    return Base::Status::fail("断点 {} 不存在", breakpoint_id);
+  return step_over_breakpoint(tid, breakpoint_it->second);
 }
 
 Base::Status BreakpointManager::enable(int breakpoint_id)
@@ -245,6 +614,28 @@ Base::Status BreakpointManager::enable(int breakpoint_id)
     if (!memory_control.write_memory(breakpoint.tid, breakpoint.address, &Breakpoint::BRK_OPCODE, 4))
       return Base::Status::fail("写入断点指令失败");
   }
+  // 快速跟踪点, 重新写入跳到蹦床的指令
+  else if (breakpoint.type == BreakpointType::FAST_TRACEPOINT)
+  {
+    uint32_t jump = Assembly::Arm64Writer::encode_b(static_cast<int64_t>(breakpoint.trampoline_address - breakpoint.address));
+    if (!memory_control.write_code(breakpoint.tid, breakpoint.address, &jump, 4))
+      return Base::Status::fail("写入跳转指令失败");
+  }
+  else if (is_watchpoint(breakpoint.type))
+  {
+    breakpoint.enabled = true;
+    Base::Status s = breakpoint.page_protected ? apply_page_watches(breakpoint.tid) : apply_watchpoints(m_process_tids_);
+    if (s.is_fail())
+    {
+      breakpoint.enabled = false;
+      return s;
+    }
+  }
+  else if (breakpoint.process_wide)
+  {
+    Base::Status s = write_process_breakpoint(breakpoint, m_process_tids_, true);
+    if (s.is_fail()) return s;
+  }
   else if (breakpoint.hardware_register != DBRegister::INVALID) 
   {
     auto dbg_opt = register_control.get_dbg(breakpoint.tid, breakpoint.hardware_register);
@@ -282,6 +673,27 @@ Base::Status BreakpointManager::disable(int breakpoint_id)
     if (!memory_control.write_memory(breakpoint.tid, breakpoint.address, &breakpoint.original_instruction, 4))
       return Base::Status::fail("恢复原指令失败");
   }
+  // 快速跟踪点, 恢复原指令, 蹦床保留以便重新启用
+  else if (breakpoint.type == BreakpointType::FAST_TRACEPOINT)
+  {
+    if (!memory_control.write_code(breakpoint.tid, breakpoint.address, &breakpoint.original_instruction, 4))
+      return Base::Status::fail("恢复原指令失败");
+  }
+  else if (is_watchpoint(breakpoint.type))
+  {
+    breakpoint.enabled = false;
+    Base::Status s = breakpoint.page_protected ? apply_page_watches(breakpoint.tid) : apply_watchpoints(m_process_tids_);
+    if (s.is_fail())
+    {
+      breakpoint.enabled = true;
+      return s;
+    }
+  }
+  else if (breakpoint.process_wide)
+  {
+    Base::Status s = write_process_breakpoint(breakpoint, m_process_tids_, false);
+    if (s.is_fail()) return s;
+  }
   else if (breakpoint.hardware_register != DBRegister::INVALID) 
   {
     auto dbg_opt = register_control.get_dbg(breakpoint.tid, breakpoint.hardware_register);
@@ -347,7 +759,7 @@ std::optional<Breakpoint> BreakpointManager::get_breakpoint(int breakpoint_id)
 std::optional<Breakpoint> BreakpointManager::get_breakpoint(uint64_t address)
 {
   auto target = m_address_breakpoint_map_.find(address);
-  if (target == m_address_breakpoint_map_.end())
+  if (target != m_address_breakpoint_map_.end())
     return get_breakpoint(target->second);
   return std::nullopt;
 }
@@ -382,4 +794,637 @@ bool BreakpointManager::check_duplicate_breakpoint(uint64_t address)
   return false;
 }
 
-}
\ No newline at end of file
+bool BreakpointManager::is_watchpoint(BreakpointType type)
+{
+  return type == BreakpointType::HARDWARE_WRITE || type == BreakpointType::HARDWARE_READWRITE;
+}
+
+Base::Status BreakpointManager::init_watch_register(pid_t tid)
+{
+  if (m_watch_registers_count_ >= 0)
+    return Base::Status::success("已经初始化");
+
+  auto watch_opt = RegisterControl::get_instance().get_all_watch(tid);
+  if (!watch_opt)
+    return Base::Status::fail("获取观察点寄存器失败");
+
+  // dbg_info 低 8 位是可用的观察点数量, 所有线程相同
+  m_watch_registers_count_ = std::min<int>(watch_opt->dbg_info & 0xFF, 16);
+  if (m_watch_registers_count_ == 0)
+    LOG_WARNING("不支持硬件观察点, 观察点寄存器数量为 0");
+  else
+    LOG_DEBUG("观察点寄存器数量为 {}", m_watch_registers_count_);
+
+  return Base::Status::success("init_watch_register 成功");
+}
+
+std::vector<BreakpointManager::WatchSlot> BreakpointManager::build_watch_slots()
+{
+  // 按双字地址排序, 同一个双字内的请求合并到一个寄存器
+  std::map<uint64_t, WatchSlot> slots;
+  for (const auto& [id, breakpoint] : m_breakpoints_)
+  {
+    if (!breakpoint.enabled || !is_watchpoint(breakpoint.type) || breakpoint.page_protected) continue;
+
+    uint32_t lsc = DBGWCR_LSC_STORE;
+    if (breakpoint.type == BreakpointType::HARDWARE_READWRITE)
+      lsc |= DBGWCR_LSC_LOAD;
+
+    // 跨双字的范围拆成多段
+    uint64_t end = breakpoint.address + breakpoint.length;
+    for (uint64_t begin = breakpoint.address; begin < end;)
+    {
+      uint64_t doubleword = begin & ~0x7ULL;
+      uint64_t segment_end = std::min(doubleword + 8, end);
+      uint32_t bas = ((1U << (segment_end - doubleword)) - 1) & ~((1U << (begin - doubleword)) - 1);
+
+      WatchSlot& slot = slots[doubleword];
+      slot.address = doubleword;
+      slot.bas |= bas;
+      slot.lsc |= lsc;
+
+      begin = segment_end;
+    }
+  }
+
+  // 内核只接受连续的 BAS, 中间的空洞一并监视
+  std::vector<WatchSlot> result;
+  for (auto& [doubleword, slot] : slots)
+  {
+    uint32_t low = __builtin_ctz(slot.bas);
+    uint32_t high = 32 - __builtin_clz(slot.bas);
+    slot.bas = ((1U << high) - 1) & ~((1U << low) - 1);
+    result.push_back(slot);
+  }
+
+  return result;
+}
+
+Base::Status BreakpointManager::apply_watchpoints(const std::vector<pid_t>& tids)
+{
+  std::vector<WatchSlot> slots = build_watch_slots();
+  if (slots.size() > static_cast<size_t>(std::max(m_watch_registers_count_, 0)))
+    return Base::Status::fail("观察点需要 {} 个寄存器, 只有 {} 个", slots.size(), m_watch_registers_count_);
+
+  auto& register_control = RegisterControl::get_instance();
+  bool all_ok = true;
+  int success_count = 0;
+
+  for (pid_t tid : tids)
+  {
+    auto watch_opt = register_control.get_all_watch(tid);
+    if (!watch_opt)
+    {
+      LOG_WARNING("获取线程 {} 观察点寄存器失败", tid);
+      all_ok = false;
+      continue;
+    }
+
+    // 用到的寄存器写入合并结果, 其余全部清空
+    user_hwdebug_state watch = watch_opt.value();
+    for (int index = 0; index < m_watch_registers_count_; ++index)
+    {
+      if (static_cast<size_t>(index) < slots.size())
+      {
+        const WatchSlot& slot = slots[index];
+        watch.dbg_regs[index].addr = slot.address;
+        watch.dbg_regs[index].ctrl = DBGWCR_ENABLE | DBGWCR_EL0 | slot.lsc | (slot.bas << DBGWCR_BAS_SHIFT);
+      }
+      else
+      {
+        watch.dbg_regs[index].addr = 0;
+        watch.dbg_regs[index].ctrl = 0;
+      }
+    }
+
+    if (register_control.set_all_watch(tid, watch))
+      success_count++;
+    else
+    {
+      LOG_WARNING("设置线程 {} 观察点寄存器失败", tid);
+      all_ok = false;
+    }
+  }
+
+  if (!all_ok)
+    return Base::Status::fail("部分线程观察点设置失败, 成功率: {} / {}", success_count, tids.size());
+
+  return Base::Status::success("观察点已同步, 使用 {} 个寄存器", slots.size());
+}
+
+int BreakpointManager::handle_page_fault(pid_t tid, uint64_t fault_address, int si_code)
+{
+  // 地址未映射不是页保护引起的
+  if (si_code != SEGV_ACCERR) return -1;
+
+  uint64_t page = Utils::align_page_down(fault_address);
+  auto page_it = m_page_watches_.find(page);
+  if (page_it == m_page_watches_.end()) return -1;
+
+  PageWatchStat& stat = page_it->second;
+
+  // 原始权限下同样会出错的访问交给目标自己处理, 不能越过
+  auto pc_opt = RegisterControl::get_instance().get_gpr(tid, GPRegister::PC);
+  int required = PROT_READ;
+  if (pc_opt && Utils::align_page_down(pc_opt.value()) == page && pc_opt.value() == fault_address)
+    required = PROT_EXEC;
+  else if (pc_opt)
+  {
+    uint32_t code = 0;
+    if (MemoryControl::get_instance().read_memory(tid, pc_opt.value(), &code, sizeof(code)))
+      required = access_prot(code);
+  }
+  if ((stat.original_prot & required) != required)
+  {
+    LOG_DEBUG("线程 {} 对 0x{:x} 的访问在原始权限下也会出错, 交给目标处理", tid, fault_address);
+    return -1;
+  }
+
+  stat.faults++;
+
+  // 访问宽度未知, 按最大 16 字节(ldp q)判断是否与观察范围重叠
+  int hit_id = 0;
+  for (const auto& [id, breakpoint] : m_breakpoints_)
+  {
+    if (!breakpoint.enabled || !breakpoint.page_protected) continue;
+    if (fault_address < breakpoint.address + breakpoint.length && fault_address + 16 > breakpoint.address)
+    {
+      hit_id = id;
+      break;
+    }
+  }
+  if (hit_id != 0) stat.hits++;
+
+  // 临时恢复原始权限, 单步越过这次访问后重新保护
+  if (!protect_page(tid, page, stat.original_prot))
+  {
+    LOG_ERROR("临时恢复页 0x{:x} 权限失败, 无法越过 0x{:x} 处的访问", page, fault_address);
+    return -1;
+  }
+
+  if (!single_step(tid))
+    LOG_ERROR("线程 {} 单步越过 0x{:x} 处的访问失败", tid, fault_address);
+
+  if (!protect_page(tid, page, stat.protect_prot))
+    LOG_ERROR("重新保护页 0x{:x} 失败", page);
+
+  return hit_id;
+}
+
+std::vector<PageWatchStat> BreakpointManager::get_page_watch_stats()
+{
+  std::vector<PageWatchStat> result;
+  for (const auto& [page, stat] : m_page_watches_)
+    result.push_back(stat);
+  return result;
+}
+
+Base::Status BreakpointManager::apply_page_watches(pid_t tid)
+{
+  const uint64_t page_size = static_cast<uint64_t>(Utils::get_page_size());
+
+  // 需要保护的页, 页地址 -> 是否需要监视读
+  std::map<uint64_t, bool> pages;
+  for (const auto& [id, breakpoint] : m_breakpoints_)
+  {
+    if (!breakpoint.enabled || !breakpoint.page_protected) continue;
+
+    bool watch_read = breakpoint.type == BreakpointType::HARDWARE_READWRITE;
+    uint64_t end = breakpoint.address + breakpoint.length;
+    for (uint64_t page = Utils::align_page_down(breakpoint.address); page < end; page += page_size)
+      pages[page] = pages[page] || watch_read;
+  }
+
+  bool all_ok = true;
+
+  // 不再需要的页恢复原始权限
+  for (auto it = m_page_watches_.begin(); it != m_page_watches_.end();)
+  {
+    if (pages.find(it->first) != pages.end())
+    {
+      ++it;
+      continue;
+    }
+    if (!protect_page(tid, it->first, it->second.original_prot))
+      all_ok = false;
+    it = m_page_watches_.erase(it);
+  }
+
+  // 新增或者权限有变化的页
+  std::vector<MemoryRegion> regions;
+  for (const auto& [page, watch_read] : pages)
+  {
+    auto it = m_page_watches_.find(page);
+    if (it == m_page_watches_.end())
+    {
+      if (regions.empty())
+        regions = MemoryControl::get_instance().get_memory_regions(m_watch_pid_);
+
+      auto region = std::find_if(regions.begin(), regions.end(), [page](const MemoryRegion& r) {
+        return page >= r.start_address && page < r.end_address;
+      });
+      if (region == regions.end())
+      {
+        LOG_ERROR("页 0x{:x} 没有映射, 无法观察", page);
+        all_ok = false;
+        continue;
+      }
+
+      PageWatchStat stat{};
+      stat.page = page;
+      stat.original_prot = (region->is_readable() ? PROT_READ : 0) |
+        (region->is_writable() ? PROT_WRITE : 0) | (region->is_executable() ? PROT_EXEC : 0);
+      stat.protect_prot = stat.original_prot;
+      it = m_page_watches_.emplace(page, stat).first;
+    }
+
+    // 只观察写时去掉写权限, 观察读写时整页不可访问
+    int prot = watch_read ? PROT_NONE : (it->second.original_prot & ~PROT_WRITE);
+    if (prot == it->second.protect_prot) continue;
+
+    if (protect_page(tid, page, prot))
+      it->second.protect_prot = prot;
+    else
+      all_ok = false;
+  }
+
+  if (!all_ok)
+    return Base::Status::fail("部分页保护设置失败");
+
+  return Base::Status::success("页保护已同步, 共保护 {} 页", m_page_watches_.size());
+}
+
+bool BreakpointManager::protect_page(pid_t tid, uint64_t page, int prot)
+{
+  auto result = RemoteControl::get_instance().syscall(m_watch_pid_, tid, SYS_mprotect,
+    {page, static_cast<uint64_t>(Utils::get_page_size()), static_cast<uint64_t>(prot)});
+  if (!result || RemoteControl::is_error(result.value()))
+  {
+    LOG_ERROR("修改页 0x{:x} 权限为 {} 失败", page, prot);
+    return false;
+  }
+  return true;
+}
+
+int BreakpointManager::find_hit_breakpoint(uint64_t pc, int si_code, uint64_t fault_address)
+{
+  for (const auto& [id, breakpoint] : m_breakpoints_)
+  {
+    if (!breakpoint.enabled) continue;
+
+    // brk 不会推进 pc, 停下时 pc 就是断点地址
+    if (si_code == TRAP_BRKPT && breakpoint.type == BreakpointType::SOFTWARE && breakpoint.address == pc)
+      return id;
+
+    if (si_code != TRAP_HWBKPT) continue;
+
+    if (breakpoint.type == BreakpointType::HARDWARE_EXECUTION && breakpoint.address == fault_address)
+      return id;
+
+    // 观察点按双字合并过, 只能按双字匹配
+    if (is_watchpoint(breakpoint.type) && !breakpoint.page_protected)
+    {
+      uint64_t doubleword = fault_address & ~0x7ULL;
+      if (breakpoint.address < doubleword + 8 && breakpoint.address + breakpoint.length > doubleword)
+        return id;
+    }
+  }
+
+  return -1;
+}
+
+bool BreakpointManager::record_hit(pid_t tid, int breakpoint_id)
+{
+  auto breakpoint_it = m_breakpoints_.find(breakpoint_id);
+  if (breakpoint_it == m_breakpoints_.end()) return false;
+
+  Breakpoint& breakpoint = breakpoint_it->second;
+  m_pending_hits_[tid] = {breakpoint_id, std::chrono::steady_clock::now()};
+
+  // 其他线程或更深的栈帧命中, 不算作命中
+  if (breakpoint.thread_filter != -1 && breakpoint.thread_filter != tid)
+    return true;
+  if (breakpoint.frame_sp != 0)
+  {
+    auto sp_opt = RegisterControl::get_instance().get_gpr(tid, GPRegister::SP);
+    if (sp_opt && sp_opt.value() <= breakpoint.frame_sp)
+      return true;
+  }
+
+  breakpoint.hit_count++;
+  return breakpoint.hit_count <= breakpoint.ignore_count;
+}
+
+bool BreakpointManager::is_stopped_at_breakpoint(pid_t tid)
+{
+  return m_pending_hits_.find(tid) != m_pending_hits_.end();
+}
+
+Base::Status BreakpointManager::prepare_resume(pid_t tid)
+{
+  auto pending_it = m_pending_hits_.find(tid);
+  if (pending_it == m_pending_hits_.end())
+    return Base::Status::success("线程 {} 没有停在断点上", tid);
+
+  PendingHit pending = pending_it->second;
+  m_pending_hits_.erase(pending_it);
+
+  // 断点已被移除, 原指令已经恢复, 不需要越过
+  auto breakpoint_it = m_breakpoints_.find(pending.breakpoint_id);
+  if (breakpoint_it == m_breakpoints_.end())
+    return Base::Status::success("断点 {} 已被移除", pending.breakpoint_id);
+
+  Breakpoint& breakpoint = breakpoint_it->second;
+  uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - pending.trap_time).count();
+  size_t bucket = 0;
+  while (bucket + 1 < Breakpoint::LATENCY_BUCKETS && (elapsed >> (bucket + 1)) != 0)
+    ++bucket;
+  breakpoint.latency_histogram[bucket]++;
+
+  // 禁用的断点不会再触发, 页保护观察点在处理缺页时已经越过
+  if (!breakpoint.enabled || breakpoint.page_protected)
+    return Base::Status::success("不需要越过断点 {}", breakpoint.id);
+
+  return step_over_breakpoint(tid, breakpoint);
+}
+
+Base::Status BreakpointManager::set_condition(int breakpoint_id, pid_t thread_filter, uint64_t frame_sp)
+{
+  auto breakpoint_it = m_breakpoints_.find(breakpoint_id);
+  if (breakpoint_it == m_breakpoints_.end())
+    return Base::Status::fail("断点 {} 不存在", breakpoint_id);
+
+  breakpoint_it->second.thread_filter = thread_filter;
+  breakpoint_it->second.frame_sp = frame_sp;
+  return Base::Status::success("断点 {} 条件: 线程 {}, sp > 0x{:x}", breakpoint_id, thread_filter, frame_sp);
+}
+
+Base::Status BreakpointManager::set_module_location(int breakpoint_id, const std::string& module_path, uint64_t module_offset)
+{
+  auto breakpoint_it = m_breakpoints_.find(breakpoint_id);
+  if (breakpoint_it == m_breakpoints_.end())
+    return Base::Status::fail("断点 {} 不存在", breakpoint_id);
+
+  breakpoint_it->second.module_path = module_path;
+  breakpoint_it->second.module_offset = module_offset;
+  return Base::Status::success("断点 {} 位于 {}+0x{:x}", breakpoint_id, module_path, module_offset);
+}
+
+void BreakpointManager::reset()
+{
+  m_breakpoints_.clear();
+  m_tid_breakpoints_map_.clear();
+  m_address_breakpoint_map_.clear();
+  m_used_hardware_registers_.clear();
+  m_process_tids_.clear();
+  m_process_hardware_registers_ = 0;
+  m_pending_hits_.clear();
+  m_page_watches_.clear();
+  m_watch_pid_ = -1;
+  m_retired_trampolines_.clear();
+  m_step_signals_.clear();
+
+  // 目标进程中的映射已经不存在, 只释放本地映射
+  m_trace_ring_.destroy();
+}
+
+size_t BreakpointManager::inherit_software_breakpoints(const std::vector<Breakpoint>& breakpoints, pid_t tid)
+{
+  size_t count = 0;
+  for (const auto& breakpoint : breakpoints)
+  {
+    if (!breakpoint.enabled || breakpoint.type != BreakpointType::SOFTWARE) continue;
+    if (check_duplicate_breakpoint(breakpoint.address)) continue;
+
+    int breakpoint_id = new_breakpoint(tid, breakpoint.address, BreakpointType::SOFTWARE, breakpoint.original_instruction);
+    Breakpoint& inherited = m_breakpoints_.at(breakpoint_id);
+    inherited.module_path = breakpoint.module_path;
+    inherited.module_offset = breakpoint.module_offset;
+    inherited.frame_sp = breakpoint.frame_sp;
+    count++;
+  }
+  return count;
+}
+
+Base::Status BreakpointManager::set_ignore_count(int breakpoint_id, uint64_t count)
+{
+  auto breakpoint_it = m_breakpoints_.find(breakpoint_id);
+  if (breakpoint_it == m_breakpoints_.end())
+    return Base::Status::fail("未找到 ID: {} 的断点", breakpoint_id);
+
+  // 从当前命中次数开始计算
+  Breakpoint& breakpoint = breakpoint_it->second;
+  breakpoint.ignore_count = breakpoint.hit_count + count;
+  return Base::Status::success("断点 [ID: {}] 之后 {} 次命中不暂停", breakpoint_id, count);
+}
+
+Base::Status BreakpointManager::step_over_breakpoint(pid_t tid, Breakpoint& breakpoint)
+{
+  auto& memory_control = MemoryControl::get_instance();
+  auto& register_control = RegisterControl::get_instance();
+
+  if (breakpoint.type == BreakpointType::SOFTWARE)
+  {
+    Base::Status s = displaced_step(tid, breakpoint);
+    if (s.is_success()) return s;
+
+    // 原指令引起了同步异常, 线程已经回到原指令上, 原地单步也会同样失败
+    if (m_step_signals_.count(tid) > 0) return s;
+
+    // 无法重定位或申请不到缓冲区时退回原地单步, 这段时间内其他线程可能错过断点
+    LOG_WARNING("断点 {} 异地单步失败: {}, 改为原地单步", breakpoint.id, s.c_str());
+    if (!memory_control.write_memory(tid, breakpoint.address, &breakpoint.original_instruction, 4))
+      return Base::Status::fail("恢复原指令失败");
+
+    bool stepped = single_step(tid);
+
+    if (!memory_control.write_memory(tid, breakpoint.address, &Breakpoint::BRK_OPCODE, 4))
+      return Base::Status::fail("重新写入断点指令失败");
+    if (!stepped)
+      return Base::Status::fail("线程 {} 单步越过断点 {} 失败", tid, breakpoint.id);
+  }
+  else if (breakpoint.process_wide)
+  {
+    Base::Status s = write_process_breakpoint(breakpoint, {tid}, false);
+    if (s.is_fail()) return s;
+
+    bool stepped = single_step(tid);
+
+    s = write_process_breakpoint(breakpoint, {tid}, true);
+    if (s.is_fail()) return s;
+    if (!stepped)
+      return Base::Status::fail("线程 {} 单步越过断点 {} 失败", tid, breakpoint.id);
+  }
+  else if (breakpoint.hardware_register != DBRegister::INVALID)
+  {
+    auto dbg_opt = register_control.get_dbg(tid, breakpoint.hardware_register);
+    if (!dbg_opt)
+      return Base::Status::fail("get_dbg 失败");
+
+    auto [address, control] = dbg_opt.value();
+    if (!register_control.set_dbg(tid, breakpoint.hardware_register, {address, control & ~DBGBCR_ENABLE}))
+      return Base::Status::fail("更新控制寄存器失败");
+
+    bool stepped = single_step(tid);
+
+    if (!register_control.set_dbg(tid, breakpoint.hardware_register, {address, control}))
+      return Base::Status::fail("更新控制寄存器失败");
+    if (!stepped)
+      return Base::Status::fail("线程 {} 单步越过断点 {} 失败", tid, breakpoint.id);
+  }
+  else if (is_watchpoint(breakpoint.type))
+  {
+    // 观察点在访问之前触发, 清空该线程的观察点寄存器后单步, 再重新写入
+    auto watch_opt = register_control.get_all_watch(tid);
+    if (!watch_opt)
+      return Base::Status::fail("获取线程 {} 观察点寄存器失败", tid);
+
+    user_hwdebug_state watch = watch_opt.value();
+    for (auto& reg : watch.dbg_regs)
+      reg.ctrl &= ~DBGWCR_ENABLE;
+    if (!register_control.set_all_watch(tid, watch))
+      return Base::Status::fail("设置线程 {} 观察点寄存器失败", tid);
+
+    bool stepped = single_step(tid);
+
+    Base::Status s = apply_watchpoints({tid});
+    if (s.is_fail()) return s;
+    if (!stepped)
+      return Base::Status::fail("线程 {} 单步越过观察点 {} 失败", tid, breakpoint.id);
+  }
+
+  return Base::Status::success("线程 {} 已越过断点 {}", tid, breakpoint.id);
+}
+
+Base::Status BreakpointManager::displaced_step(pid_t tid, Breakpoint& breakpoint)
+{
+  auto& memory_control = MemoryControl::get_instance();
+  auto& register_control = RegisterControl::get_instance();
+
+  if (m_pid_ <= 0)
+    return Base::Status::fail("未设置目标进程");
+
+  // 缓冲区在断点附近申请, 重定位后的 b / bl 不需要改写成绝对跳转
+  if (breakpoint.trampoline_address == 0)
+  {
+    const uint64_t range = (1ULL << 27) - DISPLACED_STEP_SIZE;
+    auto buffer_opt = RemoteControl::get_instance().allocate(m_pid_, tid, DISPLACED_STEP_SIZE, breakpoint.address, range);
+    if (!buffer_opt)
+      return Base::Status::fail("申请异地单步缓冲区失败");
+    breakpoint.trampoline_address = buffer_opt.value();
+
+    // 不写跳回的代码, 执行到重定位代码末尾时由调试器把 pc 改回 address + 4
+    // 与 pc 相关的指令改写后可能会破坏 x17, 单步前后由调试器保存恢复
+    Assembly::Arm64Writer writer(breakpoint.trampoline_address);
+    if (!Assembly::Relocator::relocate(breakpoint.address, breakpoint.original_instruction, writer) ||
+      writer.size() > DISPLACED_STEP_SIZE - 4)
+    {
+      RemoteControl::get_instance().free(m_pid_, breakpoint.trampoline_address);
+      breakpoint.trampoline_address = 0;
+      return Base::Status::fail("重定位 0x{:x} 处的指令失败", breakpoint.address);
+    }
+
+    // 末尾放 brk, 单步异常时也不会继续执行缓冲区之后的内容
+    writer.emit(Breakpoint::BRK_OPCODE);
+    std::vector<char> codes = writer.bytes();
+    if (!memory_control.write_code(m_pid_, breakpoint.trampoline_address, codes.data(), codes.size()))
+    {
+      RemoteControl::get_instance().free(m_pid_, breakpoint.trampoline_address);
+      breakpoint.trampoline_address = 0;
+      return Base::Status::fail("写入异地单步缓冲区失败");
+    }
+    breakpoint.displaced_size = codes.size() - 4;
+  }
+
+  uint64_t begin = breakpoint.trampoline_address;
+  uint64_t end = begin + breakpoint.displaced_size;
+
+  // 编译器可能在断点处仍然使用 x17, 原样复制的单条指令不会破坏它, 改写过且原指令不写 x17 时单步后恢复
+  auto x17_opt = register_control.get_gpr(tid, GPRegister::X17);
+  if (!x17_opt)
+    return Base::Status::fail("读取线程 {} 的 x17 失败", tid);
+  bool restore_x17 = breakpoint.displaced_size > 4 && !writes_ip1(breakpoint.original_instruction);
+
+  if (!register_control.set_gpr(tid, GPRegister::PC, begin))
+    return Base::Status::fail("设置线程 {} 的 pc 失败", tid);
+
+  // 重定位后的代码最多几条指令, 单步到离开缓冲区为止
+  uint64_t pc = begin;
+  bool stepped = true;
+  for (size_t steps = 0; pc >= begin && pc < end && steps < DISPLACED_STEP_SIZE / 4; ++steps)
+  {
+    auto pc_opt = single_step(tid) ? register_control.get_gpr(tid, GPRegister::PC) : std::nullopt;
+    if (!pc_opt)
+    {
+      stepped = false;
+      break;
+    }
+    pc = pc_opt.value();
+  }
+
+  if (restore_x17 && !register_control.set_gpr(tid, GPRegister::X17, x17_opt.value()))
+    LOG_ERROR("恢复线程 {} 的 x17 失败", tid);
+  if (!stepped)
+  {
+    // 缓冲区中只有原指令会产生异常, 之前的指令只写 x17, 回到原指令上重新执行不会有副作用
+    register_control.set_gpr(tid, GPRegister::PC, breakpoint.address);
+    return Base::Status::fail("线程 {} 在异地单步缓冲区中单步失败", tid);
+  }
+
+  // 顺序执行到末尾, 回到原指令的下一条
+  if (pc == end && !register_control.set_gpr(tid, GPRegister::PC, breakpoint.address + 4))
+    return Base::Status::fail("设置线程 {} 的 pc 失败", tid);
+
+  // bl / blr 在缓冲区中执行, lr 指向缓冲区, 改成原指令的下一条
+  auto lr_opt = register_control.get_gpr(tid, GPRegister::X30);
+  if (lr_opt && lr_opt.value() > begin && lr_opt.value() <= end)
+    register_control.set_gpr(tid, GPRegister::X30, breakpoint.address + 4);
+
+  return Base::Status::success("线程 {} 异地单步越过断点 {}", tid, breakpoint.id);
+}
+
+bool BreakpointManager::single_step(pid_t tid)
+{
+  while (true)
+  {
+    int status = 0;
+    if (!Utils::ptrace_wrapper(PTRACE_SINGLESTEP, tid, nullptr, nullptr))
+      return false;
+    if (Utils::waitpid_wrapper(tid, &status, __WALL) != tid || !WIFSTOPPED(status))
+      return false;
+
+    // 残留的 PTRACE_INTERRUPT 或组暂停, 指令还没有执行
+    int signal = WSTOPSIG(status);
+    if ((status >> 16) == PTRACE_EVENT_STOP) continue;
+    if (signal == SIGTRAP) return true;
+
+    // 信号在指令执行前送达, 保存下来之后注入; 只保留一个, 和线程的 pending_signal 一样
+    auto step_signal_it = m_step_signals_.find(tid);
+    if (step_signal_it != m_step_signals_.end() && step_signal_it->second != signal)
+      LOG_WARNING("线程 {} 单步期间收到多个信号, 丢弃信号 {}", tid, step_signal_it->second);
+    m_step_signals_[tid] = signal;
+
+    // 指令本身引起的异常, 重新单步还会发生, 单步没有完成
+    siginfo_t info;
+    bool is_fault = signal == SIGSEGV || signal == SIGBUS || signal == SIGILL || signal == SIGFPE;
+    if (is_fault && Utils::ptrace_wrapper(PTRACE_GETSIGINFO, tid, nullptr, &info, sizeof(info)) && info.si_code > 0)
+    {
+      LOG_WARNING("线程 {} 单步时产生异常, 信号 {}", tid, signal);
+      return false;
+    }
+    LOG_DEBUG("线程 {} 单步期间收到信号 {}, 恢复运行时注入", tid, signal);
+  }
+}
+
+int BreakpointManager::take_step_signal(pid_t tid)
+{
+  auto step_signal_it = m_step_signals_.find(tid);
+  if (step_signal_it == m_step_signals_.end()) return 0;
+
+  int signal = step_signal_it->second;
+  m_step_signals_.erase(step_signal_it);
+  return signal;
+}
+
+}
@@ -1,8 +1,11 @@
 #pragma once 
 
+#include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <map>
 #include <stdexcept>
 #include <sys/types.h>
 #include <unordered_map>
@@ -11,6 +14,7 @@
 #include <string>
 #include "status.hpp"
 #include "register_control.hpp"
+#include "trace_ring.hpp"
 
 namespace Core 
 {
@@ -20,7 +24,8 @@ enum class BreakpointType
   SOFTWARE = 1,         // 软件断点
   HARDWARE_EXECUTION,   // 硬件执行断点
   HARDWARE_WRITE,       // 硬件写入断点
-  HARDWARE_READWRITE    // 硬件读写断点
+  HARDWARE_READWRITE,   // 硬件读写断点
+  FAST_TRACEPOINT       // 快速跟踪点, 原指令改为跳到蹦床, 命中时只记录寄存器不暂停
 };
 
 // 断点结构体
@@ -33,17 +38,38 @@ struct Breakpoint
   bool enabled;                         // 是否启用
   uint32_t original_instruction;        // 保存被替换的原始指令字节
   DBRegister hardware_register;         // 硬件断点使用的寄存器
+  uint64_t trampoline_address;          // 快速跟踪点的蹦床地址, 软件断点的异地单步缓冲区
+  size_t length;                        // 观察点监视的字节数
+  bool page_protected;                  // 观察点寄存器不够时, 改用页保护实现
+  bool process_wide;                    // 进程级硬件断点, 写入所有线程, 新线程自动同步
+  size_t displaced_size;                // 异地单步缓冲区中重定位代码的字节数
 
   // ARM64 断点指令常量
   static constexpr uint32_t BRK_OPCODE = 0xD4200000;
 
+  // 耗时直方图的桶数, 第 i 个桶统计 [2^i, 2^(i+1)) 微秒, 第 0 个桶包含 0, 最后一个桶包含更长的
+  static constexpr size_t LATENCY_BUCKETS = 24;
+
+  uint64_t hit_count;                   // 命中次数, 包含被忽略的
+  uint64_t ignore_count;                // 前 ignore_count 次命中不暂停, 在 wait_event 中直接放行
+  std::array<uint64_t, LATENCY_BUCKETS> latency_histogram;  // 每次命中在调试器中停留的时间(暂停 -> 恢复)
+
+  pid_t thread_filter;                  // 只在该线程命中时暂停, -1 表示所有线程
+  uint64_t frame_sp;                    // 只在 sp > frame_sp 时暂停, 用于区分递归中更深的栈帧, 0 表示不限制
+
+  std::string module_path;              // 断点所在的文件映射, exec 之后按模块偏移重新设置, 空表示不在文件映射中
+  uint64_t module_offset;               // 相对模块基址的偏移
+
   Breakpoint(int id_, pid_t tid_, uint64_t address_, BreakpointType type_)
     : id(id_), tid(tid_), address(address_), type(type_),
-    enabled(false), original_instruction(0), hardware_register(DBRegister::INVALID)
+    enabled(false), original_instruction(0), hardware_register(DBRegister::INVALID), trampoline_address(0), length(4), page_protected(false), process_wide(false), displaced_size(0),
+    hit_count(0), ignore_count(0), latency_histogram{}, thread_filter(-1), frame_sp(0), module_offset(0)
   {
     if (tid < 1)
       throw std::invalid_argument("tid 必须是一个正值");
-    if ((address & 0x3) != 0)
+    // 观察点监视的是数据, 不要求对齐
+    bool is_watchpoint = type == BreakpointType::HARDWARE_WRITE || type == BreakpointType::HARDWARE_READWRITE;
+    if (!is_watchpoint && (address & 0x3) != 0)
       throw std::invalid_argument("address 必须四字节对齐");
   }
 
@@ -52,6 +78,16 @@ struct Breakpoint
   Breakpoint() = default;
 };
 
+// 页保护观察点的单页统计
+struct PageWatchStat
+{
+  uint64_t page;              // 页地址
+  int original_prot;          // 原始权限
+  int protect_prot;           // 保护后的权限
+  uint64_t faults;            // 该页触发的所有缺页次数
+  uint64_t hits;              // 落在观察范围内的次数, faults - hits 就是误报带来的开销
+};
+
 // 断点管理
 class BreakpointManager 
 {
@@ -67,6 +103,21 @@ private:
   static constexpr uint64_t DBGBCR_MASK = 0x3ULL << 12;         // 地址匹配模式(默认全匹配)
   static constexpr uint64_t DBGBCR_MATCH_FULL = 0x0ULL << 12;   // 全地址匹配
 
+  // DBGWCR 观察点控制寄存器的配置位, 与内核 ptrace 接口的解析方式一致
+  static constexpr uint32_t DBGWCR_ENABLE = 1U << 0;            // 启用观察点
+  static constexpr uint32_t DBGWCR_EL0 = 2U << 1;               // PAC, 仅在 EL0(用户态)生效
+  static constexpr uint32_t DBGWCR_LSC_LOAD = 1U << 3;          // 读取时触发
+  static constexpr uint32_t DBGWCR_LSC_STORE = 2U << 3;         // 写入时触发
+  static constexpr uint32_t DBGWCR_BAS_SHIFT = 5;               // BAS 字节选择, 每个寄存器监视一个 8 字节对齐的双字
+
+  // 合并后的一个观察点寄存器
+  struct WatchSlot
+  {
+    uint64_t address;   // 8 字节对齐的双字地址
+    uint32_t bas;       // 字节选择位
+    uint32_t lsc;       // 读写类型
+  };
+
   // 所有断点, 占内存
   std::unordered_map<int, Breakpoint> m_breakpoints_;                 
   
@@ -76,14 +127,49 @@ private:
   // 通过地址找断点 ID
   std::unordered_map<uint64_t, int> m_address_breakpoint_map_;    
   
-  // 空闲硬件断点寄存器
-  std::unordered_map<pid_t, std::unordered_set<DBRegister>> m_free_hardware_registers_;
+  // 每个线程已占用的硬件断点寄存器, 第 i 位对应 DBGi
+  std::unordered_map<pid_t, uint16_t> m_used_hardware_registers_;
+
+  // 硬件断点寄存器数量, 是 CPU 的属性, 所有线程共用, -1 表示尚未读取
+  int m_hardware_registers_count_;
+
+  // 观察点寄存器数量, -1 表示尚未读取
+  int m_watch_registers_count_;
+
+  // 进程级断点和观察点需要同步到的所有线程
+  std::vector<pid_t> m_process_tids_;
+
+  // 进程级硬件断点占用的寄存器, 在所有线程中都保留, 第 i 位对应 DBGi
+  uint16_t m_process_hardware_registers_;
 
-  // 已经寄存器数量
-  std::unordered_map<pid_t, int> m_hardware_registers_count_;
+  // 停在断点上的线程, 恢复运行前需要先越过断点
+  struct PendingHit
+  {
+    int breakpoint_id;                                  // 命中的断点
+    std::chrono::steady_clock::time_point trap_time;    // 暂停时间
+  };
+  std::unordered_map<pid_t, PendingHit> m_pending_hits_;
+
+  // 观察点所属进程, 页保护需要注入系统调用
+  pid_t m_watch_pid_;
+
+  // 目标进程, 异地单步缓冲区从它的远程内存中分配
+  pid_t m_pid_;
+
+  // 被保护的页, 页地址 -> 统计
+  std::map<uint64_t, PageWatchStat> m_page_watches_;
 
   // 下一个要分配的断点 ID
   int m_next_breakpoint_id_;                                                   
+
+  // 快速跟踪点共用的环形缓冲区
+  TraceRing m_trace_ring_;
+
+  // 已移除的快速跟踪点的蹦床, 可能还有线程在其中执行, 所有线程离开后才归还
+  std::vector<uint64_t> m_retired_trampolines_;
+
+  // 越过断点或页保护访问的单步期间截获的信号, 由调用方取走后在恢复运行时注入
+  std::unordered_map<pid_t, int> m_step_signals_;
   
 public:
   BreakpointManager();
@@ -91,7 +177,7 @@ public:
   // 获取支持的硬件断点数量
   int get_hardware_registers_count(pid_t tid);
 
-  // 获取支持的硬件断点数量, 需要附加子进程后调用, 在这里会初始化 m_free_hardware_registers
+  // 读取支持的硬件断点数量, 只在第一次调用时通过 dbg_info 读取一次
   Base::Status init_hardware_register(pid_t tid);
 
   // 设置软件断点 
@@ -100,6 +186,80 @@ public:
   // 设置硬件断点
   int set_hardware_breakpoint(pid_t tid, uint64_t address, BreakpointType type);
 
+  // 设置进程级硬件执行断点, 占用所有线程中同一个空闲寄存器, 一次性写入 tids 中的所有线程
+  int set_process_hardware_breakpoint(const std::vector<pid_t>& tids, pid_t tid, uint64_t address);
+
+  // 新线程加入, 同步进程级硬件断点和观察点
+  Base::Status add_thread(pid_t tid);
+
+  // 线程退出, 清理该线程的记录
+  void remove_thread(pid_t tid);
+
+  // 设置观察点, 会和已有观察点合并后一次性写入 tids 中的所有线程
+  // length 任意, 寄存器能表示的是 1 ~ 8 字节以及按大小对齐的 2 的幂
+  // 寄存器无法表示, 寄存器不够或者范围太大时, 自动改用页保护, 命中后由 handle_page_fault 过滤
+  int set_watchpoint(pid_t pid, const std::vector<pid_t>& tids, pid_t tid, uint64_t address, size_t length, BreakpointType type);
+
+  // 处理 SIGSEGV, tid 必须停在出错的指令上
+  // 返回 -1 表示不是观察页引起的或者原始权限下也会出错, 信号应交给目标; 0 表示误报, 已越过访问; 否则返回命中的观察点 ID
+  int handle_page_fault(pid_t tid, uint64_t fault_address, int si_code);
+
+  // 根据 SIGTRAP 的 pc 和 siginfo 找到命中的断点, 找不到返回 -1
+  int find_hit_breakpoint(uint64_t pc, int si_code, uint64_t fault_address);
+
+  // 记录一次命中, 返回 true 表示不满足线程/栈帧条件或还在忽略次数内, 调用方应直接恢复运行
+  bool record_hit(pid_t tid, int breakpoint_id);
+
+  // 线程是否停在断点上
+  bool is_stopped_at_breakpoint(pid_t tid);
+
+  // 线程恢复运行前调用, 越过停下的断点并记录本次停留耗时
+  Base::Status prepare_resume(pid_t tid);
+
+  // 设置忽略次数
+  Base::Status set_ignore_count(int breakpoint_id, uint64_t count);
+
+  // pc 处启用的执行断点(软件或硬件), 没有返回 -1
+  int find_execution_breakpoint(uint64_t pc);
+
+  // 越过断点执行一条指令, 不计入命中
+  Base::Status step_over(pid_t tid, int breakpoint_id);
+
+  // 设置命中条件, 不满足条件的命中不计数, 越过后继续运行
+  Base::Status set_condition(int breakpoint_id, pid_t thread_filter, uint64_t frame_sp);
+
+  // 记录断点所在的模块和偏移
+  Base::Status set_module_location(int breakpoint_id, const std::string& module_path, uint64_t module_offset);
+
+  // 设置目标进程, 附加成功后调用
+  void set_pid(pid_t pid) { m_pid_ = pid; }
+
+  // exec 之后地址空间和调试寄存器都已被内核清空, 丢弃所有断点记录, 不写目标内存
+  void reset();
+
+  // fork 出的子进程内存中已经有父进程的 brk, 只复制启用的软件断点记录, 返回复制的数量
+  size_t inherit_software_breakpoints(const std::vector<Breakpoint>& breakpoints, pid_t tid);
+
+  // 获取页保护观察点的统计
+  std::vector<PageWatchStat> get_page_watch_stats();
+
+  // 设置快速跟踪点, 需要在目标进程中注入代码, pid 用于远程内存分配
+  // 原指令重定位后会破坏 x17 时 clobbers_ip1 置为 true(跳转目标超出 ±128MB, ldr literal)
+  int set_fast_tracepoint(pid_t pid, pid_t tid, uint64_t address, bool* clobbers_ip1 = nullptr);
+
+  // tids 中的线程都已暂停时调用, 归还没有线程在其中执行的蹦床
+  void reclaim_trampolines(const std::vector<pid_t>& tids);
+
+  // 取走单步期间截获的信号, 没有时返回 0
+  // 指令本身引起的同步异常(SIGSEGV 等)会让单步失败, 线程停在原指令上, 调用方注入信号后继续运行
+  int take_step_signal(pid_t tid);
+
+  // 取出快速跟踪点的命中记录
+  size_t read_trace_records(std::vector<TraceRecord>& records, size_t max_count);
+
+  // 快速跟踪点因缓冲区满丢弃的记录数
+  uint64_t get_trace_dropped();
+
   // 移除断点对象
   Base::Status remove_breakpoint(int breakpoint_id);
 
@@ -128,6 +288,44 @@ private:
 
   // 检查重复断点
   bool check_duplicate_breakpoint(uint64_t address);
+
+  // 地址索引仍指向该断点时移除
+  void erase_address_index(uint64_t address, int breakpoint_id);
+
+  // 在 tids 的所有线程中都空闲的寄存器
+  std::optional<DBRegister> find_free_hardware_register(const std::vector<pid_t>& tids);
+
+  // 是否为观察点类型
+  static bool is_watchpoint(BreakpointType type);
+
+  // 读取观察点寄存器数量
+  Base::Status init_watch_register(pid_t tid);
+
+  // 把所有启用的观察点按双字合并, 重叠或相邻的请求共用一个寄存器
+  std::vector<WatchSlot> build_watch_slots();
+
+  // 重新计算观察点寄存器并写入 tids 中的线程
+  Base::Status apply_watchpoints(const std::vector<pid_t>& tids);
+
+  // 把进程级硬件断点写入 tids 中的线程, enable 为 false 时清除启用位
+  Base::Status write_process_breakpoint(const Breakpoint& breakpoint, const std::vector<pid_t>& tids, bool enable);
+
+  // 重新计算需要保护的页, 通过 tid 注入 mprotect
+  Base::Status apply_page_watches(pid_t tid);
+
+  // 临时禁用断点, 单步越过后重新启用
+  // 软件断点不恢复原指令, 在异地单步缓冲区中执行重定位后的原指令, 其他线程运行时也不会错过断点
+  Base::Status step_over_breakpoint(pid_t tid, Breakpoint& breakpoint);
+
+  // 异地单步: 在缓冲区中单步执行重定位后的原指令, 离开缓冲区后修正 pc / lr
+  static constexpr size_t DISPLACED_STEP_SIZE = 32;
+  Base::Status displaced_step(pid_t tid, Breakpoint& breakpoint);
+
+  // 单步并等待暂停, 期间收到的异步信号保存后重新单步, 同步异常保存后返回 false
+  bool single_step(pid_t tid);
+
+  // 注入 mprotect 修改单页权限
+  bool protect_page(pid_t tid, uint64_t page, int prot);
 };
 
 }
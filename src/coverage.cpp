@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <set>
+
+#include "coverage.hpp"
+#include "assembly.hpp"
+#include "breakpoint_manager.hpp"
+#include "log.hpp"
+
+namespace Core
+{
+
+namespace
+{
+
+// 路径完全相同, 或者以 /module 结尾
+bool match_module(const std::string& pathname, const std::string& module)
+{
+  if (pathname == module) return true;
+  if (pathname.size() <= module.size()) return false;
+  return pathname.compare(pathname.size() - module.size(), module.size(), module) == 0 &&
+    pathname[pathname.size() - module.size() - 1] == '/';
+}
+
+}
+
+Base::Status CoverageCollector::start(pid_t pid, pid_t tid, const std::string& module, const std::vector<uint64_t>& offsets,
+  const std::function<bool(uint64_t)>& skip)
+{
+  if (is_active())
+    return Base::Status::fail("覆盖率收集已经在进行, 模块: {}", m_module_path);
+
+  auto& memory_control = MemoryControl::get_instance();
+
+  // 模块基址取该文件最低的映射地址
+  m_code_regions.clear();
+  m_base = UINT64_MAX;
+  m_end = 0;
+  for (const auto& region : memory_control.get_memory_regions(pid))
+  {
+    if (!match_module(region.pathname, module)) continue;
+
+    m_module_path = region.pathname;
+    m_base = std::min(m_base, region.start_address);
+    m_end = std::max(m_end, region.end_address);
+    if (region.is_executable())
+      m_code_regions.push_back(region);
+  }
+  if (m_code_regions.empty())
+    return Base::Status::fail("没有找到模块 {} 的可执行映射", module);
+
+  m_pid = pid;
+  std::vector<uint64_t> block_offsets = offsets.empty() ? discover_blocks(pid) : offsets;
+  std::sort(block_offsets.begin(), block_offsets.end());
+  block_offsets.erase(std::unique(block_offsets.begin(), block_offsets.end()), block_offsets.end());
+
+  // 只保留落在可执行段内且四字节对齐的块
+  auto in_code = [this](uint64_t address) {
+    for (const auto& region : m_code_regions)
+    {
+      if (address >= region.start_address && address + 4 <= region.end_address)
+        return true;
+    }
+    return false;
+  };
+
+  m_blocks.clear();
+  m_armed.clear();
+  m_hit_addresses.clear();
+  m_hit_count = 0;
+  std::vector<std::pair<uint64_t, uint32_t>> patches;
+  for (size_t i = 0; i < block_offsets.size(); ++i)
+  {
+    uint64_t address = m_base + block_offsets[i];
+    if ((address & 0x3) != 0 || !in_code(address) || skip(address)) continue;
+
+    uint32_t original = 0;
+    if (!memory_control.read_memory(pid, address, &original, sizeof(original)))
+      continue;
+
+    uint64_t next = i + 1 < block_offsets.size() ? block_offsets[i + 1] : block_offsets[i] + 4;
+    uint16_t size = static_cast<uint16_t>(std::min<uint64_t>(next - block_offsets[i], UINT16_MAX));
+
+    m_armed[address] = m_blocks.size();
+    m_blocks.push_back({block_offsets[i], size, original});
+    patches.emplace_back(address, Breakpoint::BRK_OPCODE);
+  }
+  m_bitmap.assign((m_blocks.size() + 7) / 8, 0);
+
+  if (patches.empty())
+    return Base::Status::fail("模块 {} 中没有可用的基本块", module);
+
+  if (!write_instructions(m_pid, tid, patches))
+  {
+    stop(tid);
+    return Base::Status::fail("写入覆盖率断点失败");
+  }
+
+  return Base::Status::success("开始收集 {} 的覆盖率, 基本块: {}", m_module_path, m_blocks.size());
+}
+
+Base::Status CoverageCollector::stop(pid_t tid)
+{
+  if (m_armed.empty())
+    return Base::Status::success("覆盖率收集没有在进行");
+
+  bool ok = write_instructions(m_pid, tid, armed_originals());
+  m_armed.clear();
+  if (!ok)
+    return Base::Status::fail("恢复覆盖率断点原指令失败, 目标进程可能被破坏");
+  return Base::Status::success("停止收集覆盖率, 命中: {} / {}", m_hit_count, m_blocks.size());
+}
+
+std::vector<std::pair<uint64_t, uint32_t>> CoverageCollector::armed_originals() const
+{
+  std::vector<std::pair<uint64_t, uint32_t>> patches;
+  patches.reserve(m_armed.size());
+  for (const auto& [address, index] : m_armed)
+    patches.emplace_back(address, m_blocks[index].original);
+  return patches;
+}
+
+bool CoverageCollector::handle_hit(pid_t tid, uint64_t pc)
+{
+  auto armed_it = m_armed.find(pc);
+  if (armed_it == m_armed.end())
+  {
+    // 多个线程同时执行到同一个 brk, 第一个线程恢复原指令后, 其余线程的陷阱才被处理
+    // brk 不推进 pc, 从原地重新执行原指令即可; pc 处又写入了 brk(用户断点)时交给调用方
+    if (m_hit_addresses.find(pc) == m_hit_addresses.end()) return false;
+    uint32_t code = 0;
+    if (!MemoryControl::get_instance().read_memory(tid, pc, &code, sizeof(code)) || code == Breakpoint::BRK_OPCODE)
+      return false;
+    LOG_DEBUG("线程 {} 在已命中的覆盖率块 0x{:x} 上的陷阱, 直接继续", tid, pc);
+    return true;
+  }
+
+  size_t index = armed_it->second;
+  if (!MemoryControl::get_instance().write_code(tid, pc, &m_blocks[index].original, sizeof(uint32_t)))
+  {
+    LOG_ERROR("恢复覆盖率断点 0x{:x} 原指令失败", pc);
+    return false;
+  }
+
+  m_armed.erase(armed_it);
+  m_hit_addresses.insert(pc);
+  m_bitmap[index / 8] |= static_cast<uint8_t>(1 << (index % 8));
+  ++m_hit_count;
+  return true;
+}
+
+bool CoverageCollector::disarm(pid_t tid, uint64_t address)
+{
+  auto armed_it = m_armed.find(address);
+  if (armed_it == m_armed.end()) return false;
+
+  if (!MemoryControl::get_instance().write_code(tid, address, &m_blocks[armed_it->second].original, sizeof(uint32_t)))
+    return false;
+  m_armed.erase(armed_it);
+  return true;
+}
+
+std::optional<uint32_t> CoverageCollector::original_instruction(uint64_t address) const
+{
+  auto armed_it = m_armed.find(address);
+  if (armed_it == m_armed.end()) return std::nullopt;
+  return m_blocks[armed_it->second].original;
+}
+
+std::vector<uint64_t> CoverageCollector::discover_blocks(pid_t pid)
+{
+  auto& memory_control = MemoryControl::get_instance();
+  auto& disassembly_control = Assembly::DisassemblyControl::get_instance();
+
+  std::set<uint64_t> starts;
+  for (const auto& region : m_code_regions)
+  {
+    std::vector<char> codes(region.size);
+    if (!memory_control.read_memory(pid, region.start_address, codes.data(), codes.size()))
+    {
+      LOG_WARNING("读取 {} 失败, 跳过", region.to_string());
+      continue;
+    }
+
+    starts.insert(region.start_address);
+    size_t offset = 0;
+    while (offset + 4 <= codes.size())
+    {
+      // capstone 遇到无法解析的数据会停下, 跳过一个字后继续
+      size_t chunk_size = std::min<size_t>(codes.size() - offset, 0x10000);
+      std::vector<char> chunk(codes.begin() + offset, codes.begin() + offset + chunk_size);
+      auto insns_opt = disassembly_control.disassemble(chunk, region.start_address + offset);
+      if (!insns_opt || insns_opt->empty())
+      {
+        offset += 4;
+        starts.insert(region.start_address + offset);
+        continue;
+      }
+
+      for (const auto& insn : insns_opt.value())
+      {
+        if (!insn.is_branch(insn.type)) continue;
+
+        // 跳转之后的指令开始新的块
+        starts.insert(insn.address + 4);
+
+        // 立即数目标总是最后一个立即数操作数: b / bl / b.cond 是第 0 个, cbz 是第 1 个, tbz 是第 2 个
+        for (int i = insn.op_count - 1; i >= 0; --i)
+        {
+          if (insn.ops[i].type == Assembly::Operand::type::IMM)
+          {
+            starts.insert(static_cast<uint64_t>(insn.ops[i].imm));
+            break;
+          }
+        }
+      }
+      offset += insns_opt->size() * 4;
+    }
+  }
+
+  std::vector<uint64_t> offsets;
+  offsets.reserve(starts.size());
+  for (uint64_t address : starts)
+  {
+    if (address >= m_base && address < m_end)
+      offsets.push_back(address - m_base);
+  }
+  LOG_DEBUG("{} 中发现 {} 个基本块", m_module_path, offsets.size());
+  return offsets;
+}
+
+bool CoverageCollector::write_instructions(pid_t pid, pid_t tid, const std::vector<std::pair<uint64_t, uint32_t>>& patches)
+{
+  auto& memory_control = MemoryControl::get_instance();
+
+  // 按 8 字节分组, 读一次写一次
+  std::map<uint64_t, std::vector<std::pair<uint64_t, uint32_t>>> words;
+  for (const auto& patch : patches)
+    words[patch.first & ~0x7ULL].push_back(patch);
+
+  bool all_ok = true;
+  for (const auto& [word_address, word_patches] : words)
+  {
+    uint8_t word[8];
+    if (!memory_control.read_memory(pid, word_address, word, sizeof(word)))
+    {
+      all_ok = false;
+      continue;
+    }
+
+    for (const auto& [address, value] : word_patches)
+      memcpy(word + (address - word_address), &value, sizeof(value));
+
+    if (!memory_control.write_code(tid, word_address, word, sizeof(word)))
+      all_ok = false;
+  }
+  return all_ok;
+}
+
+std::vector<uint8_t> CoverageCollector::export_drcov() const
+{
+  // drcov 第 2 版: 文本头部 + 模块表 + 二进制基本块表
+  std::string header = "DRCOV VERSION: 2\nDRCOV FLAVOR: drcov\n";
+  header += "Module Table: version 2, count 1\n";
+  header += "Columns: id, base, end, entry, checksum, timestamp, path\n";
+  header += fmt::format(" 0, 0x{:016x}, 0x{:016x}, 0x{:016x}, 0x{:08x}, 0x{:08x}, {}\n", m_base, m_end, 0, 0, 0, m_module_path);
+
+  size_t hit_blocks = 0;
+  for (size_t i = 0; i < m_blocks.size(); ++i)
+  {
+    if (m_bitmap[i / 8] & (1 << (i % 8))) ++hit_blocks;
+  }
+  header += fmt::format("BB Table: {} bbs\n", hit_blocks);
+
+  std::vector<uint8_t> result(header.begin(), header.end());
+  result.reserve(result.size() + hit_blocks * 8);
+  for (size_t i = 0; i < m_blocks.size(); ++i)
+  {
+    if (!(m_bitmap[i / 8] & (1 << (i % 8)))) continue;
+
+    // bb_entry_t: start(u32), size(u16), mod_id(u16)
+    uint32_t start = static_cast<uint32_t>(m_blocks[i].offset);
+    uint16_t size = m_blocks[i].size;
+    uint16_t module_id = 0;
+    const uint8_t* start_bytes = reinterpret_cast<const uint8_t*>(&start);
+    const uint8_t* size_bytes = reinterpret_cast<const uint8_t*>(&size);
+    const uint8_t* id_bytes = reinterpret_cast<const uint8_t*>(&module_id);
+    result.insert(result.end(), start_bytes, start_bytes + sizeof(start));
+    result.insert(result.end(), size_bytes, size_bytes + sizeof(size));
+    result.insert(result.end(), id_bytes, id_bytes + sizeof(module_id));
+  }
+  return result;
+}
+
+}
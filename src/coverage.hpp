@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "memory_control.hpp"
+#include "status.hpp"
+
+namespace Core
+{
+
+// 基本块覆盖率收集
+// 在每个基本块开头放一次性的 brk, 命中时恢复原指令并记录到位图, 线程直接继续运行, 不经过客户端
+class CoverageCollector
+{
+public:
+  // 按映射路径(完整路径或文件名)查找模块, offsets 是相对模块基址的基本块偏移, 为空时反汇编可执行段自动发现
+  // skip 返回 true 的地址不放 brk(已经有用户断点)
+  Base::Status start(pid_t pid, pid_t tid, const std::string& module, const std::vector<uint64_t>& offsets,
+    const std::function<bool(uint64_t)>& skip);
+
+  // 恢复所有未命中的块, 位图保留到下一次 start
+  Base::Status stop(pid_t tid);
+
+  // 是覆盖率的 brk 时恢复原指令, 记录命中并返回 true, 调用方直接让线程继续
+  // 已经命中过的块上迟到的陷阱也返回 true, 不报告给客户端
+  bool handle_hit(pid_t tid, uint64_t pc);
+
+  // 在 address 处放用户断点前先撤掉覆盖率的 brk
+  bool disarm(pid_t tid, uint64_t address);
+
+  // 所有未命中块的 (地址, 原指令), fork 出的子进程继承了这些 brk
+  std::vector<std::pair<uint64_t, uint32_t>> armed_originals() const;
+
+  // exec 之后地址空间已经替换, 丢弃未命中的 brk 记录, 位图保留
+  void reset() { m_armed.clear(); m_hit_addresses.clear(); }
+
+  // address 处仍是覆盖率的 brk 时返回原指令
+  std::optional<uint32_t> original_instruction(uint64_t address) const;
+
+  // 导出 drcov 格式, 只包含命中的块
+  std::vector<uint8_t> export_drcov() const;
+
+  bool is_active() const { return !m_armed.empty(); }
+  size_t block_count() const { return m_blocks.size(); }
+  size_t hit_count() const { return m_hit_count; }
+  const std::vector<uint8_t>& bitmap() const { return m_bitmap; }
+
+private:
+  struct Block
+  {
+    uint64_t offset;          // 相对模块基址
+    uint16_t size;            // 到下一个块开头的字节数, drcov 需要
+    uint32_t original;        // 原指令
+  };
+
+  pid_t m_pid = -1;
+  std::string m_module_path;
+  uint64_t m_base = 0;
+  uint64_t m_end = 0;
+  std::vector<MemoryRegion> m_code_regions;           // 模块的可执行段
+
+  std::vector<Block> m_blocks;                        // 按偏移排序
+  std::unordered_map<uint64_t, size_t> m_armed;       // 还没有命中的块, 地址 -> 下标
+  std::unordered_set<uint64_t> m_hit_addresses;       // 已经命中并恢复了原指令的块地址
+  std::vector<uint8_t> m_bitmap;                      // 第 i 位对应 m_blocks[i]
+  size_t m_hit_count = 0;
+
+  // 反汇编可执行段, 基本块开头是段开头, 跳转目标和跳转之后的指令
+  std::vector<uint64_t> discover_blocks(pid_t pid);
+
+  // 批量写入 (地址, 指令), 同一个 8 字节只读写一次, pid 是被读取的进程
+  bool write_instructions(pid_t pid, pid_t tid, const std::vector<std::pair<uint64_t, uint32_t>>& patches);
+};
+
+}
@@ -3,11 +3,14 @@
 #include "breakpoint_manager.hpp"
 #include "process.hpp"
 #include "register_control.hpp"
+#include "remote_control.hpp"
+#include "step_predictor.hpp"
 #include "status.hpp"
 #include "utils.hpp"
 #include "log.hpp"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <linux/wait.h>
@@ -16,8 +19,14 @@
 #include <sys/syscall.h>  
 #include <sys/types.h>
 #include <thread>
+#include <tuple>
+#include <unordered_set>
 #include <variant>
 
+#ifndef TRAP_BRKPT
+#define TRAP_BRKPT 1
+#endif
+
 
 using namespace Base;
 
@@ -33,6 +42,11 @@ breakpoint_manager(BreakpointManager())
 {
   m_pid = -1;
   m_current_tid = -1;
+  m_non_stop = false;
+  m_fork_policy = ForkPolicy::DETACH;
+  m_stop_on_exec = false;
+  m_load_notify_id = -1;
+  reset_signal_policies();
 }
 
 DebuggerCore::~DebuggerCore()
@@ -42,19 +56,176 @@ DebuggerCore::~DebuggerCore()
 
 Status DebuggerCore::get_threads(std::vector<pid_t>& threads)
 {
-  threads = m_tids;
+  threads = live_tids();
+  return Status::success("get_threads 成功");
+}
+
+Status DebuggerCore::get_threads(std::vector<ThreadInfo>& threads)
+{
+  threads.clear();
+  for (const auto& [tid, info] : m_threads)
+    threads.push_back(info);
   return Status::success("get_threads 成功");
 }
 
 Status DebuggerCore::switch_thread(pid_t tid)
 {
-  if (std::find(m_tids.begin(), m_tids.end(), tid) != m_tids.end())
+  if (has_thread(tid))
   {
     m_current_tid = tid;
     return Status::success("switch_thread 成功");
   }
   else  
-    return Status::fail("线程 {} 不在 m_tids 中", tid);
+    return Status::fail("线程 {} 不在线程表中", tid);
+}
+
+const char* ThreadInfo::state_to_string(ThreadState state)
+{
+  switch (state)
+  {
+    case ThreadState::RUNNING: return "running";
+    case ThreadState::STOPPED: return "stopped";
+    case ThreadState::EXITED: return "exited";
+  }
+  return "unknown";
+}
+
+const char* ThreadInfo::reason_to_string(StopReason reason)
+{
+  switch (reason)
+  {
+    case StopReason::NONE: return "none";
+    case StopReason::ATTACH: return "attach";
+    case StopReason::INTERRUPT: return "interrupt";
+    case StopReason::BREAKPOINT: return "breakpoint";
+    case StopReason::WATCHPOINT: return "watchpoint";
+    case StopReason::SINGLE_STEP: return "single_step";
+    case StopReason::SIGNAL: return "signal";
+    case StopReason::GROUP_STOP: return "group_stop";
+    case StopReason::EXIT: return "exit";
+    case StopReason::EXEC: return "exec";
+  }
+  return "unknown";
+}
+
+std::vector<pid_t> DebuggerCore::live_tids() const
+{
+  std::vector<pid_t> tids;
+  tids.reserve(m_threads.size());
+  for (const auto& [tid, info] : m_threads)
+  {
+    if (info.state != ThreadState::EXITED)
+      tids.push_back(tid);
+  }
+  return tids;
+}
+
+bool DebuggerCore::has_thread(pid_t tid) const
+{
+  auto it = m_threads.find(tid);
+  return it != m_threads.end() && it->second.state != ThreadState::EXITED;
+}
+
+void DebuggerCore::mark_stopped(pid_t tid, StopReason reason, int signal)
+{
+  ThreadInfo& info = m_threads[tid];
+  info.tid = tid;
+  info.state = ThreadState::STOPPED;
+  info.last_stop_reason = reason;
+  info.last_signal = signal;
+}
+
+void DebuggerCore::hold_stopped_thread(pid_t tid, StopReason reason, int signal)
+{
+  mark_stopped(tid, reason, signal);
+  m_current_tid = tid;
+
+  // 全停止模式: 其他线程也要停下, 在此期间到达的事件留到恢复后再处理
+  if (!m_non_stop)
+  {
+    Status s = pause();
+    if (s.is_fail())
+      LOG_WARNING("暂停其他线程失败: {}", s.c_str());
+  }
+
+  // exec 之后还有模块没有加载的断点, 每次暂停时检查一次
+  if (!m_pending_breakpoints.empty())
+    rearm_breakpoints();
+
+  // 全停止模式下所有线程都已暂停, 之前没能归还的蹦床再检查一次
+  if (!m_non_stop)
+    breakpoint_manager.reclaim_trampolines(live_tids());
+}
+
+Status DebuggerCore::check_thread_stopped(pid_t tid) const
+{
+  auto it = m_threads.find(tid);
+  if (it == m_threads.end() || it->second.state == ThreadState::EXITED)
+    return Status::fail("线程 {} 不存在", tid);
+  if (it->second.state != ThreadState::STOPPED)
+    return Status::fail("线程 {} 正在运行, 需要先暂停", tid);
+  return Status::success("线程 {} 已暂停", tid);
+}
+
+pid_t DebuggerCore::stopped_tid() const
+{
+  auto current_it = m_threads.find(m_current_tid);
+  if (current_it != m_threads.end() && current_it->second.state == ThreadState::STOPPED)
+    return m_current_tid;
+
+  for (const auto& [tid, info] : m_threads)
+  {
+    if (info.state == ThreadState::STOPPED)
+      return tid;
+  }
+  return -1;
+}
+
+Status DebuggerCore::with_all_stopped(const std::function<Status()>& action)
+{
+  std::vector<pid_t> interrupted_tids;
+  for (const auto& [tid, info] : m_threads)
+  {
+    if (info.state != ThreadState::RUNNING) continue;
+
+    if (Utils::ptrace_wrapper(PTRACE_INTERRUPT, tid, nullptr, nullptr))
+      interrupted_tids.push_back(tid);
+    else
+      LOG_WARNING("中断 {} 线程失败, errno({}): {}", tid, errno, strerror(errno));
+  }
+
+  std::vector<pid_t> stopped_tids;
+  for (const pid_t tid : interrupted_tids)
+  {
+    if (wait_interrupt_stop(tid, StopReason::INTERRUPT))
+      stopped_tids.push_back(tid);
+  }
+
+  Status s = action();
+
+  // 只恢复本次中断的线程, 中断期间截获的信号会在恢复时重新注入
+  for (const pid_t tid : stopped_tids)
+  {
+    Status resume_status = resume_thread(tid);
+    if (resume_status.is_fail())
+      LOG_WARNING("恢复 {} 线程失败: {}", tid, resume_status.c_str());
+  }
+  return s;
+}
+
+Status DebuggerCore::set_non_stop(bool enable)
+{
+  m_non_stop = enable;
+  return Status::success("已切换到{}模式", enable ? "不停止" : "全停止");
+}
+
+void DebuggerCore::remove_thread(pid_t tid)
+{
+  m_threads.erase(tid);
+  breakpoint_manager.remove_thread(tid);
+  m_syscall_tracer.forget_thread(tid);
+  if (m_current_tid == tid)
+    m_current_tid = m_threads.count(m_pid) ? m_pid : -1;
 }
 
 Status DebuggerCore::get_pid(pid_t& pid)
@@ -63,98 +234,260 @@ Status DebuggerCore::get_pid(pid_t& pid)
   return Status::success("get_pid 成功");
 }
 
+Status DebuggerCore::get_attach_stats(AttachStats& stats)
+{
+  if (m_attach_stats.rounds == 0)
+    return Status::fail("还没有附加过进程");
+
+  stats = m_attach_stats;
+  return Status::success("get_attach_stats 成功");
+}
+
 Status DebuggerCore::get_current_tid(pid_t& tid)
 {
   tid = m_current_tid;
   return Status::success("get_current_tid 成功");
 }
 
-bool DebuggerCore::set_default_ptrace_options(pid_t pid)
+long DebuggerCore::default_ptrace_options()
 {
   // todo: 退出事件自动 detach
 
   long ptrace_options = 0;
-  // // 跟踪进程退出事件: 被调试进程退出时会暂停, 调试器可获取返回码, 信号等
-  // ptrace_options |= PTRACE_O_TRACEEXIT;
-  // // 跟踪 clone() 事件, 被调试进程调用 clone() 创建线程或轻量级进程时会暂停, 调试器可获取新线程/进程的 pid
-  // ptrace_options |= PTRACE_O_TRACECLONE;
-  // // 跟踪 execve() 事件, 被调试进程执行 execve() 替换程序时会暂停, 新程序加载后但未执行前
-  // ptrace_options |= PTRACE_O_TRACEEXEC;
-  // // 跟踪 fork() 事件, 被调试进程调用 fork() 时会暂停, 调试器可通过 PTRACE_GETEVENTMSG 获取新子进程的 pid
-  // ptrace_options |= PTRACE_O_TRACEFORK;
-  // // 跟踪 vfork() 事件, 类似 TRACEFORK, 但针对 vfork(), 相比 fork(), vfork() 会暂停父进程直到子进程 exec 或退出
-  // ptrace_options |= PTRACE_O_TRACEVFORK;
-  // // 跟踪 vfork() 完成事件, vfork() 创建的子进程执行 exec 或退出后, 父进程恢复前会暂停
-  // ptrace_options |= PTRACE_O_TRACEVFORKDONE;
-
-  return Utils::ptrace_wrapper(PTRACE_SETOPTIONS, pid, nullptr, 
-    reinterpret_cast<void*>(ptrace_options), sizeof(long));
+  // 跟踪进程退出事件: 被调试进程退出时会暂停, 调试器可获取返回码, 信号等
+  // 线程在退出前暂停, 事件循环据此把线程标记为已退出
+  ptrace_options |= PTRACE_O_TRACEEXIT;
+  // 跟踪 clone() 事件, 被调试进程调用 clone() 创建线程或轻量级进程时会暂停, 调试器可获取新线程/进程的 pid
+  // 新线程自动附加, 在 wait_event 中同步进程级断点
+  ptrace_options |= PTRACE_O_TRACECLONE;
+  // 跟踪 seccomp 过滤器返回 SECCOMP_RET_TRACE 的系统调用, 没有安装过滤器时不会产生事件
+  ptrace_options |= PTRACE_O_TRACESECCOMP;
+  // 系统调用停止的信号为 SIGTRAP | 0x80, 与断点的 SIGTRAP 区分开
+  ptrace_options |= PTRACE_O_TRACESYSGOOD;
+  // 跟踪 execve() 事件, 被调试进程执行 execve() 替换程序时会暂停, 新程序加载后但未执行前
+  // 在 wait_event 中重建线程表并按模块偏移重新设置断点
+  ptrace_options |= PTRACE_O_TRACEEXEC;
+  // 跟踪 fork() 事件, 被调试进程调用 fork() 时会暂停, 调试器可通过 PTRACE_GETEVENTMSG 获取新子进程的 pid
+  // 子进程自动附加, 按 ForkPolicy 分离或保持暂停
+  ptrace_options |= PTRACE_O_TRACEFORK;
+  // 跟踪 vfork() 事件, 类似 TRACEFORK, 但针对 vfork(), 相比 fork(), vfork() 会暂停父进程直到子进程 exec 或退出
+  ptrace_options |= PTRACE_O_TRACEVFORK;
+  // 跟踪 vfork() 完成事件, vfork() 创建的子进程执行 exec 或退出后, 父进程恢复前会暂停
+  // 子进程共享内存期间恢复的断点在这里重新写入
+  ptrace_options |= PTRACE_O_TRACEVFORKDONE;
+
+  return ptrace_options;
 }
 
-Status DebuggerCore::attach(pid_t pid)
+pid_t DebuggerCore::wait_for_tid(pid_t tid, int& status)
 {
-  auto tids = proc_helper.get_thread_ids(pid);
-  if (tids.empty()) return Status::fail("获取线程 id 有误");
+  // 其他会话(或本会话之前)的 waitpid(-1) 可能已经收走了这个线程的事件
+  auto queued_it = std::find_if(m_event_queue.begin(), m_event_queue.end(),
+    [tid](const std::pair<pid_t, int>& event) { return event.first == tid; });
+  if (queued_it != m_event_queue.end())
+  {
+    status = queued_it->second;
+    m_event_queue.erase(queued_it);
+    return tid;
+  }
 
-  std::vector<pid_t> attached_tids;
+  // 先确认 tid 还能等待, 已经不是被跟踪的子线程时 waitpid(-1) 会一直阻塞
+  pid_t wpid = Utils::waitpid_wrapper(tid, &status, __WALL | WNOHANG);
+  if (wpid != 0) return wpid;
 
-  for (const auto& tid : tids)
+  // 等待期间收到的其他事件不能丢: 其他会话的交给它们, 本会话其他线程的留给事件循环
+  while (true)
+  {
+    wpid = Utils::waitpid_wrapper(-1, &status, __WALL);
+    if (wpid == -1)
+    {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (wpid == tid) return tid;
+
+    if (!owns_tid(wpid) && m_event_router && m_event_router(wpid, status))
+      continue;
+    queue_event(wpid, status);
+  }
+}
+
+bool DebuggerCore::wait_interrupt_stop(pid_t tid, StopReason reason)
+{
+  int status = 0;
+  if (wait_for_tid(tid, status) != tid)
+    return false;
+
+  return handle_interrupt_stop(tid, status, reason);
+}
+
+bool DebuggerCore::handle_interrupt_stop(pid_t tid, int status, StopReason reason)
+{
+  if (WIFEXITED(status) || WIFSIGNALED(status))
+  {
+    remove_thread(tid);
+    return false;
+  }
+
+  if (!WIFSTOPPED(status))
+    return false;
+
+  // 中断之前线程已经开始退出, 让它继续完成退出
+  if ((status >> 16) == PTRACE_EVENT_EXIT)
+  {
+    handle_exit_event(tid);
+    return false;
+  }
+
+  // 中断之前线程停在 fork / vfork / seccomp 事件上, 处理事件后就地暂停, 恢复后残留的中断由 wait_event 忽略
+  // seccomp 的出口不再跟踪, 和被 pause 打断时一样记为没有返回
+  bool trace_exit = false;
+  if (handle_sync_event(tid, status, trace_exit))
+  {
+    mark_stopped(tid, reason, SIGTRAP);
+    return true;
+  }
+
+  // exec 之后线程表和断点都要重建, 附加过程中还没有旧状态, 直接按暂停处理
+  if ((status >> 16) == PTRACE_EVENT_EXEC && m_pid > 0)
+  {
+    handle_exec_event(tid);
+    return true;
+  }
+
+  // 中断之前线程可能已经因为信号暂停, 中断会在下次恢复时再触发一次, 由 wait_event 忽略
+  // SIGTRAP 是断点, 恢复后会再次触发, 不需要保存
+  int stop_signal = WSTOPSIG(status);
+  if ((status >> 16) != PTRACE_EVENT_STOP && stop_signal != SIGTRAP && stop_signal != SIGSTOP)
   {
-    // 检查状态
-    auto state = proc_helper.get_process_state(tid);
+    LOG_DEBUG("线程 {} 暂停前收到信号 {}, 恢复时重新注入", tid, stop_signal);
+    m_threads[tid].pending_signal = deliverable_signal(stop_signal);
+  }
+
+  mark_stopped(tid, reason, stop_signal);
+  return true;
+}
 
-    if (state != Process::ProcessState::TRACING_STOP)
+Status DebuggerCore::attach(pid_t pid)
+{
+  using Clock = std::chrono::steady_clock;
+  auto elapsed_us = [](Clock::time_point from) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - from).count());
+  };
+
+  const long ptrace_options = default_ptrace_options();
+  m_attach_stats = AttachStats{};
+  auto attach_start = Clock::now();
+
+  // 先对所有线程发出 PTRACE_SEIZE + PTRACE_INTERRUPT, 不逐个等待
+  // 附加期间可能有新线程, 重新扫描直到没有新增, 被附加线程创建的线程会自动附加, 由 wait_event 处理
+  std::unordered_set<pid_t> seized_tids;
+  for (int round = 0; round < ATTACH_SCAN_ROUNDS; ++round)
+  {
+    auto phase_start = Clock::now();
+    auto tids = proc_helper.get_thread_ids(pid);
+    m_attach_stats.enumerate_us += elapsed_us(phase_start);
+    ++m_attach_stats.rounds;
+    if (tids.empty() && seized_tids.empty()) return Status::fail("获取线程 id 有误");
+
+    phase_start = Clock::now();
+    size_t seized_count = seized_tids.size();
+    for (const auto& tid : tids)
     {
-      if (!Utils::ptrace_wrapper(PTRACE_ATTACH, tid, nullptr, nullptr, 0))
+      if (seized_tids.count(tid) > 0) continue;
+
+      if (!Utils::ptrace_wrapper(PTRACE_SEIZE, tid, nullptr, reinterpret_cast<void*>(ptrace_options)))
       {
-        LOG_WARNING("附加到线程 " + std::to_string(tid) + " 失败");
+        // 重新扫描时, 已附加线程创建的线程已经被自动附加, 它的暂停由事件循环处理
+        if (errno == EPERM && round > 0 && is_traced_by_self(tid))
+        {
+          LOG_DEBUG("线程 {} 已经自动附加", tid);
+          ++m_attach_stats.already_attached;
+          continue;
+        }
+        LOG_WARNING("附加到线程 {} 失败", tid);
+        ++m_attach_stats.failed;
         continue;
       }
 
-      int status;
-      pid_t wpid = Utils::waitpid_wrapper(tid, &status, __WALL);
-      if (wpid < 0)
+      if (!Utils::ptrace_wrapper(PTRACE_INTERRUPT, tid, nullptr, nullptr))
       {
-        LOG_WARNING("线程 " + std::to_string(tid) + " 未停止");
+        LOG_WARNING("中断线程 {} 失败", tid);
+        Utils::ptrace_wrapper(PTRACE_DETACH, tid, nullptr, nullptr);
+        ++m_attach_stats.failed;
         continue;
       }
+
+      seized_tids.insert(tid);
     }
-    else  
-    {
-      // todo: 检查 status TracerPid 是不是调试器进程
+    m_attach_stats.seize_us += elapsed_us(phase_start);
+
+    if (seized_tids.size() == seized_count) break;
+  }
 
+  // 一个 waitpid(-1) 循环收集所有暂停, 不按 tid 顺序逐个阻塞
+  // 不在附加列表中的事件(自动附加的新线程, 其他会话的事件)交给事件循环
+  auto reap_start = Clock::now();
+  m_threads.clear();
+  std::unordered_set<pid_t> pending(seized_tids);
+  while (!pending.empty())
+  {
+    int status = 0;
+    pid_t wpid = Utils::waitpid_wrapper(-1, &status, __WALL);
+    if (wpid == -1)
+    {
+      if (errno == EINTR) continue;
+      break;
     }
 
-    if (!set_default_ptrace_options(tid))
+    if (pending.erase(wpid) == 0)
     {
-      LOG_WARNING("线程 " + std::to_string(tid) + " 设置选项失败");
+      if (!m_event_router || !m_event_router(wpid, status))
+        queue_event(wpid, status);
       continue;
     }
 
-    attached_tids.push_back(tid);
+    if (!handle_interrupt_stop(wpid, status, StopReason::ATTACH))
+    {
+      LOG_WARNING("线程 {} 未停止", wpid);
+      ++m_attach_stats.failed;
+    }
+  }
+  for (pid_t tid : pending)
+  {
+    LOG_WARNING("线程 {} 未停止", tid);
+    ++m_attach_stats.failed;
   }
+  m_attach_stats.reap_us = elapsed_us(reap_start);
+  m_attach_stats.total_us = elapsed_us(attach_start);
+  m_attach_stats.threads = m_threads.size();
 
-  if (attached_tids.empty())
+  if (m_threads.empty())
     return Status::fail("没有附加到任何线程");
 
   // 检查主线程
-  if (std::find(attached_tids.begin(), attached_tids.end(), pid) == attached_tids.end())
+  if (!has_thread(pid))
   {
     return Status::fail("主线程没有被附加");
   }
     
   m_pid = pid;
   m_current_tid = pid;
-  m_tids = attached_tids;
+  breakpoint_manager.set_pid(pid);
 
-  return Status::success("attach 成功");
+  LOG_DEBUG("附加 {} 个线程, 扫描 {} 次, 耗时 {} us (扫描 {} us, 附加 {} us, 等待暂停 {} us)",
+    m_attach_stats.threads, m_attach_stats.rounds, m_attach_stats.total_us,
+    m_attach_stats.enumerate_us, m_attach_stats.seize_us, m_attach_stats.reap_us);
+  return Status::success("attach 成功, 线程: {}, 耗时: {} us", m_attach_stats.threads, m_attach_stats.total_us);
 }
 
 Status DebuggerCore::attach(const std::string& package_name)
 {
   const auto& match_pids = proc_helper.find_pid_by_package_name(package_name);
+  if (match_pids.empty())
+    return Status::fail("没有找到包名 {} 对应的进程", package_name);
   if (match_pids.size() > 1)
-    LOG_WARNING("attach 是发现报名对应多个 pid");
+    LOG_WARNING("attach 是发现报名对应多个 pid, 使用主进程 {}", match_pids[0]);
 
   return attach(match_pids[0]);
 }
@@ -175,14 +508,21 @@ Status DebuggerCore::launch(const std::string& package_activity)
 
   std::this_thread::sleep_for(std::chrono::milliseconds(300));
 
-  // 找到 zygote 进程
-  std::vector<pid_t> zygote_pids = ps_helper.find_pid_by_process_name("zygote64", Process::PSHelper::MatchMode::EXACT, true);
-  if (zygote_pids.empty()) 
-    zygote_pids = ps_helper.find_pid_by_process_name("zygote", Process::PSHelper::MatchMode::EXACT, true);
-  if (zygote_pids.empty())
+  // 找到 zygote 进程, 扫描一次进程表, 优先 zygote64
+  pid_t zygote_pid = -1;
+  for (const auto& item : ps_helper.get_items())
+  {
+    if (item.name == "zygote64")
+    {
+      zygote_pid = item.pid;
+      break;
+    }
+    if (item.name == "zygote" && zygote_pid == -1)
+      zygote_pid = item.pid;
+  }
+  if (zygote_pid == -1)
     return Status("未找到 zygote 进程", StatusType::FAIL);
 
-  pid_t zygote_pid = zygote_pids[0];
   LOG_DEBUG("找到 zygote 进程 PID: " + std::to_string(zygote_pid));
 
   // 附加到 zygote 进程
@@ -314,6 +654,12 @@ Status DebuggerCore::launch(const std::string& package_activity)
         return Status::fail("zygote 进程异常退出, 无法捕获 app pid");
       }
     }
+    // 其他会话的事件交给它们, 和 attach 一样
+    else if (m_event_router && m_event_router(wpid, status))
+    {
+      continue;
+    }
+    // zygote fork 出的其他进程自动附加了, 让它们继续
     else  
     {
       Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr, 0);
@@ -333,50 +679,117 @@ Status DebuggerCore::launch(const std::string& package_activity)
     return Status::fail("附加到 app 进程失败: {}", attach_status.c_str());
 }
 
-Status DebuggerCore::detach()
+Status DebuggerCore::detach(bool force)
 {
   if (m_pid < 0) return Status::fail("m_pid 无效");
 
+  if (m_syscall_tracer.is_installed() && !force)
+    return Status::fail("进程 {} 安装过 seccomp 跟踪过滤器, 分离后被选中的系统调用会返回 ENOSYS, 确认后用 force 分离", m_pid);
+
+  // PTRACE_DETACH 要求线程处于暂停状态
+  pause();
+
+  // 保持暂停的子进程一起分离
+  for (pid_t child : std::vector<pid_t>(m_fork_children))
+    detach_fork_child(child);
+
+  // 分离后不能留下覆盖率的 brk
+  if (m_coverage.is_active())
+  {
+    Status s = m_coverage.stop(stopped_tid());
+    if (s.is_fail())
+      LOG_ERROR("分离前停止覆盖率收集失败: {}", s.c_str());
+  }
+
+  // 分离后执行到 brk 会被 SIGTRAP 杀死, 恢复断点和快速跟踪点改写过的代码
+  for (const auto& [address, code] : collect_original_code())
+  {
+    if (!memory_crl.write_code(m_pid, address, &code, sizeof(code)))
+      LOG_ERROR("分离前恢复 0x{:x} 处的代码失败", address);
+  }
+
+  // 分离后访问 PROT_NONE 或写保护的页会被 SIGSEGV 杀死, 注入 mprotect 恢复页观察点的原始权限
+  pid_t inject_tid = stopped_tid();
+  for (const auto& stat : breakpoint_manager.get_page_watch_stats())
+  {
+    if (stat.protect_prot == stat.original_prot) continue;
+    std::optional<uint64_t> result;
+    if (inject_tid > 0)
+      result = RemoteControl::get_instance().syscall(m_pid, inject_tid, SYS_mprotect,
+        {stat.page, static_cast<uint64_t>(Utils::get_page_size()), static_cast<uint64_t>(stat.original_prot)});
+    if (!result || RemoteControl::is_error(result.value()))
+      LOG_ERROR("分离前恢复页 0x{:x} 的权限失败", stat.page);
+  }
+
   bool all_ok = true;
   int success_count = 0;
 
   ::kill(m_pid, SIGCONT);
 
-  for (const auto& tid : m_tids)
+  std::vector<pid_t> tids = live_tids();
+  std::vector<pid_t> failed_tids;
+  for (const auto& tid : tids)
   {
-    if (Utils::ptrace_wrapper(PTRACE_DETACH, tid, nullptr, nullptr, 0))
+    // 暂停时截获的信号在分离时交还给线程, 否则会丢失
+    auto thread_it = m_threads.find(tid);
+    int signal = thread_it != m_threads.end() ? thread_it->second.pending_signal : 0;
+    if (Utils::ptrace_wrapper(PTRACE_DETACH, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(signal)), 0))
       success_count++;
-    else if (proc_helper.get_process_state(tid) == Process::ProcessState::ZOMBIE)
+    else
+      failed_tids.push_back(tid);
+  }
+
+  // 分离失败的线程一起检查状态, 已经是僵尸的不算失败
+  std::vector<Process::ProcessState> states;
+  proc_helper.get_thread_states(m_pid, failed_tids, states);
+  for (size_t i = 0; i < failed_tids.size(); ++i)
+  {
+    if (states[i] == Process::ProcessState::ZOMBIE)
     {
       success_count++;
-      LOG_DEBUG("产生僵尸进程 {}, 等待垃圾回收", tid);
+      LOG_DEBUG("产生僵尸进程 {}, 等待垃圾回收", failed_tids[i]);
     }
     else  
     {
-      LOG_WARNING("分离线程 {} 失败", tid);
+      LOG_WARNING("分离线程 {} 失败", failed_tids[i]);
       all_ok = false;
     }
   }
-
-  return all_ok ? Status::success("detach 成功") : Status::fail("部分线程分离, 成功率: {} / {}", success_count, m_tids.size());
+  proc_helper.release_thread_states(m_pid, failed_tids);
+  proc_helper.release_proc_fds(m_pid);
+
+  if (m_syscall_tracer.is_installed())
+    LOG_WARNING("进程 {} 安装过 seccomp 跟踪过滤器, 分离后被选中的系统调用会返回 ENOSYS", m_pid);
+  m_syscall_tracer.reset();
+
+  // 会话可能被下一次附加复用, 断点, 跟踪环和远程内存都属于旧进程
+  breakpoint_manager.reset();
+  m_coverage.reset();
+  m_pending_breakpoints.clear();
+  m_vfork_saved_code.clear();
+  RemoteControl::get_instance().reset(m_pid);
+  m_load_notify_id = -1;
+  m_pid = -1;
+  m_current_tid = -1;
+  m_threads.clear();
+  return all_ok ? Status::success("detach 成功") : Status::fail("部分线程分离, 成功率: {} / {}", success_count, tids.size());
 }
 
 Status DebuggerCore::kill()
 {
   if (m_pid < 0) return Status::fail("m_pid 无效");
 
-  if (proc_helper.get_process_state(m_pid) == Process::ProcessState::TRACING_STOP)
-    detach();
+  // 进程马上被杀死, 不需要关心残留的 seccomp 过滤器, detach 会清空 m_pid
+  pid_t pid = m_pid;
+  detach(true);
 
   // 等待一下确保内核完成 detach, 否则 kill 会不生效
   // 不同的机型会不会有不同的表现(等待时间长短)?
   std::this_thread::sleep_for(std::chrono::milliseconds(500));
 
-  if (::kill(m_pid, SIGKILL) != 0)
+  if (::kill(pid, SIGKILL) != 0)
     return Status::fail("kill 失败, errno: {}", strerror(errno));
 
-  m_pid = -1;
-  m_tids.clear();
   return Status::success("kill 成功");
 }
 
@@ -384,6 +797,9 @@ Status DebuggerCore::write_registers(nlohmann::json json_data)
 {
   // todo: 需要加上 DBG 吗?
 
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
   if (json_data.contains("GPR") && !json_data["GPR"].is_null())
   {
     const nlohmann::json& gpr_json = json_data["GPR"];
@@ -462,6 +878,9 @@ Status DebuggerCore::read_registers(nlohmann::json json_data, nlohmann::json& re
 {
   // todo: 需要加上 DBG 吗?
 
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
   if (json_data.contains("GPR") && !json_data["GPR"].is_null())
   {
     const nlohmann::json& gpr_req = json_data["GPR"];
@@ -605,16 +1024,38 @@ Status DebuggerCore::read_registers(nlohmann::json json_data, nlohmann::json& re
 
 Status DebuggerCore::set_breakpoint(BreakpointType type, uint64_t address, int& breakpoint_id)
 {
+  // 不停止模式下其他线程可能在运行, 写调试寄存器和代码前先让它们停下
+  if (m_non_stop)
+    return with_all_stopped([&]() { return set_breakpoint_impl(type, address, breakpoint_id); });
+  return set_breakpoint_impl(type, address, breakpoint_id);
+}
+
+Status DebuggerCore::set_breakpoint_impl(BreakpointType type, uint64_t address, int& breakpoint_id)
+{
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
+  // 覆盖率的 brk 会先于用户断点被处理, 先撤掉
+  m_coverage.disarm(m_current_tid, address);
 
+  bool clobbers_ip1 = false;
   if (type == BreakpointType::SOFTWARE)
   {
     breakpoint_id = breakpoint_manager.set_software_breakpoint(m_current_tid, address);
   }
-  else if (type == BreakpointType::HARDWARE_EXECUTION || 
-  type == BreakpointType::HARDWARE_READWRITE ||
+  else if (type == BreakpointType::HARDWARE_EXECUTION)
+  {
+    // 硬件断点对所有线程生效, 之后创建的线程也会自动同步
+    breakpoint_id = breakpoint_manager.set_process_hardware_breakpoint(live_tids(), m_current_tid, address);
+  }
+  else if (type == BreakpointType::HARDWARE_READWRITE ||
   type == BreakpointType::HARDWARE_WRITE)
   {
-    breakpoint_id = breakpoint_manager.set_hardware_breakpoint(m_current_tid, address, type);
+    return set_watchpoint_impl(type, address, 4, breakpoint_id);
+  }
+  else if (type == BreakpointType::FAST_TRACEPOINT)
+  {
+    breakpoint_id = breakpoint_manager.set_fast_tracepoint(m_pid, m_current_tid, address, &clobbers_ip1);
   }
   else 
   {
@@ -624,22 +1065,63 @@ Status DebuggerCore::set_breakpoint(BreakpointType type, uint64_t address, int&
 
   if (breakpoint_id == -1)
     return Status::fail("set_breakpoint 失败");
+
+  record_module_location(breakpoint_id, address);
+
+  // 跳转目标超出 ±128MB 或 ldr literal 时, 蹦床中执行原指令会破坏 x17
+  if (clobbers_ip1)
+    return Status::success("set_breakpoint 成功, 0x{:x} 处的原指令在蹦床中执行时会破坏 x17", address);
+  return Status::success("set_breakpoint 成功");
+}
+
+Status DebuggerCore::set_watchpoint(BreakpointType type, uint64_t address, size_t length, int& breakpoint_id)
+{
+  if (m_pid <= 0 || m_threads.empty())
+    return Status::fail("set_watchpoint: 未附加任何进程");
+
+  if (m_non_stop)
+    return with_all_stopped([&]() { return set_watchpoint_impl(type, address, length, breakpoint_id); });
+  return set_watchpoint_impl(type, address, length, breakpoint_id);
+}
+
+Status DebuggerCore::set_watchpoint_impl(BreakpointType type, uint64_t address, size_t length, int& breakpoint_id)
+{
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
+  // 观察点对所有线程生效
+  breakpoint_id = breakpoint_manager.set_watchpoint(m_pid, live_tids(), m_current_tid, address, length, type);
+
+  if (breakpoint_id == -1)
+    return Status::fail("set_watchpoint 失败");
   else  
-    return Status::success("set_breakpoint 成功");
+    return Status::success("set_watchpoint 成功");
 }
 
 Status DebuggerCore::remove_breakpoint(int breakpoint_id)
 {
-  return breakpoint_manager.remove_breakpoint(breakpoint_id);
+  // 快速跟踪点的蹦床要等所有线程停下并离开后才能归还
+  auto remove = [&]() {
+    Status s = breakpoint_manager.remove_breakpoint(breakpoint_id);
+    breakpoint_manager.reclaim_trampolines(live_tids());
+    return s;
+  };
+  if (m_non_stop)
+    return with_all_stopped(remove);
+  return remove();
 }
 
 Status DebuggerCore::enable_breakpoint(int breakpoint_id)
 {
+  if (m_non_stop)
+    return with_all_stopped([&]() { return breakpoint_manager.enable(breakpoint_id); });
   return breakpoint_manager.enable(breakpoint_id);
 }
 
 Status DebuggerCore::disable_breakpoint(int breakpoint_id)
 {
+  if (m_non_stop)
+    return with_all_stopped([&]() { return breakpoint_manager.disable(breakpoint_id); });
   return breakpoint_manager.disable(breakpoint_id);
 }
 
@@ -667,6 +1149,11 @@ Status DebuggerCore::get_breakpoint(uint64_t address, Breakpoint& breakpoint)
   }
 }
 
+Status DebuggerCore::set_ignore_count(int breakpoint_id, uint64_t count)
+{
+  return breakpoint_manager.set_ignore_count(breakpoint_id, count);
+}
+
 Status DebuggerCore::get_breakpoints(std::vector<Breakpoint>& breakpoints)
 {
   breakpoints = breakpoint_manager.get_breakpoints();
@@ -685,30 +1172,57 @@ Status DebuggerCore::get_breakpoints(pid_t tid, std::vector<Breakpoint>& breakpo
     return Status::success("get_breakpoints 成功");
 }
 
+Status DebuggerCore::get_page_watch_stats(std::vector<PageWatchStat>& stats)
+{
+  stats = breakpoint_manager.get_page_watch_stats();
+  return Status::success("get_page_watch_stats 成功");
+}
+
+Status DebuggerCore::read_trace_records(size_t max_count, std::vector<TraceRecord>& records, uint64_t& dropped)
+{
+  breakpoint_manager.read_trace_records(records, max_count);
+  dropped = breakpoint_manager.get_trace_dropped();
+  return Status::success("read_trace_records 成功");
+}
+
 Status DebuggerCore::resume_thread(pid_t tid)
 {
   // 检查线程是否存在
-  if (std::find(m_tids.begin(), m_tids.end(), tid) == m_tids.end())
+  if (!has_thread(tid))
     return Status::fail("resume_thread: 线程 {} 不存在", tid);
 
-  if (!Utils::ptrace_wrapper(PTRACE_CONT, tid, nullptr, nullptr))
+  // 停在断点上时先越过断点, 否则会立刻再次触发
+  // 原指令引起异常时没有越过, 线程停在原指令上, 注入信号后交给目标的信号处理
+  Status s = breakpoint_manager.prepare_resume(tid);
+  keep_step_signal(tid);
+  ThreadInfo& info = m_threads[tid];
+  if (s.is_fail() && info.pending_signal == 0)
+    return Status::fail("resume_thread: {}", s.c_str());
+
+  // 重新注入暂停时截获的信号
+  int signal = info.pending_signal;
+
+  if (!Utils::ptrace_wrapper(PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(signal))))
     return Status::fail("resume_thread: PTRACE_CONT 失败 tid={}", tid);
 
+  info.pending_signal = 0;
+  info.state = ThreadState::RUNNING;
   return Status::success("resume_thread 成功");
 }
 
 Status DebuggerCore::resume()
 {
-  if (m_pid <= 0 || m_tids.empty())
+  if (m_pid <= 0 || m_threads.empty())
     return Status::fail("resume: 未附加任何进程");
 
   bool all_ok = true;
   int success_count = 0;
 
-  for (const pid_t tid : m_tids)
+  std::vector<pid_t> tids = live_tids();
+  for (const pid_t tid : tids)
   {
-    // 有可能线程已经被恢复了, 这里检查一下状态, 避免调用 ptrace 导致错误
-    if (proc_helper.get_process_state(tid) == Process::ProcessState::TRACING_STOP)
+    // 有可能线程已经被恢复了, 只恢复暂停的线程, 避免调用 ptrace 导致错误
+    if (m_threads[tid].state == ThreadState::STOPPED)
     {
       Status s = resume_thread(tid);
       if (s.is_fail())
@@ -721,7 +1235,7 @@ Status DebuggerCore::resume()
     }
   }
   if (!all_ok) 
-    return Status::fail("部分线程恢复失败, 成功率: {} / {}", success_count, m_tids.size());
+    return Status::fail("部分线程恢复失败, 成功率: {} / {}", success_count, tids.size());
     
   LOG_DEBUG("恢复所有线程成功");
   return Status::success("resume 所有线程成功");
@@ -730,40 +1244,53 @@ Status DebuggerCore::resume()
 Status DebuggerCore::pause_thread(pid_t tid)
 {
   // 检查线程是否存在
-  if (std::find(m_tids.begin(), m_tids.end(), tid) == m_tids.end())
+  if (!has_thread(tid))
     return Status::fail("线程 {} 不存在", tid);
 
-  if (::kill(tid, SIGSTOP) != 0)
+  if (m_threads[tid].state == ThreadState::STOPPED)
+    return Status::success("线程 {} 已经暂停", tid);
+
+  if (!Utils::ptrace_wrapper(PTRACE_INTERRUPT, tid, nullptr, nullptr))
     return Status::fail("pause_thread 失败 tid: {}, errno({}): {}", tid, errno, strerror(errno));
 
+  if (!wait_interrupt_stop(tid, StopReason::INTERRUPT))
+    return Status::fail("pause_thread: 等待线程 {} 暂停失败", tid);
+
   return Status::success("pause_thread 成功");
 }
 
 Status DebuggerCore::pause()
 {
-  if (m_pid <= 0 || m_tids.empty())
+  if (m_pid <= 0 || m_threads.empty())
     return Status::fail("pause: 未附加任何进程");
 
+  // 先中断所有运行中的线程, 再统一收集暂停, 不逐个等待
+  std::vector<pid_t> interrupted_tids;
+  for (const auto& [tid, info] : m_threads)
+  {
+    if (info.state != ThreadState::RUNNING) continue;
+
+    if (Utils::ptrace_wrapper(PTRACE_INTERRUPT, tid, nullptr, nullptr))
+      interrupted_tids.push_back(tid);
+    else
+      LOG_ERROR("中断 {} 线程失败, errno({}): {}", tid, errno, strerror(errno));
+  }
+
   bool all_ok = true;
   int success_count = 0;
-
-  for (const pid_t tid : m_tids)
+  for (const pid_t tid : interrupted_tids)
   {
-    if (proc_helper.get_process_state(tid) != Process::ProcessState::TRACING_STOP)
+    if (wait_interrupt_stop(tid, StopReason::INTERRUPT))
+      success_count++;
+    else
     {
-      Status s = pause_thread(tid);
-      if (s.is_fail())
-      {
-        all_ok = false;
-        LOG_ERROR("暂停 {} 线程失败: {}", tid, s.c_str());
-      }
-      else
-        success_count++;
+      all_ok = false;
+      LOG_ERROR("等待 {} 线程暂停失败", tid);
     }
   }
 
-  if (!all_ok) 
-    return Status::fail("部分线程暂停失败, 成功率: {} / {}", success_count, m_tids.size());
+  if (!all_ok || success_count != static_cast<int>(interrupted_tids.size()))
+    return Status::fail("部分线程暂停失败, 成功率: {} / {}", success_count, interrupted_tids.size());
     
   LOG_DEBUG("暂停所有线程成功, pid={}", m_pid);
   return Status::success("pause 所有线程成功");
@@ -793,6 +1320,23 @@ Status DebuggerCore::step_into()
 
 Status DebuggerCore::hardware_step_into()
 {
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
+  // 停在断点上时, 越过断点本身就是一次单步
+  if (breakpoint_manager.is_stopped_at_breakpoint(m_current_tid))
+  {
+    Status s = breakpoint_manager.prepare_resume(m_current_tid);
+    keep_step_signal(m_current_tid);
+    return s;
+  }
+
+  if (m_coverage.is_active())
+  {
+    auto pc_opt = register_crl.get_gpr(m_current_tid, GPRegister::PC);
+    if (pc_opt) m_coverage.handle_hit(m_current_tid, pc_opt.value());
+  }
+
   if (!Utils::ptrace_wrapper(PTRACE_SINGLESTEP, m_current_tid, nullptr, nullptr))
   {
     return Status::fail("hardware_step_into: PTRACE_SINGLESTEP 失败 tid = {} errno = {}", m_current_tid, strerror(errno));
@@ -800,52 +1344,175 @@ Status DebuggerCore::hardware_step_into()
 
   // 等待线程停止
   int status = 0;
-  pid_t wpid = Utils::waitpid_wrapper(m_current_tid, &status, __WALL);
+  pid_t wpid = wait_for_tid(m_current_tid, status);
   if (wpid != m_current_tid && !WIFSTOPPED(status))
   {
     return Status::fail("hardware_step_into: waitpid 失败 tid={}", m_current_tid);
   }
 
+  mark_stopped(m_current_tid, StopReason::SINGLE_STEP, WSTOPSIG(status));
   return Status::success("hardware_step_into 成功 tid={}", m_current_tid);
 }
 
 Status DebuggerCore::single_step_impl(SingleStepMode mode)
 {
-  // 获取当前 PC
-  uint64_t pc = 0;
-  auto pc_opt = register_crl.get_gpr(m_current_tid, GPRegister::PC);
-  if (!pc_opt) return Status::fail("读取PC失败");
-  pc = pc_opt.value();
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
+  auto regs_opt = register_crl.get_all_gpr(m_current_tid);
+  if (!regs_opt) return Status::fail("读取寄存器失败");
+  const user_pt_regs regs = regs_opt.value();
+
+  auto insn_opt = decode_instruction(regs.pc);
+  if (!insn_opt) return Status::fail("解析 0x{:x} 处的指令失败", regs.pc);
 
-  // 下一条指令地址
-  uint64_t next_pc;
-  if (mode == SingleStepMode::STEP_OVER)
-    next_pc = pc + 4;
+  auto prediction_opt = StepPredictor::predict(insn_opt.value(), regs, register_crl.get_pac_insn_mask(m_current_tid));
+  if (!prediction_opt) return Status::fail("预测 0x{:x} 的下一条指令失败", regs.pc);
+  const auto& prediction = prediction_opt.value();
+
+  // 条件跳转两条路径都下断点, 最多两个
+  std::vector<uint64_t> targets;
+  if (mode == SingleStepMode::STEP_OVER && prediction.is_call)
+    targets.push_back(regs.pc + 4);
   else
-    return Status::fail("暂时不支持软件单步步入");
+  {
+    targets.push_back(prediction.next_pc);
+    if (prediction.alternate)
+      targets.push_back(prediction.alternate.value());
+  }
+
+  LOG_DEBUG("软件单步 {}: 0x{:x} -> 0x{:x}", insn_opt->to_string(), regs.pc, targets.front());
+  return run_to_temporary_breakpoints(targets);
+}
+
+std::optional<Assembly::Instruction> DebuggerCore::decode_instruction(uint64_t address)
+{
+  uint32_t code = 0;
+  if (!memory_crl.read_memory(m_pid, address, &code, sizeof(code)))
+    return std::nullopt;
+
+  // 软件断点和覆盖率断点处读到的是 brk, 需要换回原指令
+  auto breakpoint_opt = breakpoint_manager.get_breakpoint(address);
+  if (breakpoint_opt && breakpoint_opt->enabled && breakpoint_opt->type == BreakpointType::SOFTWARE)
+    code = breakpoint_opt->original_instruction;
+  else if (auto original_opt = m_coverage.original_instruction(address))
+    code = original_opt.value();
+
+  std::vector<char> codes(sizeof(code));
+  memcpy(codes.data(), &code, sizeof(code));
+  auto insns_opt = disassembly_crl.disassemble(codes, address);
+  if (!insns_opt || insns_opt->empty())
+    return std::nullopt;
+  return insns_opt->front();
+}
+
+Status DebuggerCore::run_to_temporary_breakpoints(const std::vector<uint64_t>& targets)
+{
+  std::vector<int> temporary_ids;
+  auto remove_temporary = [&]() {
+    for (const int id : temporary_ids)
+    {
+      Status s = breakpoint_manager.remove_breakpoint(id);
+      if (s.is_fail())
+        LOG_ERROR("移除临时断点 {} 失败: {}", id, s.c_str());
+    }
+  };
 
-  uint32_t original_insn = 0;
-  if (!memory_crl.read_memory(m_pid, next_pc, &original_insn, 4))
-    return Status::fail("读取下一条指令失败");
+  for (const uint64_t target : targets)
+  {
+    // 已经有断点的地址不用重复设置, 命中后同样会停下
+    if (breakpoint_manager.get_breakpoint(target)) continue;
 
-  auto bid = breakpoint_manager.set_software_breakpoint(m_current_tid, next_pc);
-  if (bid == -1)
-    return Status::fail("设置临时断点失败");
+    m_coverage.disarm(m_current_tid, target);
+    int id = breakpoint_manager.set_software_breakpoint(m_current_tid, target);
+    if (id == -1)
+    {
+      remove_temporary();
+      return Status::fail("在 0x{:x} 设置临时断点失败", target);
+    }
+    temporary_ids.push_back(id);
+  }
 
-  // 恢复执行
-  resume_thread(m_current_tid);
+  Status s = resume_thread(m_current_tid);
+  if (s.is_fail())
+  {
+    remove_temporary();
+    return s;
+  }
 
-  // 等待断点触发
+  // 等待当前线程暂停, 期间创建的线程加入线程表
   int status = 0;
-  pid_t wpid = Utils::waitpid_wrapper(m_current_tid, &status, __WALL);
-  
+  while (true)
+  {
+    pid_t wpid = wait_for_tid(m_current_tid, status);
+    if (wpid != m_current_tid || !WIFSTOPPED(status))
+      break;
+
+    // 组暂停不是到达临时断点, 继续运行并等待
+    if ((status >> 16) == PTRACE_EVENT_STOP)
+    {
+      LOG_DEBUG("线程 {} 在运行到临时断点期间进入组暂停, 继续运行", m_current_tid);
+      Utils::ptrace_wrapper(PTRACE_CONT, m_current_tid, nullptr, nullptr);
+      continue;
+    }
+
+    // fork / vfork / seccomp 事件处理后继续运行, 需要记录系统调用出口时运行到出口
+    bool trace_exit = false;
+    if (handle_sync_event(m_current_tid, status, trace_exit))
+    {
+      Utils::ptrace_wrapper(trace_exit ? PTRACE_SYSCALL : PTRACE_CONT, m_current_tid, nullptr, nullptr);
+      continue;
+    }
+    if ((status >> 16) != PTRACE_EVENT_CLONE)
+      break;
+
+    unsigned long new_tid = 0;
+    if (Utils::ptrace_wrapper(PTRACE_GETEVENTMSG, m_current_tid, nullptr, &new_tid, sizeof(new_tid)))
+    {
+      pid_t tid_value = static_cast<pid_t>(new_tid);
+      int new_status = 0;
+      if (m_threads.find(tid_value) == m_threads.end() &&
+        wait_for_tid(tid_value, new_status) == tid_value && WIFSTOPPED(new_status))
+        add_new_thread(tid_value);
+    }
+    Utils::ptrace_wrapper(PTRACE_CONT, m_current_tid, nullptr, nullptr);
+  }
+
+  // exec 之后临时断点随旧地址空间一起消失, 不能再往新程序中写回原指令
+  if (WIFSTOPPED(status) && (status >> 16) == PTRACE_EVENT_EXEC)
+  {
+    handle_exec_event(m_current_tid);
+    return Status::success("运行期间进程 {} 执行了新程序", m_pid);
+  }
+
   // 触发后先把断点指令恢复了, 避免影响后续执行
-  Status s = breakpoint_manager.remove_breakpoint(bid);
-  if (s.is_fail()) return s;
+  remove_temporary();
 
-  if (wpid != m_current_tid || !WIFSTOPPED(status)) 
+  if (WIFEXITED(status) || WIFSIGNALED(status))
+  {
+    remove_thread(m_current_tid);
+    return Status::fail("单步期间线程退出");
+  }
+  if (!WIFSTOPPED(status))
     return Status::fail("等待暂停失败");
 
+  if ((status >> 16) == PTRACE_EVENT_EXIT)
+  {
+    handle_exit_event(m_current_tid);
+    return Status::fail("单步期间线程退出");
+  }
+
+  // 被其他信号打断时保存信号, 恢复运行时重新注入
+  int stop_signal = WSTOPSIG(status);
+  if (stop_signal != SIGTRAP)
+  {
+    if (stop_signal != SIGSTOP)
+      m_threads[m_current_tid].pending_signal = deliverable_signal(stop_signal);
+    mark_stopped(m_current_tid, StopReason::SIGNAL, stop_signal);
+    return Status::success("单步被信号 {} 打断", stop_signal);
+  }
+
+  mark_stopped(m_current_tid, StopReason::SINGLE_STEP, stop_signal);
   return Status::success("软件单步完成");
 }
 
@@ -856,7 +1523,1169 @@ Status DebuggerCore::software_step_into()
 
 Status DebuggerCore::step_over()
 {
-  return single_step_impl(SingleStepMode::STEP_OVER);
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
+  auto regs_opt = register_crl.get_all_gpr(m_current_tid);
+  if (!regs_opt) return Status::fail("读取寄存器失败");
+  const user_pt_regs regs = regs_opt.value();
+
+  auto insn_opt = decode_instruction(regs.pc);
+  if (!insn_opt) return Status::fail("解析 0x{:x} 处的指令失败", regs.pc);
+
+  auto prediction_opt = StepPredictor::predict(insn_opt.value(), regs, register_crl.get_pac_insn_mask(m_current_tid));
+  if (!prediction_opt) return Status::fail("预测 0x{:x} 的下一条指令失败", regs.pc);
+
+  // 不是调用时和步入一样
+  if (!prediction_opt->is_call)
+    return step_into();
+
+  // bl / blr 不修改 sp, 返回后 sp 与调用前相同
+  // 递归中更深的调用至少分配了 16 字节栈帧, 它返回到同一地址时 sp 不大于 regs.sp - 16
+  return run_to_return(regs.pc + 4, regs.sp - 16);
+}
+
+Status DebuggerCore::step_out()
+{
+  Status stopped_status = check_thread_stopped(m_current_tid);
+  if (stopped_status.is_fail()) return stopped_status;
+
+  auto regs_opt = register_crl.get_all_gpr(m_current_tid);
+  if (!regs_opt) return Status::fail("读取寄存器失败");
+  const user_pt_regs regs = regs_opt.value();
+
+  // 正停在 ret 上, 单步一次就返回了
+  auto insn_opt = decode_instruction(regs.pc);
+  if (insn_opt && insn_opt->type == Assembly::Instruction::Type::RETURN)
+    return step_into();
+
+  uint64_t frame_bound = 0;
+  auto return_opt = find_return_address(regs, frame_bound);
+  if (!return_opt)
+    return Status::fail("无法确定 0x{:x} 所在函数的返回地址", regs.pc);
+
+  uint64_t return_address = StepPredictor::strip_pac(return_opt.value(), register_crl.get_pac_insn_mask(m_current_tid));
+  LOG_DEBUG("step_out: 线程 {} 运行到 0x{:x}", m_current_tid, return_address);
+
+  return run_to_return(return_address, frame_bound);
+}
+
+std::optional<uint64_t> DebuggerCore::find_return_address(const user_pt_regs& regs, uint64_t& frame_bound)
+{
+  uint64_t lr = regs.regs[30];
+  uint64_t fp = regs.regs[29];
+
+  // 读取 pc 之前的指令, 判断序言是否已经执行
+  std::vector<uint32_t> codes(STEP_OUT_SCAN_INSTRUCTIONS);
+  uint64_t scan_start = regs.pc - codes.size() * 4;
+  std::vector<uint32_t> preceding;
+  if (memory_crl.read_memory(m_pid, scan_start, codes.data(), codes.size() * 4))
+  {
+    preceding.reserve(codes.size());
+    for (size_t i = codes.size(); i > 0; --i)
+    {
+      uint32_t code = codes[i - 1];
+      uint64_t address = scan_start + (i - 1) * 4;
+      if (code == Breakpoint::BRK_OPCODE)
+      {
+        auto breakpoint_opt = breakpoint_manager.get_breakpoint(address);
+        if (breakpoint_opt && breakpoint_opt->type == BreakpointType::SOFTWARE)
+          code = breakpoint_opt->original_instruction;
+        else if (auto original_opt = m_coverage.original_instruction(address))
+          code = original_opt.value();
+      }
+      preceding.push_back(code);
+    }
+  }
+
+  auto frame_state = StepPredictor::classify_frame(preceding);
+
+  // 没找到特征指令时, x29 指向栈上时按帧记录处理
+  bool fp_on_stack = fp >= regs.sp && fp - regs.sp < STACK_FRAME_LIMIT;
+  if (frame_state == StepPredictor::FrameState::LINK_REGISTER ||
+    (frame_state == StepPredictor::FrameState::UNKNOWN && !fp_on_stack))
+  {
+    // 序言之前或叶子函数, 返回后 sp 等于当前 sp, 更深的递归调用的 sp 至少再小 16 字节
+    frame_bound = regs.sp - 16;
+    return lr;
+  }
+
+  // 调用方的 CFA 不小于 x29 + 16, 更深的递归栈帧都在 x29 以下
+  frame_bound = fp;
+
+  // 帧记录: [x29] 是上一个 x29, [x29 + 8] 是返回地址
+  uint64_t saved_lr = 0;
+  if (!memory_crl.read_memory(m_pid, fp + 8, &saved_lr, sizeof(saved_lr)))
+  {
+    LOG_WARNING("读取帧记录 0x{:x} 失败, 使用 lr", fp + 8);
+    return lr;
+  }
+  return saved_lr;
+}
+
+Status DebuggerCore::trace_instructions(pid_t tid, size_t max_count, uint64_t stop_address, bool record_registers, size_t& count)
+{
+  count = 0;
+  Status stopped_status = check_thread_stopped(tid);
+  if (stopped_status.is_fail()) return stopped_status;
+  if (max_count == 0)
+    return Status::fail("max_count 必须大于 0");
+
+  m_instruction_trace.begin(tid, record_registers);
+  auto start_time = std::chrono::steady_clock::now();
+
+  Status s = Status::success("到达最大条数");
+  while (true)
+  {
+    auto regs_opt = register_crl.get_all_gpr(tid);
+    if (!regs_opt)
+    {
+      s = Status::fail("读取线程 {} 寄存器失败", tid);
+      break;
+    }
+
+    m_instruction_trace.append(regs_opt.value());
+    if (m_instruction_trace.count() > 1 && regs_opt->pc == stop_address)
+    {
+      s = Status::success("到达停止地址 0x{:x}", stop_address);
+      break;
+    }
+    if (m_instruction_trace.count() >= max_count)
+      break;
+
+    s = step_instruction(tid, regs_opt->pc);
+    if (s.is_fail()) break;
+  }
+
+  count = m_instruction_trace.count();
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+  LOG_DEBUG("线程 {} 跟踪 {} 条指令, 耗时 {} us, 数据 {} 字节", tid, count, elapsed, m_instruction_trace.data().size());
+
+  if (has_thread(tid) && m_threads[tid].state == ThreadState::STOPPED && m_threads[tid].last_stop_reason != StopReason::SIGNAL)
+    mark_stopped(tid, StopReason::SINGLE_STEP, SIGTRAP);
+  return s;
+}
+
+Status DebuggerCore::step_instruction(pid_t tid, uint64_t pc)
+{
+  // 停在断点上或 pc 处有断点, 越过断点就是这一步, 期间截获的信号在恢复运行时注入
+  if (breakpoint_manager.is_stopped_at_breakpoint(tid))
+  {
+    Status s = breakpoint_manager.prepare_resume(tid);
+    keep_step_signal(tid);
+    return s;
+  }
+
+  int breakpoint_id = breakpoint_manager.find_execution_breakpoint(pc);
+  if (breakpoint_id != -1)
+  {
+    Status s = breakpoint_manager.step_over(tid, breakpoint_id);
+    keep_step_signal(tid);
+    return s;
+  }
+
+  // 覆盖率的 brk 直接记为命中并恢复原指令
+  m_coverage.handle_hit(tid, pc);
+
+  // clone, fork 等事件停在系统调用中间, 处理事件后再单步一次才算执行完
+  bool trace_exit = false;
+  while (true)
+  {
+    if (!Utils::ptrace_wrapper(PTRACE_SINGLESTEP, tid, nullptr, nullptr))
+      return Status::fail("PTRACE_SINGLESTEP 失败 tid={}, errno: {}", tid, strerror(errno));
+
+    int status = 0;
+    if (wait_for_tid(tid, status) != tid)
+      return Status::fail("等待线程 {} 失败", tid);
+
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+      remove_thread(tid);
+      return Status::fail("线程 {} 已退出", tid);
+    }
+    if (!WIFSTOPPED(status))
+      continue;
+
+    int event = status >> 16;
+    if (event == PTRACE_EVENT_EXIT)
+    {
+      handle_exit_event(tid);
+      return Status::fail("线程 {} 正在退出", tid);
+    }
+    if (event == PTRACE_EVENT_CLONE)
+    {
+      unsigned long new_tid = 0;
+      if (Utils::ptrace_wrapper(PTRACE_GETEVENTMSG, tid, nullptr, &new_tid, sizeof(new_tid)))
+      {
+        pid_t tid_value = static_cast<pid_t>(new_tid);
+        int new_status = 0;
+        if (m_threads.find(tid_value) == m_threads.end() &&
+          wait_for_tid(tid_value, new_status) == tid_value && WIFSTOPPED(new_status))
+          add_new_thread(tid_value);
+      }
+      continue;
+    }
+    if (event == PTRACE_EVENT_EXEC)
+    {
+      handle_exec_event(tid);
+      return Status::fail("单步期间进程 {} 执行了新程序", m_pid);
+    }
+
+    // seccomp 入口之后单步会执行完系统调用, 停下时再记录出口
+    bool event_trace_exit = false;
+    if (handle_sync_event(tid, status, event_trace_exit))
+    {
+      trace_exit |= event_trace_exit;
+      continue;
+    }
+
+    // 之前残留的 PTRACE_INTERRUPT
+    if (event == PTRACE_EVENT_STOP && WSTOPSIG(status) == SIGTRAP)
+      continue;
+
+    // 其他信号打断跟踪, 恢复运行时重新注入
+    int stop_signal = WSTOPSIG(status);
+    if (stop_signal != SIGTRAP)
+    {
+      if (stop_signal != SIGSTOP)
+        m_threads[tid].pending_signal = deliverable_signal(stop_signal);
+      mark_stopped(tid, StopReason::SIGNAL, stop_signal);
+      return Status::fail("线程 {} 收到信号 {}", tid, stop_signal);
+    }
+    if (trace_exit)
+      m_syscall_tracer.on_exit(tid);
+    return Status::success("单步完成");
+  }
+}
+
+Status DebuggerCore::read_instruction_trace(size_t offset, size_t size, std::vector<uint8_t>& data, size_t& total_size)
+{
+  const auto& buffer = m_instruction_trace.data();
+  total_size = buffer.size();
+  if (offset > total_size)
+    return Status::fail("偏移 {} 超出跟踪数据大小 {}", offset, total_size);
+
+  size = std::min(size, total_size - offset);
+  data.assign(buffer.begin() + offset, buffer.begin() + offset + size);
+  return Status::success("read_instruction_trace 成功");
+}
+
+Status DebuggerCore::start_coverage(const std::string& module, const std::vector<uint64_t>& offsets)
+{
+  if (m_pid < 0) return Status::fail("m_pid 无效");
+
+  // 批量写代码需要一个暂停的线程, 不停止模式下先让其他线程停下
+  auto start = [&]() {
+    pid_t tid = stopped_tid();
+    if (tid < 0) return Status::fail("没有处于暂停状态的线程");
+
+    // 已经有用户断点的地址不放覆盖率的 brk
+    auto has_breakpoint = [this](uint64_t address) { return breakpoint_manager.get_breakpoint(address).has_value(); };
+    return m_coverage.start(m_pid, tid, module, offsets, has_breakpoint);
+  };
+  return m_non_stop ? with_all_stopped(start) : start();
+}
+
+Status DebuggerCore::stop_coverage()
+{
+  auto stop = [&]() {
+    pid_t tid = stopped_tid();
+    if (tid < 0) return Status::fail("没有处于暂停状态的线程");
+    return m_coverage.stop(tid);
+  };
+  return m_non_stop ? with_all_stopped(stop) : stop();
+}
+
+Status DebuggerCore::export_coverage(std::vector<uint8_t>& data, size_t& block_count, size_t& hit_count)
+{
+  if (m_coverage.block_count() == 0)
+    return Status::fail("没有覆盖率数据");
+
+  data = m_coverage.export_drcov();
+  block_count = m_coverage.block_count();
+  hit_count = m_coverage.hit_count();
+  return Status::success("export_coverage 成功");
+}
+
+Status DebuggerCore::start_syscall_trace(const std::vector<int>& numbers, size_t capture_size)
+{
+  if (m_pid < 0) return Status::fail("m_pid 无效");
+
+  // 注入系统调用需要一个暂停的线程, TSYNC 要求其他线程不在修改 seccomp 状态
+  auto start = [&]() {
+    pid_t tid = stopped_tid();
+    if (tid < 0) return Status::fail("没有处于暂停状态的线程");
+    return m_syscall_tracer.start(m_pid, tid, numbers, capture_size);
+  };
+  return m_non_stop ? with_all_stopped(start) : start();
+}
+
+Status DebuggerCore::stop_syscall_trace()
+{
+  m_syscall_tracer.stop();
+  return Status::success("停止系统调用跟踪, 已安装的过滤器保留");
+}
+
+Status DebuggerCore::read_syscall_events(size_t max_size, std::vector<uint8_t>& data, size_t& count, uint64_t& dropped)
+{
+  count = m_syscall_tracer.read(data, max_size);
+  dropped = m_syscall_tracer.dropped();
+  return Status::success("read_syscall_events 成功");
+}
+
+Status DebuggerCore::run_to_return(uint64_t return_address, uint64_t frame_sp)
+{
+  pid_t tid = m_current_tid;
+
+  // 已经有断点的地址直接依赖它停下, 否则设置只对当前线程和当前栈帧生效的临时断点
+  int temporary_id = -1;
+  if (!breakpoint_manager.get_breakpoint(return_address))
+  {
+    m_coverage.disarm(tid, return_address);
+    temporary_id = breakpoint_manager.set_software_breakpoint(tid, return_address);
+    if (temporary_id == -1)
+      return Status::fail("在返回地址 0x{:x} 设置临时断点失败", return_address);
+    breakpoint_manager.set_condition(temporary_id, tid, frame_sp);
+  }
+
+  auto remove_temporary = [&]() {
+    if (temporary_id == -1) return;
+    Status s = breakpoint_manager.remove_breakpoint(temporary_id);
+    if (s.is_fail())
+      LOG_ERROR("移除临时断点 {} 失败: {}", temporary_id, s.c_str());
+  };
+
+  // 全停止模式下所有线程一起运行, 避免被调函数等待其他线程持有的锁
+  Status s = m_non_stop ? resume_thread(tid) : resume();
+  if (s.is_fail())
+  {
+    remove_temporary();
+    return s;
+  }
+
+  // 其他线程或更深的栈帧命中临时断点时在 wait_event 内部越过, 不会返回
+  pid_t stop_tid = -1;
+  int stop_signal = 0;
+  s = wait_event(RUN_TO_RETURN_TIMEOUT_MS, stop_tid, stop_signal);
+  if (s.is_fail())
+  {
+    Status pause_status = m_non_stop ? pause_thread(tid) : pause();
+    remove_temporary();
+    if (pause_status.is_fail())
+      return Status::fail("等待返回失败: {}, 暂停线程失败: {}", s.c_str(), pause_status.c_str());
+    return Status::fail("等待返回失败: {}, 线程已暂停", s.c_str());
+  }
+
+  remove_temporary();
+
+  // 在被调函数中遇到其他断点或信号时停在那里
+  auto pc_opt = register_crl.get_gpr(stop_tid, GPRegister::PC);
+  if (stop_tid != tid || !pc_opt || pc_opt.value() != return_address)
+    return Status::success("运行到返回地址前暂停: {}", s.c_str());
+
+  m_threads[tid].last_stop_reason = StopReason::SINGLE_STEP;
+  return Status::success("已返回到 0x{:x}", return_address);
+}
+
+Status DebuggerCore::wait_event(int timeout_ms, pid_t& tid, int& signal)
+{
+  if (m_pid <= 0 || m_threads.empty())
+    return Status::fail("wait_event: 未附加任何进程");
+
+  auto start_time = std::chrono::steady_clock::now();
+  while (true)
+  {
+    auto result_opt = poll_event(tid, signal);
+    if (result_opt) return result_opt.value();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start_time).count();
+    if (elapsed > timeout_ms)
+      return Status::fail("wait_event: 等待超时");
+
+    // 阻塞到有新的 SIGCHLD, 不再定时轮询
+    Utils::wait_child_signal(static_cast<int>(timeout_ms - elapsed));
+  }
+}
+
+std::optional<Status> DebuggerCore::poll_event(pid_t& tid, int& signal)
+{
+  while (true)
+  {
+    // 先处理其他会话转交过来的事件
+    int status = 0;
+    pid_t wpid = 0;
+    if (!m_event_queue.empty())
+    {
+      std::tie(wpid, status) = m_event_queue.front();
+      m_event_queue.pop_front();
+    }
+    else
+    {
+      wpid = Utils::waitpid_wrapper(-1, &status, __WALL | WNOHANG);
+      if (wpid < 0)
+        return Status::fail("wait_event: 等待进程事件失败, errno = {}", strerror(errno));
+      if (wpid == 0)
+        return std::nullopt;
+
+      // waitpid(-1) 会收到同一调试器中其他会话的事件, 交给它们的队列
+      if (!owns_tid(wpid) && m_event_router && m_event_router(wpid, status))
+        continue;
+    }
+
+    auto result_opt = handle_wait_status(wpid, status, tid, signal);
+    if (result_opt) return result_opt;
+  }
+}
+
+std::optional<Status> DebuggerCore::handle_wait_status(pid_t wpid, int status, pid_t& tid, int& signal)
+{
+  // 线程退出
+  if (WIFEXITED(status) || WIFSIGNALED(status))
+  {
+    remove_thread(wpid);
+    if (wpid != m_pid) return std::nullopt;
+
+    // 进程退出, pid 之后可能被复用
+    proc_helper.release_proc_fds(wpid);
+
+    tid = wpid;
+    signal = 0;
+    return Status::success("进程 {} 已退出", wpid);
+  }
+
+  if (!WIFSTOPPED(status)) return std::nullopt;
+  int stop_signal = WSTOPSIG(status);
+
+  // 新线程的初始暂停可能比 clone 事件先到
+  if (m_threads.find(wpid) == m_threads.end())
+  {
+    // exec 时被内核回收的旧线程
+    if ((status >> 16) == PTRACE_EVENT_EXIT)
+    {
+      Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr);
+      return std::nullopt;
+    }
+
+    // fork 出的子进程也可能比 fork 事件先到, 留给 handle_fork_event 处理
+    if (is_foreign_process(wpid))
+    {
+      m_unclaimed_children.push_back(wpid);
+      return std::nullopt;
+    }
+
+    add_new_thread(wpid);
+    return std::nullopt;
+  }
+
+  // 线程即将退出, 记录退出状态后让它继续, 被回收时再从线程表中移除
+  if (stop_signal == SIGTRAP && (status >> 16) == PTRACE_EVENT_EXIT)
+  {
+    handle_exit_event(wpid);
+    return std::nullopt;
+  }
+
+  // seccomp 选中的系统调用入口, 需要记录时运行到出口
+  if (stop_signal == SIGTRAP && (status >> 16) == PTRACE_EVENT_SECCOMP)
+  {
+    bool trace_exit = m_syscall_tracer.on_entry(wpid);
+    Utils::ptrace_wrapper(trace_exit ? PTRACE_SYSCALL : PTRACE_CONT, wpid, nullptr, nullptr);
+    return std::nullopt;
+  }
+
+  // 系统调用出口
+  if (stop_signal == (SIGTRAP | 0x80))
+  {
+    m_syscall_tracer.on_exit(wpid);
+    Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr);
+    return std::nullopt;
+  }
+
+  // PTRACE_EVENT_STOP: SIGTRAP 是之前残留的 PTRACE_INTERRUPT, 直接继续; 其他是组暂停, 报告给调用方
+  if ((status >> 16) == PTRACE_EVENT_STOP)
+  {
+    if (stop_signal == SIGTRAP)
+    {
+      Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr);
+      return std::nullopt;
+    }
+
+    hold_stopped_thread(wpid, StopReason::GROUP_STOP, stop_signal);
+    tid = wpid;
+    signal = stop_signal;
+    return Status::success("线程 {} 组暂停, 信号: {}", wpid, stop_signal);
+  }
+
+  // fork / vfork 事件, 按策略处理子进程后父进程继续运行
+  if (stop_signal == SIGTRAP && ((status >> 16) == PTRACE_EVENT_FORK || (status >> 16) == PTRACE_EVENT_VFORK))
+  {
+    handle_fork_event(wpid, (status >> 16) == PTRACE_EVENT_VFORK);
+    Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr);
+    return std::nullopt;
+  }
+
+  // vfork 的子进程已经 exec 或退出, 重新写入共享内存期间恢复的代码
+  if (stop_signal == SIGTRAP && (status >> 16) == PTRACE_EVENT_VFORK_DONE)
+  {
+    rewrite_vfork_code(wpid);
+    Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr);
+    return std::nullopt;
+  }
+
+  // exec 之后地址空间已经替换
+  if (stop_signal == SIGTRAP && (status >> 16) == PTRACE_EVENT_EXEC)
+  {
+    if (!handle_exec_event(wpid))
+    {
+      Utils::ptrace_wrapper(PTRACE_CONT, m_pid, nullptr, nullptr);
+      m_threads[m_pid].state = ThreadState::RUNNING;
+      return std::nullopt;
+    }
+
+    hold_stopped_thread(m_pid, StopReason::EXEC, 0);
+    tid = m_pid;
+    signal = 0;
+    return Status::success("进程 {} 执行了新程序", m_pid);
+  }
+
+  // clone 事件, 等新线程停下后同步进程级断点, 然后两个线程都继续运行
+  if (stop_signal == SIGTRAP && (status >> 16) == PTRACE_EVENT_CLONE)
+  {
+    unsigned long new_tid = 0;
+    if (Utils::ptrace_wrapper(PTRACE_GETEVENTMSG, wpid, nullptr, &new_tid, sizeof(new_tid)))
+    {
+      pid_t tid_value = static_cast<pid_t>(new_tid);
+      if (m_threads.find(tid_value) == m_threads.end())
+      {
+        int new_status = 0;
+        if (wait_for_tid(tid_value, new_status) == tid_value && WIFSTOPPED(new_status))
+          add_new_thread(tid_value);
+        else
+          LOG_WARNING("等待新线程 {} 暂停失败", tid_value);
+      }
+    }
+    Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr);
+    return std::nullopt;
+  }
+
+  // 页保护观察点引起的 SIGSEGV, 误报时越过访问后继续运行
+  if (stop_signal == SIGSEGV)
+  {
+    siginfo_t info;
+    if (Utils::ptrace_wrapper(PTRACE_GETSIGINFO, wpid, nullptr, &info, sizeof(info)))
+    {
+      int hit_id = breakpoint_manager.handle_page_fault(wpid, reinterpret_cast<uint64_t>(info.si_addr), info.si_code);
+      if (hit_id == 0)
+      {
+        continue_after_step(wpid);
+        return std::nullopt;
+      }
+      else if (hit_id > 0)
+      {
+        // 在忽略次数内, 访问已经越过, 直接继续运行
+        if (breakpoint_manager.record_hit(wpid, hit_id))
+        {
+          breakpoint_manager.prepare_resume(wpid);
+          continue_after_step(wpid);
+          return std::nullopt;
+        }
+
+        keep_step_signal(wpid);
+        hold_stopped_thread(wpid, StopReason::WATCHPOINT, stop_signal);
+        tid = wpid;
+        signal = 0;
+        return Status::success("线程 {} 命中观察点 {}", wpid, hit_id);
+      }
+    }
+  }
+
+  // 断点命中, 在忽略次数内时越过断点后直接继续运行
+  if (stop_signal == SIGTRAP && (status >> 16) == 0)
+  {
+    siginfo_t info;
+    auto pc_opt = register_crl.get_gpr(wpid, GPRegister::PC);
+    bool has_info = pc_opt && Utils::ptrace_wrapper(PTRACE_GETSIGINFO, wpid, nullptr, &info, sizeof(info));
+
+    // 覆盖率的 brk 只记录命中, 恢复原指令后从原地继续, 单步等其他陷阱不经过这里
+    if (has_info && info.si_code == TRAP_BRKPT && m_coverage.handle_hit(wpid, pc_opt.value()))
+    {
+      Utils::ptrace_wrapper(PTRACE_CONT, wpid, nullptr, nullptr);
+      return std::nullopt;
+    }
+
+    if (has_info)
+    {
+      int hit_id = breakpoint_manager.find_hit_breakpoint(pc_opt.value(), info.si_code, reinterpret_cast<uint64_t>(info.si_addr));
+      if (hit_id > 0 && hit_id == m_load_notify_id)
+      {
+        handle_load_notify(wpid);
+        return std::nullopt;
+      }
+      if (hit_id > 0)
+      {
+        if (breakpoint_manager.record_hit(wpid, hit_id))
+        {
+          Status s = breakpoint_manager.prepare_resume(wpid);
+          if (s.is_fail())
+            LOG_WARNING("越过断点 {} 失败: {}", hit_id, s.c_str());
+          continue_after_step(wpid);
+          return std::nullopt;
+        }
+
+        hold_stopped_thread(wpid, StopReason::BREAKPOINT, stop_signal);
+        tid = wpid;
+        signal = 0;
+        return Status::success("线程 {} 命中断点 {}", wpid, hit_id);
+      }
+    }
+  }
+
+  // 其他信号按策略处理, 不需要暂停的直接注入或吞掉后继续运行
+  if (stop_signal != SIGTRAP && stop_signal != SIGSTOP && !apply_signal_policy(wpid, stop_signal))
+    return std::nullopt;
+
+  hold_stopped_thread(wpid, StopReason::SIGNAL, stop_signal);
+  tid = wpid;
+  signal = stop_signal;
+  return Status::success("线程 {} 暂停, 信号: {}", wpid, stop_signal);
+}
+
+void DebuggerCore::reset_signal_policies()
+{
+  m_signal_policies.fill(SignalPolicy());
+
+  // ART 用 SIGSEGV 实现隐式空指针检查和栈溢出检查, 启动时会有成千上万次, 真正的崩溃最终会 abort
+  m_signal_policies[SIGSEGV] = {false, false, true, 0};
+  // SIGQUIT 用于输出线程堆栈
+  m_signal_policies[SIGQUIT] = {false, true, true, 0};
+
+  // 频繁且无害的信号
+  for (int signal : {SIGCHLD, SIGWINCH, SIGALRM, SIGURG, SIGPROF, SIGIO, SIGPIPE})
+    m_signal_policies[signal] = {false, false, true, 0};
+
+  // 实时信号被 bionic 和 ART 内部使用(线程挂起, 性能采样等)
+  for (int signal = SIGRTMIN; signal <= SIGRTMAX && signal < NSIG; ++signal)
+    m_signal_policies[signal] = {false, false, true, 0};
+}
+
+bool DebuggerCore::apply_signal_policy(pid_t tid, int signal)
+{
+  if (signal <= 0 || signal >= NSIG)
+  {
+    m_threads[tid].pending_signal = signal;
+    return true;
+  }
+
+  SignalPolicy& policy = m_signal_policies[signal];
+  ++policy.received;
+  if (policy.print)
+    LOG_WARNING("线程 {} 收到信号 {} ({}), {}", tid, signal, strsignal(signal), policy.stop ? "暂停" : (policy.pass ? "传递" : "忽略"));
+
+  int deliver = policy.pass ? signal : 0;
+  if (policy.stop)
+  {
+    m_threads[tid].pending_signal = deliver;
+    return true;
+  }
+
+  m_threads[tid].last_signal = signal;
+  if (!Utils::ptrace_wrapper(PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(deliver))))
+  {
+    // 没能恢复运行时按暂停处理, 信号留到下次恢复
+    m_threads[tid].pending_signal = deliver;
+    return true;
+  }
+  return false;
+}
+
+void DebuggerCore::keep_step_signal(pid_t tid)
+{
+  int signal = deliverable_signal(breakpoint_manager.take_step_signal(tid));
+  if (signal == 0) return;
+
+  int& pending_signal = m_threads[tid].pending_signal;
+  if (pending_signal != 0 && pending_signal != signal)
+    LOG_WARNING("线程 {} 已有待注入的信号 {}, 丢弃单步期间收到的信号 {}", tid, pending_signal, signal);
+  else
+    pending_signal = signal;
+}
+
+bool DebuggerCore::continue_after_step(pid_t tid)
+{
+  keep_step_signal(tid);
+  ThreadInfo& info = m_threads[tid];
+  if (!Utils::ptrace_wrapper(PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(info.pending_signal))))
+    return false;
+  info.pending_signal = 0;
+  return true;
+}
+
+int DebuggerCore::deliverable_signal(int signal) const
+{
+  if (signal <= 0 || signal >= NSIG) return signal;
+  return m_signal_policies[signal].pass ? signal : 0;
+}
+
+Status DebuggerCore::set_signal_policy(int signal, bool stop, bool print, bool pass)
+{
+  if (signal <= 0 || signal >= NSIG)
+    return Status::fail("无效的信号: {}", signal);
+  if (signal == SIGKILL || signal == SIGSTOP || signal == SIGTRAP)
+    return Status::fail("信号 {} 由调试器使用, 不能修改策略", signal);
+
+  SignalPolicy& policy = m_signal_policies[signal];
+  policy.stop = stop;
+  policy.print = print;
+  policy.pass = pass;
+  return Status::success("信号 {} 策略: stop={} print={} pass={}", signal, stop, print, pass);
+}
+
+Status DebuggerCore::get_signal_policies(std::map<int, SignalPolicy>& policies)
+{
+  policies.clear();
+  for (int signal = 1; signal < NSIG; ++signal)
+    policies[signal] = m_signal_policies[signal];
+  return Status::success("get_signal_policies 成功");
+}
+
+Status DebuggerCore::set_follow_policy(ForkPolicy fork_policy, bool stop_on_exec)
+{
+  m_fork_policy = fork_policy;
+  m_stop_on_exec = stop_on_exec;
+  return Status::success("fork: {}, exec 后{}", fork_policy == ForkPolicy::KEEP ? "保持跟踪" : "分离", stop_on_exec ? "暂停" : "继续运行");
+}
+
+Status DebuggerCore::get_fork_children(std::vector<pid_t>& children)
+{
+  children = m_fork_children;
+  return Status::success("get_fork_children 成功");
+}
+
+Status DebuggerCore::detach_fork_child(pid_t pid)
+{
+  auto child_it = std::find(m_fork_children.begin(), m_fork_children.end(), pid);
+  if (child_it == m_fork_children.end())
+    return Status::fail("{} 不是保持跟踪的子进程", pid);
+
+  m_fork_children.erase(child_it);
+  return detach_child_process(pid);
+}
+
+bool DebuggerCore::is_foreign_process(pid_t tid)
+{
+  auto status = proc_helper.parse_status(tid);
+  auto tgid_it = status.find("Tgid");
+  if (tgid_it == status.end()) return false;
+  return static_cast<pid_t>(std::strtol(tgid_it->second.c_str(), nullptr, 10)) != m_pid;
+}
+
+bool DebuggerCore::is_traced_by_self(pid_t tid)
+{
+  auto status = proc_helper.parse_status(tid);
+  auto tracer_it = status.find("TracerPid");
+  if (tracer_it == status.end()) return false;
+  return static_cast<pid_t>(std::strtol(tracer_it->second.c_str(), nullptr, 10)) == getpid();
+}
+
+bool DebuggerCore::owns_tid(pid_t tid)
+{
+  if (m_pid <= 0) return false;
+  if (tid == m_pid || m_threads.count(tid) > 0) return true;
+  if (std::find(m_fork_children.begin(), m_fork_children.end(), tid) != m_fork_children.end()) return true;
+
+  // 还没有加入线程表的新线程属于同一线程组, fork 出的子进程的父进程是本进程
+  auto status = proc_helper.parse_status(tid);
+  auto tgid_it = status.find("Tgid");
+  auto ppid_it = status.find("PPid");
+  if (tgid_it != status.end() && static_cast<pid_t>(std::strtol(tgid_it->second.c_str(), nullptr, 10)) == m_pid)
+    return true;
+  return ppid_it != status.end() && static_cast<pid_t>(std::strtol(ppid_it->second.c_str(), nullptr, 10)) == m_pid;
+}
+
+Status DebuggerCore::adopt_fork_child(DebuggerCore& parent, pid_t pid)
+{
+  if (m_pid > 0)
+    return Status::fail("会话已经附加了进程 {}", m_pid);
+
+  auto child_it = std::find(parent.m_fork_children.begin(), parent.m_fork_children.end(), pid);
+  if (child_it == parent.m_fork_children.end())
+    return Status::fail("{} 不是保持跟踪的子进程", pid);
+  parent.m_fork_children.erase(child_it);
+
+  // fork 出的子进程只有一个线程, ptrace 选项从父进程继承
+  m_pid = pid;
+  m_current_tid = pid;
+  breakpoint_manager.set_pid(pid);
+  mark_stopped(pid, StopReason::ATTACH, 0);
+
+  m_non_stop = parent.m_non_stop;
+  m_signal_policies = parent.m_signal_policies;
+  for (auto& policy : m_signal_policies)
+    policy.received = 0;
+  m_fork_policy = parent.m_fork_policy;
+  m_stop_on_exec = parent.m_stop_on_exec;
+
+  // 快速跟踪点的环形缓冲区和覆盖率记录属于父进程, 在子进程中恢复原指令
+  auto patches = parent.m_coverage.armed_originals();
+  auto parent_breakpoints = parent.breakpoint_manager.get_breakpoints();
+  for (const auto& breakpoint : parent_breakpoints)
+  {
+    if (breakpoint.enabled && breakpoint.type == BreakpointType::FAST_TRACEPOINT)
+      patches.emplace_back(breakpoint.address, breakpoint.original_instruction);
+  }
+  for (const auto& [address, code] : patches)
+  {
+    if (!memory_crl.write_code(pid, address, &code, sizeof(code)))
+      LOG_WARNING("子进程 {} 恢复 0x{:x} 的原指令失败", pid, address);
+  }
+
+  // 软件断点的 brk 已经在子进程的内存中, 只复制记录
+  size_t count = breakpoint_manager.inherit_software_breakpoints(parent_breakpoints, pid);
+  return Status::success("接管子进程 {}, 继承 {} 个软件断点", pid, count);
+}
+
+std::vector<std::pair<uint64_t, uint32_t>> DebuggerCore::collect_original_code()
+{
+  std::vector<std::pair<uint64_t, uint32_t>> patches = m_coverage.armed_originals();
+  for (const auto& breakpoint : breakpoint_manager.get_breakpoints())
+  {
+    if (!breakpoint.enabled) continue;
+    if (breakpoint.type == BreakpointType::SOFTWARE || breakpoint.type == BreakpointType::FAST_TRACEPOINT)
+      patches.emplace_back(breakpoint.address, breakpoint.original_instruction);
+  }
+  return patches;
+}
+
+Status DebuggerCore::detach_child_process(pid_t pid)
+{
+  // 子进程继承了改写过的代码, 没有跟踪者时执行到 brk 会被 SIGTRAP 杀死
+  int failed = 0;
+  for (const auto& [address, code] : collect_original_code())
+  {
+    if (!memory_crl.write_code(pid, address, &code, sizeof(code)))
+      failed++;
+  }
+
+  // 页保护观察点的权限也被继承了, 没有跟踪者时访问这些页会被 SIGSEGV 杀死, 注入 mprotect 恢复
+  auto& remote_control = RemoteControl::get_instance();
+  for (const auto& stat : breakpoint_manager.get_page_watch_stats())
+  {
+    if (stat.protect_prot == stat.original_prot) continue;
+    auto result = remote_control.syscall(pid, pid, SYS_mprotect,
+      {stat.page, static_cast<uint64_t>(Utils::get_page_size()), static_cast<uint64_t>(stat.original_prot)});
+    if (!result || RemoteControl::is_error(result.value()))
+    {
+      LOG_WARNING("恢复子进程 {} 中页 0x{:x} 的权限失败", pid, stat.page);
+      failed++;
+    }
+  }
+
+  proc_helper.release_proc_fds(pid);
+  bool detached = Utils::ptrace_wrapper(PTRACE_DETACH, pid, nullptr, nullptr);
+  remote_control.reset(pid);
+  if (!detached)
+    return Status::fail("分离子进程 {} 失败, errno: {}", pid, strerror(errno));
+  if (failed > 0)
+    return Status::fail("子进程 {} 已分离, {} 处代码或页权限没能恢复", pid, failed);
+  return Status::success("子进程 {} 已分离", pid);
+}
+
+void DebuggerCore::handle_fork_event(pid_t parent, bool is_vfork)
+{
+  unsigned long message = 0;
+  if (!Utils::ptrace_wrapper(PTRACE_GETEVENTMSG, parent, nullptr, &message, sizeof(message)))
+  {
+    LOG_WARNING("读取线程 {} 的 fork 事件失败", parent);
+    return;
+  }
+  pid_t child = static_cast<pid_t>(message);
+
+  // 等子进程的初始暂停, 它可能已经在 wait_event 中先到了
+  auto unclaimed_it = std::find(m_unclaimed_children.begin(), m_unclaimed_children.end(), child);
+  if (unclaimed_it != m_unclaimed_children.end())
+    m_unclaimed_children.erase(unclaimed_it);
+  else
+  {
+    int child_status = 0;
+    if (wait_for_tid(child, child_status) != child || !WIFSTOPPED(child_status))
+    {
+      LOG_WARNING("等待子进程 {} 暂停失败", child);
+      return;
+    }
+  }
+
+  // vfork 的子进程与父进程共享内存, 父进程在子进程 exec 或退出前不会返回, 子进程不能保持暂停
+  // 在共享内存中临时恢复原指令, PTRACE_EVENT_VFORK_DONE 时再写回
+  if (is_vfork)
+  {
+    if (m_fork_policy == ForkPolicy::KEEP)
+      LOG_WARNING("vfork 的子进程 {} 与父进程共享内存, 不能保持暂停, 改为分离", child);
+
+    for (const auto& [address, original] : collect_original_code())
+    {
+      uint32_t current = 0;
+      if (!memory_crl.read_memory(parent, address, &current, sizeof(current))) continue;
+      if (memory_crl.write_code(parent, address, &original, sizeof(original)))
+        m_vfork_saved_code.emplace_back(address, current);
+    }
+
+    if (!Utils::ptrace_wrapper(PTRACE_DETACH, child, nullptr, nullptr))
+      LOG_WARNING("分离 vfork 子进程 {} 失败", child);
+    return;
+  }
+
+  if (m_fork_policy == ForkPolicy::KEEP)
+  {
+    m_fork_children.push_back(child);
+    LOG_DEBUG("子进程 {} 保持暂停, 断点状态与父进程相同", child);
+    return;
+  }
+
+  Status s = detach_child_process(child);
+  if (s.is_fail())
+    LOG_WARNING("{}", s.c_str());
+}
+
+bool DebuggerCore::handle_exec_event(pid_t tid)
+{
+  // 缓存的 maps / mem 描述符绑定旧的地址空间, exec 之后读到 0 字节而不是 ESRCH, 全部关闭
+  proc_helper.release_thread_states(m_pid, live_tids());
+  proc_helper.release_proc_fds(m_pid);
+
+  // 执行 exec 的线程接管主线程的 tid, 其他线程已经被内核回收
+  unsigned long former_tid = 0;
+  Utils::ptrace_wrapper(PTRACE_GETEVENTMSG, tid, nullptr, &former_tid, sizeof(former_tid));
+  for (pid_t thread : live_tids())
+  {
+    if (thread != m_pid)
+      remove_thread(thread);
+  }
+  mark_stopped(m_pid, StopReason::EXEC, SIGTRAP);
+  m_current_tid = m_pid;
+  LOG_DEBUG("进程 {} 执行 exec, 原线程 {}", m_pid, former_tid);
+
+  // 断点按模块偏移保存, 等模块映射后重新设置, 数据观察点和不在文件映射中的断点无法迁移
+  for (const auto& breakpoint : breakpoint_manager.get_breakpoints())
+  {
+    if (breakpoint.id == m_load_notify_id) continue;
+    bool is_watchpoint = breakpoint.type == BreakpointType::HARDWARE_WRITE || breakpoint.type == BreakpointType::HARDWARE_READWRITE;
+    if (is_watchpoint || breakpoint.module_path.empty())
+    {
+      LOG_WARNING("断点 {} 不在文件映射中, exec 之后丢弃", breakpoint.id);
+      continue;
+    }
+    m_pending_breakpoints.push_back({breakpoint.type, breakpoint.module_path, breakpoint.module_offset});
+  }
+
+  // 旧地址空间中的代码改写, 调试寄存器和远程内存都已经不存在
+  breakpoint_manager.reset();
+  m_coverage.reset();
+  m_vfork_saved_code.clear();
+  RemoteControl::get_instance().reset(m_pid);
+  m_load_notify_id = -1;
+
+  rearm_breakpoints();
+  if (!m_pending_breakpoints.empty())
+    arm_load_notify();
+  return m_stop_on_exec;
+}
+
+void DebuggerCore::record_module_location(int breakpoint_id, uint64_t address)
+{
+  auto regions = memory_crl.get_memory_regions(m_pid);
+  auto region_it = std::find_if(regions.begin(), regions.end(), [address](const MemoryRegion& region) {
+    return address >= region.start_address && address < region.end_address;
+  });
+  if (region_it == regions.end() || region_it->pathname.empty() || region_it->pathname[0] != '/')
+    return;
+
+  // 模块基址是同一文件最低的映射地址
+  uint64_t base = region_it->start_address;
+  for (const auto& region : regions)
+  {
+    if (region.pathname == region_it->pathname)
+      base = std::min(base, region.start_address);
+  }
+  breakpoint_manager.set_module_location(breakpoint_id, region_it->pathname, address - base);
+}
+
+void DebuggerCore::rearm_breakpoints()
+{
+  std::map<std::string, uint64_t> bases;
+  for (const auto& region : memory_crl.get_memory_regions(m_pid))
+  {
+    if (region.pathname.empty() || region.pathname[0] != '/') continue;
+    auto base_it = bases.find(region.pathname);
+    if (base_it == bases.end() || region.start_address < base_it->second)
+      bases[region.pathname] = region.start_address;
+  }
+
+  for (auto pending_it = m_pending_breakpoints.begin(); pending_it != m_pending_breakpoints.end();)
+  {
+    auto base_it = bases.find(pending_it->module_path);
+    if (base_it == bases.end())
+    {
+      ++pending_it;
+      continue;
+    }
+
+    int breakpoint_id = -1;
+    uint64_t address = base_it->second + pending_it->module_offset;
+    Status s = set_breakpoint(pending_it->type, address, breakpoint_id);
+    if (s.is_fail())
+      LOG_WARNING("重新设置 {}+0x{:x} 的断点失败: {}", pending_it->module_path, pending_it->module_offset, s.c_str());
+    else
+      LOG_DEBUG("重新设置 {}+0x{:x} 的断点, ID: {}", pending_it->module_path, pending_it->module_offset, breakpoint_id);
+    pending_it = m_pending_breakpoints.erase(pending_it);
+  }
+}
+
+bool DebuggerCore::handle_sync_event(pid_t tid, int status, bool& trace_exit)
+{
+  trace_exit = false;
+  if (!WIFSTOPPED(status)) return false;
+
+  // 系统调用出口
+  if (WSTOPSIG(status) == (SIGTRAP | 0x80))
+  {
+    m_syscall_tracer.on_exit(tid);
+    return true;
+  }
+  if (WSTOPSIG(status) != SIGTRAP) return false;
+
+  int event = status >> 16;
+  switch (event)
+  {
+    case PTRACE_EVENT_FORK:
+    case PTRACE_EVENT_VFORK:
+      handle_fork_event(tid, event == PTRACE_EVENT_VFORK);
+      return true;
+    case PTRACE_EVENT_VFORK_DONE:
+      rewrite_vfork_code(tid);
+      return true;
+    case PTRACE_EVENT_SECCOMP:
+      trace_exit = m_syscall_tracer.on_entry(tid);
+      return true;
+    default:
+      return false;
+  }
+}
+
+void DebuggerCore::rewrite_vfork_code(pid_t tid)
+{
+  for (const auto& [address, code] : m_vfork_saved_code)
+  {
+    if (!memory_crl.write_code(tid, address, &code, sizeof(code)))
+      LOG_WARNING("vfork 结束后重新写入 0x{:x} 失败", address);
+  }
+  m_vfork_saved_code.clear();
+}
+
+void DebuggerCore::arm_load_notify()
+{
+  // 动态链接器每次修改模块列表前后都会调用这个空函数, 调试器在这里得到通知
+  static const std::pair<std::string, std::string> LOAD_NOTIFIES[] = {
+    {"/linker64", "__dl_rtld_db_dlactivity"},
+    {"/ld-linux-aarch64.so.1", "_dl_debug_state"},
+  };
+
+  // exec 时内核已经映射了动态链接器
+  std::string linker_path;
+  std::string symbol;
+  uint64_t base = UINT64_MAX;
+  for (const auto& region : memory_crl.get_memory_regions(m_pid))
+  {
+    for (const auto& [suffix, name] : LOAD_NOTIFIES)
+    {
+      const std::string& path = region.pathname;
+      if (path.size() < suffix.size() || path.compare(path.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+      if (!linker_path.empty() && linker_path != path) continue;
+      linker_path = path;
+      symbol = name;
+      base = std::min(base, region.start_address);
+    }
+  }
+  if (linker_path.empty())
+  {
+    LOG_WARNING("进程 {} 没有映射动态链接器, 只能在暂停时重新设置断点", m_pid);
+    return;
+  }
+
+  auto offset_opt = Utils::find_elf_symbol(linker_path, symbol);
+  if (!offset_opt)
+  {
+    LOG_WARNING("{} 中没有找到 {}, 只能在暂停时重新设置断点", linker_path, symbol);
+    return;
+  }
+
+  uint64_t address = base + offset_opt.value();
+  m_load_notify_id = breakpoint_manager.set_software_breakpoint(m_pid, address);
+  if (m_load_notify_id == -1)
+    LOG_WARNING("在加载通知函数 0x{:x} 设置断点失败", address);
+  else
+    LOG_DEBUG("加载通知断点设置在 {}!{} (0x{:x})", linker_path, symbol, address);
+}
+
+void DebuggerCore::handle_load_notify(pid_t tid)
+{
+  breakpoint_manager.record_hit(tid, m_load_notify_id);
+  mark_stopped(tid, StopReason::BREAKPOINT, SIGTRAP);
+
+  // 设置断点要求当前线程已暂停, 全停止模式下其他线程仍在运行, 写调试寄存器前先让它们停下
+  pid_t current_tid = m_current_tid;
+  m_current_tid = tid;
+  with_all_stopped([this]() {
+    rearm_breakpoints();
+    return Status::success("重新设置断点完成, 还有 {} 个等待模块加载", m_pending_breakpoints.size());
+  });
+  m_current_tid = current_tid;
+
+  // 全部设置完成后不再需要通知
+  if (m_pending_breakpoints.empty())
+  {
+    Status s = breakpoint_manager.remove_breakpoint(m_load_notify_id);
+    if (s.is_fail())
+      LOG_WARNING("移除加载通知断点失败: {}", s.c_str());
+    m_load_notify_id = -1;
+  }
+
+  Status s = breakpoint_manager.prepare_resume(tid);
+  if (s.is_fail())
+    LOG_WARNING("越过加载通知断点失败: {}", s.c_str());
+  if (continue_after_step(tid))
+    m_threads[tid].state = ThreadState::RUNNING;
+}
+
+void DebuggerCore::add_new_thread(pid_t tid)
+{
+  mark_stopped(tid, StopReason::NONE, 0);
+
+  Status s = breakpoint_manager.add_thread(tid);
+  if (s.is_fail())
+    LOG_WARNING("新线程 {} 同步断点失败: {}", tid, s.c_str());
+  else
+    LOG_DEBUG("新线程 {}: {}", tid, s.c_str());
+
+  if (Utils::ptrace_wrapper(PTRACE_CONT, tid, nullptr, nullptr))
+    m_threads[tid].state = ThreadState::RUNNING;
+}
+
+void DebuggerCore::handle_exit_event(pid_t tid)
+{
+  unsigned long exit_status = 0;
+  Utils::ptrace_wrapper(PTRACE_GETEVENTMSG, tid, nullptr, &exit_status, sizeof(exit_status));
+
+  ThreadInfo& info = m_threads[tid];
+  info.tid = tid;
+  info.state = ThreadState::EXITED;
+  info.last_stop_reason = StopReason::EXIT;
+  info.pending_signal = 0;
+  info.exit_code = static_cast<int>(exit_status);
+  LOG_DEBUG("线程 {} 正在退出, 状态: 0x{:x}", tid, exit_status);
+
+  // 已退出的线程不再参与断点同步
+  breakpoint_manager.remove_thread(tid);
+  Utils::ptrace_wrapper(PTRACE_CONT, tid, nullptr, nullptr);
 }
 
 Status DebuggerCore::read_memory(uint64_t address, void* buf, size_t size)
@@ -878,7 +2707,9 @@ Status DebuggerCore::write_memory(uint64_t address, const void* buf, size_t size
   if (size <= 0)
     return Status::fail("无效的大小");
 
-  if (memory_crl.write_memory(m_pid, address, buf, size))
+  // process_vm_writev 失败时回退到 ptrace, 需要一个暂停的线程, 不停止模式下主线程可能在运行
+  pid_t tid = stopped_tid();
+  if (memory_crl.write_memory(tid > 0 ? tid : m_pid, address, buf, size))
     return Status::success("write_memory 成功");
   else return Status::fail("write_memory 失败, errno: {}", strerror(errno));
 }
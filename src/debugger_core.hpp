@@ -1,5 +1,11 @@
 #pragma once
 
+#include <array>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
 #include <string>
 #include <sys/types.h>
 #include <vector>
@@ -9,6 +15,9 @@
 #include "assembly.hpp"
 #include "memory_control.hpp"
 #include "breakpoint_manager.hpp"
+#include "instruction_trace.hpp"
+#include "coverage.hpp"
+#include "syscall_trace.hpp"
 #include "process.hpp"
 
 namespace Core 
@@ -21,6 +30,72 @@ namespace Core
 // todo: 添加状态的维护
 // todo: 修复 launch
 
+// 线程运行状态
+enum class ThreadState
+{
+  RUNNING,
+  STOPPED,
+  EXITED
+};
+
+// 线程最近一次暂停的原因
+enum class StopReason
+{
+  NONE,
+  ATTACH,             // 附加时的中断
+  INTERRUPT,          // pause / pause_thread
+  BREAKPOINT,         // 断点命中
+  WATCHPOINT,         // 页保护观察点命中
+  SINGLE_STEP,        // 单步完成
+  SIGNAL,             // 收到信号
+  GROUP_STOP,         // 组暂停
+  EXIT,               // PTRACE_EVENT_EXIT
+  EXEC                // PTRACE_EVENT_EXEC
+};
+
+// fork / vfork 出的子进程的处理方式
+enum class ForkPolicy
+{
+  DETACH,             // 在子进程中恢复断点的原指令后分离
+  KEEP                // 保持跟踪并暂停, 继承父进程的断点状态, 由客户端决定之后的处理
+};
+
+// 线程表项
+struct ThreadInfo
+{
+  pid_t tid = -1;
+  ThreadState state = ThreadState::STOPPED;
+  StopReason last_stop_reason = StopReason::NONE;
+  int last_signal = 0;        // 最近一次暂停时的信号
+  int pending_signal = 0;     // 暂停时截获的信号, 恢复运行时重新注入
+  int exit_code = 0;          // PTRACE_EVENT_EXIT 时的退出状态
+
+  static const char* state_to_string(ThreadState state);
+  static const char* reason_to_string(StopReason reason);
+};
+
+// 收到信号时的处理策略, 对应 gdb 的 handle 命令
+struct SignalPolicy
+{
+  bool stop = true;           // 暂停线程并报告给客户端, false 时在事件循环内直接恢复运行
+  bool print = true;          // 写日志
+  bool pass = true;           // 恢复运行时把信号交给目标, false 时吞掉
+  uint64_t received = 0;      // 收到的次数, 只读
+};
+
+// 最近一次附加的耗时统计, 单位微秒
+struct AttachStats
+{
+  size_t threads = 0;         // 附加成功的线程数
+  size_t failed = 0;          // 附加失败或附加期间退出的线程数
+  size_t already_attached = 0; // 重新扫描时已经随 clone 自动附加的线程数
+  size_t rounds = 0;          // 扫描 /proc/[pid]/task 的次数
+  uint64_t enumerate_us = 0;  // 扫描线程
+  uint64_t seize_us = 0;      // PTRACE_SEIZE + PTRACE_INTERRUPT
+  uint64_t reap_us = 0;       // 收集所有线程的暂停
+  uint64_t total_us = 0;      // 从开始到所有线程暂停
+};
+
 class DebuggerCore
 {
 public:
@@ -31,7 +106,8 @@ public:
   Base::Status attach(pid_t pid);
   Base::Status attach(const std::string& package_name);
   Base::Status launch(const std::string& package_activity);
-  Base::Status detach();
+  // 安装过 seccomp 跟踪过滤器时过滤器无法移除, 分离后被选中的系统调用返回 ENOSYS, 需要 force 才分离
+  Base::Status detach(bool force = false);
   Base::Status kill();
   Base::Status resume_thread(pid_t tid);
   Base::Status resume();
@@ -41,6 +117,54 @@ public:
   Base::Status hardware_step_into();  // 硬件单步 ARM32, RISC-V, 龙芯不支持硬件单单步 
   Base::Status software_step_into();  // 软件单步
   Base::Status step_over();
+  Base::Status step_out();            // 运行到当前函数返回
+
+  // 指令跟踪: 在调试器内循环硬件单步, 记录到 InstructionTrace, 到达 stop_address(0 表示不限制)或 max_count 条时停止
+  Base::Status trace_instructions(pid_t tid, size_t max_count, uint64_t stop_address, bool record_registers, size_t& count);
+  // 分块读取最近一次的跟踪数据
+  Base::Status read_instruction_trace(size_t offset, size_t size, std::vector<uint8_t>& data, size_t& total_size);
+
+  // 基本块覆盖率: module 是映射路径或文件名, offsets 为空时自动发现基本块
+  Base::Status start_coverage(const std::string& module, const std::vector<uint64_t>& offsets);
+  Base::Status stop_coverage();
+  // 导出 drcov 格式的覆盖率数据
+  Base::Status export_coverage(std::vector<uint8_t>& data, size_t& block_count, size_t& hit_count);
+
+  // 系统调用跟踪: 用 seccomp 过滤器只让 numbers 中的调用停下, capture_size 是每次记录的缓冲区内容上限
+  Base::Status start_syscall_trace(const std::vector<int>& numbers, size_t capture_size);
+  Base::Status stop_syscall_trace();
+  // 取出不超过 max_size 字节的系统调用记录, 格式见 SyscallEvent
+  Base::Status read_syscall_events(size_t max_size, std::vector<uint8_t>& data, size_t& count, uint64_t& dropped);
+  Base::Status wait_event(int timeout_ms, pid_t& tid, int& signal);  // 等待线程暂停, 内部事件(页保护观察点的误报)自动处理
+  // 不阻塞地处理已经到达的事件, 有需要报告的暂停时返回结果
+  std::optional<Base::Status> poll_event(pid_t& tid, int& signal);
+
+  // 多会话: 每个被调试进程一个 DebuggerCore, 共用同一个 waitpid(-1)
+  // 已附加进程且还有线程
+  bool is_attached() const { return m_pid > 0 && !m_threads.empty(); }
+  // tid 属于本会话(线程, 新线程, fork 出的子进程)
+  bool owns_tid(pid_t tid);
+  // 其他会话收到的本会话事件, 下次 poll_event 时处理
+  void queue_event(pid_t wpid, int status) { m_event_queue.emplace_back(wpid, status); }
+  // 收到不属于本会话的事件时调用, 返回 false 表示没有会话认领, 按本会话的事件处理
+  void set_event_router(std::function<bool(pid_t, int)> router) { m_event_router = std::move(router); }
+  // 接管 parent 中 KEEP 策略保持暂停的子进程, 复制断点记录和策略, 本会话必须还没有附加进程
+  Base::Status adopt_fork_child(DebuggerCore& parent, pid_t pid);
+
+  // 不停止模式: 只暂停命中断点的线程, 其他线程继续运行; 默认是全停止模式
+  Base::Status set_non_stop(bool enable);
+  bool is_non_stop() const { return m_non_stop; }
+
+  // 信号策略, SIGKILL / SIGSTOP / SIGTRAP 由调试器自己使用, 不能修改
+  Base::Status set_signal_policy(int signal, bool stop, bool print, bool pass);
+  Base::Status get_signal_policies(std::map<int, SignalPolicy>& policies);
+
+  // fork / exec 跟随策略, stop_on_exec 为 true 时 exec 之后暂停并报告
+  Base::Status set_follow_policy(ForkPolicy fork_policy, bool stop_on_exec);
+  // KEEP 策略下保持暂停的子进程
+  Base::Status get_fork_children(std::vector<pid_t>& children);
+  // 恢复子进程中断点的原指令后分离
+  Base::Status detach_fork_child(pid_t pid);
 
   // 内存操作
   Base::Status read_memory(uint64_t address, void* buf, size_t size);
@@ -53,6 +177,7 @@ public:
 
   // 断点管理
   Base::Status set_breakpoint(BreakpointType type, uint64_t address, int& breakpoint_id);
+  Base::Status set_watchpoint(BreakpointType type, uint64_t address, size_t length, int& breakpoint_id);
   Base::Status remove_breakpoint(int breakpoint_id);
   Base::Status enable_breakpoint(int breakpoint_id);
   Base::Status disable_breakpoint(int breakpoint_id);
@@ -60,13 +185,18 @@ public:
   Base::Status get_breakpoints(pid_t tid, std::vector<Breakpoint>& breakpoints);
   Base::Status get_breakpoint(int breakpoint_id, Breakpoint& breakpoint);  
   Base::Status get_breakpoint(uint64_t address, Breakpoint& breakpoint);  
+  Base::Status set_ignore_count(int breakpoint_id, uint64_t count);
+  Base::Status get_page_watch_stats(std::vector<PageWatchStat>& stats);
+  Base::Status read_trace_records(size_t max_count, std::vector<TraceRecord>& records, uint64_t& dropped);
 
   // 线程管理
   Base::Status get_threads(std::vector<pid_t>& threads);
+  Base::Status get_threads(std::vector<ThreadInfo>& threads);
   Base::Status switch_thread(pid_t tid);
 
   // 状态查询
   Base::Status get_pid(pid_t& pit);
+  Base::Status get_attach_stats(AttachStats& stats);
   Base::Status get_current_tid(pid_t& tid);
 
   // // 符号解析
@@ -74,8 +204,19 @@ public:
   // Base::Status address_to_symbol(uint64_t address, std::optional<std::string>& symbol_name);
 
 private:
-  // 设置默认 ptrace 调试选项
-  bool set_default_ptrace_options(pid_t pid);
+  // 默认 ptrace 调试选项, PTRACE_SEIZE 时一起设置
+  long default_ptrace_options();
+
+  // 等待 tid 的下一个事件, 先查本会话的事件队列, 期间收到的其他事件路由给所属会话或放入队列
+  // 所有按 tid 的等待都走这里, 返回值和 waitpid 相同
+  pid_t wait_for_tid(pid_t tid, int& status);
+
+  // 收集 PTRACE_INTERRUPT 引起的暂停, 期间截获的其他信号保存下来, 恢复运行时重新注入
+  bool wait_interrupt_stop(pid_t tid, StopReason reason);
+  bool handle_interrupt_stop(pid_t tid, int status, StopReason reason);
+
+  // 附加时扫描线程的最大次数, 每次只附加新出现的线程
+  static constexpr int ATTACH_SCAN_ROUNDS = 4;
 
   // 单步实现
   enum class SingleStepMode
@@ -85,12 +226,157 @@ private:
   };
   Base::Status single_step_impl(SingleStepMode mode);
 
+  // 运行当前线程直到它在 sp > frame_sp 的栈帧中到达 return_address
+  static constexpr int RUN_TO_RETURN_TIMEOUT_MS = 30000;
+  Base::Status run_to_return(uint64_t return_address, uint64_t frame_sp);
+
+  // 确定当前函数的返回地址: 序言之前或叶子函数用 lr, 建立栈帧之后读帧记录
+  // frame_bound 是返回时 sp 的严格下界, 用于排除递归中更深的栈帧
+  static constexpr size_t STEP_OUT_SCAN_INSTRUCTIONS = 256;
+  static constexpr uint64_t STACK_FRAME_LIMIT = 0x100000;
+  std::optional<uint64_t> find_return_address(const user_pt_regs& regs, uint64_t& frame_bound);
+
+  // 单步 tid 一条指令, pc 处有断点时越过断点
+  Base::Status step_instruction(pid_t tid, uint64_t pc);
+
+  // 读取并反汇编 address 处的指令, 软件断点处取原指令
+  std::optional<Assembly::Instruction> decode_instruction(uint64_t address);
+
+  // 在 targets 处放临时断点, 恢复当前线程并等它停下, 之后移除临时断点
+  Base::Status run_to_temporary_breakpoints(const std::vector<uint64_t>& targets);
+
+  // 断点设置的实现, 调用前所有需要写入的线程都已暂停
+  Base::Status set_breakpoint_impl(BreakpointType type, uint64_t address, int& breakpoint_id);
+  Base::Status set_watchpoint_impl(BreakpointType type, uint64_t address, size_t length, int& breakpoint_id);
+
+  // 新线程已经暂停, 加入线程列表并同步进程级断点
+  void add_new_thread(pid_t tid);
+
+  // PTRACE_EVENT_EXIT: 标记线程已退出并让它继续
+  void handle_exit_event(pid_t tid);
+
+  // 向调用方报告线程暂停, 全停止模式下同时暂停其他线程
+  void hold_stopped_thread(pid_t tid, StopReason reason, int signal);
+
+  // 按信号策略处理线程收到的信号, 返回 false 表示已经让线程继续运行, 不需要报告
+  bool apply_signal_policy(pid_t tid, int signal);
+
+  // 恢复运行时要注入的信号, 策略为不传递时返回 0
+  int deliverable_signal(int signal) const;
+
+  // 越过断点或页保护访问的单步期间截获的信号, 按策略转换后存为线程的 pending_signal
+  void keep_step_signal(pid_t tid);
+
+  // 单步越过之后继续运行, 截获的信号一起注入, 返回 PTRACE_CONT 是否成功
+  bool continue_after_step(pid_t tid);
+
+  // 信号策略的默认值
+  void reset_signal_policies();
+
+  // tid 属于其他进程(fork 出的子进程)
+  bool is_foreign_process(pid_t tid);
+
+  // tid 的跟踪者是本进程
+  bool is_traced_by_self(pid_t tid);
+
+  // 处理一次 waitpid 的结果, 内部事件处理完返回 std::nullopt
+  std::optional<Base::Status> handle_wait_status(pid_t wpid, int status, pid_t& tid, int& signal);
+
+  // fork / vfork 事件, 按策略处理子进程
+  void handle_fork_event(pid_t parent, bool is_vfork);
+
+  // exec 事件, 重建线程表并按模块偏移重新设置断点, 返回是否需要暂停
+  bool handle_exec_event(pid_t tid);
+
+  // 同步等待(中断, 单步, 运行到临时断点)期间收到的 fork / vfork / seccomp 事件暂停, 处理事件但不恢复线程
+  // seccomp 入口需要记录出口时 trace_exit 为 true, 不是这类事件时返回 false
+  bool handle_sync_event(pid_t tid, int status, bool& trace_exit);
+
+  // vfork 的子进程已经 exec 或退出, 重新写入共享内存期间恢复的代码
+  void rewrite_vfork_code(pid_t tid);
+
+  // 软件断点, 快速跟踪点和覆盖率改写过的代码, (地址, 原指令)
+  std::vector<std::pair<uint64_t, uint32_t>> collect_original_code();
+
+  // 恢复子进程中断点的原指令后分离
+  Base::Status detach_child_process(pid_t pid);
+
+  // 记录断点所在的模块和偏移
+  void record_module_location(int breakpoint_id, uint64_t address);
+
+  // exec 之后等待模块加载的断点, 模块映射后设置
+  void rearm_breakpoints();
+
+  // 在动态链接器的加载通知函数上设置内部断点, 启动期间加载的模块也能及时设置断点, 不依赖 stop_on_exec
+  void arm_load_notify();
+
+  // 命中加载通知断点, 重新设置等待中的断点后继续运行, 不报告给客户端
+  void handle_load_notify(pid_t tid);
+
+  // 读写寄存器, 单步等操作要求线程处于暂停状态
+  Base::Status check_thread_stopped(pid_t tid) const;
+
+  // 任意一个暂停的线程, 优先当前线程, 用于 ptrace 读写内存, 没有返回 -1
+  pid_t stopped_tid() const;
+
+  // 修改断点需要写所有线程的调试寄存器, 先临时中断运行中的线程, 执行完再恢复它们
+  Base::Status with_all_stopped(const std::function<Base::Status()>& action);
+
   // 主线程 pid
   pid_t m_pid;
-  // 所有 tids
-  std::vector<pid_t> m_tids;
   // 当前 tid
   pid_t m_current_tid;
+  // 是否为不停止模式
+  bool m_non_stop;
+
+  // 最近一次附加的耗时
+  AttachStats m_attach_stats;
+
+  // 按信号编号索引的处理策略
+  std::array<SignalPolicy, NSIG> m_signal_policies;
+
+  // fork / exec 跟随策略
+  ForkPolicy m_fork_policy;
+  bool m_stop_on_exec;
+
+  // KEEP 策略下保持暂停的子进程
+  std::vector<pid_t> m_fork_children;
+
+  // 比 fork 事件先到达的子进程初始暂停
+  std::vector<pid_t> m_unclaimed_children;
+
+  // vfork 的子进程与父进程共享内存, exec 或退出前临时恢复的代码, (地址, 改写后的指令)
+  std::vector<std::pair<uint64_t, uint32_t>> m_vfork_saved_code;
+
+  // 其他会话收到的本会话的 waitpid 结果
+  std::deque<std::pair<pid_t, int>> m_event_queue;
+  std::function<bool(pid_t, int)> m_event_router;
+
+  // exec 之后等待模块映射的断点
+  struct PendingBreakpoint
+  {
+    BreakpointType type;
+    std::string module_path;
+    uint64_t module_offset;
+  };
+  std::vector<PendingBreakpoint> m_pending_breakpoints;
+
+  // 加载通知断点的 ID, -1 表示没有设置
+  int m_load_notify_id;
+
+  // 线程表, 按 tid 排序, 由事件循环实时维护, 不再读取 /proc/[tid]/status
+  std::map<pid_t, ThreadInfo> m_threads;
+
+  // 未退出的线程
+  std::vector<pid_t> live_tids() const;
+  bool has_thread(pid_t tid) const;
+
+  // 记录线程暂停
+  void mark_stopped(pid_t tid, StopReason reason, int signal);
+
+  // 线程已被回收, 从线程表中移除
+  void remove_thread(pid_t tid);
+
   // 已经申请的内存地址
   std::unordered_map<uint64_t, size_t> g_allocated_memory;
 
@@ -101,6 +387,15 @@ private:
   Process::PSHelper& ps_helper;
 
   BreakpointManager breakpoint_manager;
+
+  // 最近一次的指令跟踪数据
+  InstructionTrace m_instruction_trace;
+
+  // 基本块覆盖率
+  CoverageCollector m_coverage;
+
+  // 系统调用跟踪
+  SyscallTracer m_syscall_tracer;
 };
 
 }
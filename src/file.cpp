@@ -1,12 +1,34 @@
 #include "file.hpp"
 #include "log.hpp"
+#include <cstring>
+#include <fcntl.h>
 #include <string>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 
-namespace Base 
+namespace Base
 {
+
+bool LineReader::next(std::string_view& line)
+{
+  if (m_data.empty()) return false;
+
+  size_t newline = m_data.find('\n');
+  if (newline == std::string_view::npos)
+  {
+    line = m_data;
+    m_data = {};
+  }
+  else
+  {
+    line = m_data.substr(0, newline);
+    m_data.remove_prefix(newline + 1);
+  }
+  return true;
+}
+
 std::optional<File> File::open(const std::string& path, bool is_directory)
 {
   return File(path, is_directory);
@@ -27,22 +49,57 @@ File::File(const std::string& path, bool is_directory) : m_path(path), m_is_dire
   open_path(path, m_is_directory);
 }
 
+File::File(File&& other) noexcept :
+  m_path(std::move(other.m_path)),
+  m_is_directory(other.m_is_directory),
+  m_fd(other.m_fd),
+  m_buffer(std::move(other.m_buffer)),
+  m_buffer_size(other.m_buffer_size),
+  m_line_position(other.m_line_position),
+  m_line_loaded(other.m_line_loaded),
+  m_dir_handle(std::move(other.m_dir_handle))
+{
+  other.m_fd = -1;
+}
+
+File& File::operator=(File&& other) noexcept
+{
+  if (this == &other) return *this;
+
+  if (m_fd != -1) close(m_fd);
+  m_path = std::move(other.m_path);
+  m_is_directory = other.m_is_directory;
+  m_fd = other.m_fd;
+  m_buffer = std::move(other.m_buffer);
+  m_buffer_size = other.m_buffer_size;
+  m_line_position = other.m_line_position;
+  m_line_loaded = other.m_line_loaded;
+  m_dir_handle = std::move(other.m_dir_handle);
+  other.m_fd = -1;
+  return *this;
+}
+
+File::~File()
+{
+  if (m_fd != -1) close(m_fd);
+}
+
 void File::open_path(const std::string& path, bool is_directory)
 {
   if (is_directory)
   {
     DIR* dir = opendir(path.c_str());
-    if (!dir) 
+    if (!dir)
     {
       LOG_ERROR("无法打开目录 {}: {}", path, strerror(errno));
       return;
     }
     m_dir_handle.reset(dir);
   }
-  else 
+  else
   {
-    m_file_stream.open(path);
-    if (!m_file_stream.is_open())
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd == -1)
     {
       LOG_ERROR("无法打开文件 {}: {}", path, strerror(errno));
       return;
@@ -53,7 +110,7 @@ void File::open_path(const std::string& path, bool is_directory)
 bool File::check_directory_type(const std::string& path)
 {
   struct stat st;
-  if (stat(path.c_str(), &st) != 0) 
+  if (stat(path.c_str(), &st) != 0)
   {
     LOG_DEBUG("检查路径[{}]是否为目录失败: {}", path, strerror(errno));
     return false;
@@ -65,95 +122,115 @@ bool File::is_open() const
 {
   if (m_is_directory)
     return m_dir_handle != nullptr;
-  else 
-   return m_file_stream.is_open();
+  else
+   return m_fd != -1;
 }
 
-std::vector<dirent*> File::list_entries() 
+bool File::for_each_entry(const std::function<void(std::string_view name, unsigned char type)>& callback)
 {
-  std::vector<dirent*> entries;
-
-  if (!m_is_directory || !m_dir_handle) 
+  if (!m_is_directory || !m_dir_handle)
   {
     LOG_ERROR("无法从非目录或已关闭的目录句柄读取内容");
-    return entries;
+    return false;
   }
 
   rewinddir(m_dir_handle.get());
-    
+
   dirent* entry;
-  while ((entry = readdir(m_dir_handle.get())) != nullptr) 
+  while ((entry = readdir(m_dir_handle.get())) != nullptr)
   {
     // 跳过 . 和 ..
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) 
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
     {
       continue;
     }
-    entries.emplace_back(entry);
+    callback(entry->d_name, entry->d_type);
   }
-    
+
+  return true;
+}
+
+std::vector<DirEntry> File::list_entries()
+{
+  // readdir 返回的 dirent 会被下一次调用覆盖, 这里拷贝名字
+  std::vector<DirEntry> entries;
+  for_each_entry([&entries](std::string_view name, unsigned char type) {
+    entries.push_back({std::string(name), type});
+  });
   return entries;
 }
 
-std::vector<char> File::read_all() 
+std::optional<std::string_view> File::read()
 {
-  if (m_is_directory || !m_file_stream.is_open()) 
+  if (m_is_directory || m_fd == -1)
   {
-    LOG_ERROR("无法从目录或已关闭的文件流读取内容");
-    return {};
-  }
-    
-  // 保存当前位置
-  std::streampos original_pos = m_file_stream.tellg();
-  m_file_stream.seekg(0, std::ios::beg);
-    
-  std::vector<char> content;
-  char ch;
-  while (m_file_stream.get(ch)) 
-    content.push_back(ch);
-    
-  // 恢复位置
-  m_file_stream.seekg(original_pos);
-    
-  return content;
-}
-
-std::vector<std::string> File::read_lines() 
-{
-  if (m_is_directory || !m_file_stream.is_open()) 
-  {
-    LOG_ERROR("无法从目录或已关闭的文件流读取内容");
-    return {};
+    LOG_ERROR("无法从目录或已关闭的文件读取内容");
+    return std::nullopt;
   }
 
-  std::vector<std::string> lines;
+  if (m_buffer.empty())
+    m_buffer.resize(4096);
+  m_line_loaded = false;
 
-  std::streampos original_pos = m_file_stream.tellg();
-  m_file_stream.seekg(0, std::ios::beg);
-    
-  std::string line;
-  // 换行符 \n 是截止符号
-  while (std::getline(m_file_stream, line)) 
+  // 从头读取, /proc 文件用 pread 每次都是最新内容
+  m_buffer_size = 0;
+  while (true)
   {
-    lines.push_back(std::move(line));
+    if (m_buffer_size == m_buffer.size())
+      m_buffer.resize(m_buffer.size() * 2);
+
+    ssize_t nread = pread(m_fd, m_buffer.data() + m_buffer_size, m_buffer.size() - m_buffer_size,
+      static_cast<off_t>(m_buffer_size));
+    if (nread == -1 && errno == EINTR) continue;
+    if (nread == -1)
+    {
+      LOG_ERROR("读取文件 {} 失败: {}", m_path, strerror(errno));
+      return std::nullopt;
+    }
+    if (nread == 0) break;
+    m_buffer_size += static_cast<size_t>(nread);
   }
-    
-  m_file_stream.seekg(original_pos);
+
+  return std::string_view(m_buffer.data(), m_buffer_size);
+}
+
+std::vector<char> File::read_all()
+{
+  auto content = read();
+  if (!content) return {};
+  return std::vector<char>(content->begin(), content->end());
+}
+
+std::vector<std::string> File::read_lines()
+{
+  auto content = read();
+  if (!content) return {};
+
+  std::vector<std::string> lines;
+  LineReader reader(content.value());
+  std::string_view line;
+  while (reader.next(line))
+    lines.emplace_back(line);
   return lines;
 }
 
-std::string File::read_line() 
+std::string File::read_line()
 {
-  if (m_is_directory || !m_file_stream.is_open()) 
+  // 第一次调用时读入整个文件, 之后从缓冲区取
+  if (!m_line_loaded)
   {
-    LOG_ERROR("无法从目录或已关闭的文件流读取内容");
-    return "";
+    if (!read()) return "";
+    m_line_loaded = true;
+    m_line_position = 0;
   }
-    
-  std::string line;
-  if (std::getline(m_file_stream, line)) return line;
-  else return "";
-}
 
+  std::string_view rest(m_buffer.data() + m_line_position, m_buffer_size - m_line_position);
+  std::string_view line;
+  LineReader reader(rest);
+  if (!reader.next(line)) return "";
+
+  m_line_position += line.size() + (line.size() < rest.size() ? 1 : 0);
+  return std::string(line);
 }
 
+}
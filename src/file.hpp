@@ -1,23 +1,54 @@
 #pragma once
 
 #include <dirent.h>
-#include <fstream>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
-namespace Base 
+namespace Base
 {
 
-class File  
+// 目录项, 名字是拷贝, 不受之后 readdir 的影响
+struct DirEntry
+{
+  std::string name;
+  unsigned char type;       // DT_DIR, DT_REG ...
+};
+
+// 按 '\n' 切分文本, 返回的行不包含换行符, 视图指向原数据
+class LineReader
+{
+public:
+  explicit LineReader(std::string_view data) : m_data(data) {}
+
+  // 取下一行, 没有更多行时返回 false
+  bool next(std::string_view& line);
+
+private:
+  std::string_view m_data;
+};
+
+class File
 {
 
 private:
   std::string m_path;      // 文件/目录路径
   bool m_is_directory;     // 是否是目录
-  
-  // 文件句柄
-  std::ifstream m_file_stream;
-  
+
+  // 文件描述符
+  int m_fd = -1;
+
+  // 读缓冲区, 按需倍增, 同一个文件的多次读取复用
+  std::vector<char> m_buffer;
+  size_t m_buffer_size = 0;
+
+  // read_line 的读取位置, 指向 m_buffer
+  size_t m_line_position = 0;
+  bool m_line_loaded = false;
+
   // 目录句柄
   std::unique_ptr<DIR, decltype(&closedir)> m_dir_handle;
 
@@ -25,13 +56,12 @@ public:
   // 禁止拷贝
   File(const File&) = delete;
   File& operator=(const File&) = delete;
-  
+
   // 允许移动
-  File(File&& other) noexcept = default;
-  File& operator=(File&& other) noexcept = default;
+  File(File&& other) noexcept;
+  File& operator=(File&& other) noexcept;
 
-  // 用默认的就可以了, 资源会自动释放
-  ~File() = default;
+  ~File();
 
   // 打开文件或目录
   static std::optional<File> open(const std::string& path, bool is_directory);
@@ -46,8 +76,8 @@ public:
   // 获取文件路径
   const std::string& path() const { return m_path; }
 
-  // 获取原始文件流, 仅对文件有效
-  std::ifstream& file_stream() { return m_file_stream; }
+  // 获取原始文件描述符, 仅对文件有效
+  int fd() const { return m_fd; }
 
   // 获取原始目录句柄, 仅对目录有效
   DIR* directory_handle() { return m_dir_handle.get(); }
@@ -55,8 +85,15 @@ public:
   // 检查文件/目录是否成功打开
   bool is_open() const;
 
+  // 遍历目录条目, 跳过 . 和 .., 名字只在回调期间有效
+  bool for_each_entry(const std::function<void(std::string_view name, unsigned char type)>& callback);
+
   // 列出目录所有条目
-  std::vector<dirent*> list_entries();
+  std::vector<DirEntry> list_entries();
+
+  // 从头读取文件全部内容到内部缓冲区, 返回的视图在下次读取前有效
+  // /proc 文件的大小是 0, 不能按 st_size 分配, 缓冲区不够时倍增
+  std::optional<std::string_view> read();
 
   // 读取文件全部内容
   std::vector<char> read_all();
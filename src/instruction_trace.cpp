@@ -0,0 +1,74 @@
+#include <cstdint>
+#include <cstring>
+
+#include "instruction_trace.hpp"
+
+namespace Core
+{
+
+void InstructionTrace::begin(pid_t tid, bool record_registers)
+{
+  m_buffer.clear();
+  m_previous = {};
+  m_record_registers = record_registers;
+  m_count = 0;
+  m_tid = tid;
+
+  uint16_t flags = record_registers ? RECORD_REGISTERS : 0;
+  uint32_t tid_value = static_cast<uint32_t>(tid);
+  uint32_t reserved = 0;
+  put_raw(&MAGIC, sizeof(MAGIC));
+  put_raw(&VERSION, sizeof(VERSION));
+  put_raw(&flags, sizeof(flags));
+  put_raw(&tid_value, sizeof(tid_value));
+  put_raw(&reserved, sizeof(reserved));
+}
+
+void InstructionTrace::append(const user_pt_regs& regs)
+{
+  uint64_t expected_pc = m_count == 0 ? 0 : m_previous.pc + 4;
+  put_zigzag(static_cast<int64_t>(regs.pc - expected_pc));
+
+  if (m_record_registers)
+  {
+    uint64_t mask = 0;
+    for (int i = 0; i < 31; ++i)
+    {
+      if (regs.regs[i] != m_previous.regs[i])
+        mask |= 1ULL << i;
+    }
+    if (regs.sp != m_previous.sp) mask |= 1ULL << 31;
+    if (regs.pstate != m_previous.pstate) mask |= 1ULL << 32;
+
+    put_varint(mask);
+    for (int i = 0; i < 31; ++i)
+    {
+      if (mask & (1ULL << i))
+        put_zigzag(static_cast<int64_t>(regs.regs[i] - m_previous.regs[i]));
+    }
+    if (mask & (1ULL << 31)) put_zigzag(static_cast<int64_t>(regs.sp - m_previous.sp));
+    if (mask & (1ULL << 32)) put_zigzag(static_cast<int64_t>(regs.pstate - m_previous.pstate));
+  }
+
+  m_previous = regs;
+  ++m_count;
+}
+
+void InstructionTrace::put_varint(uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    m_buffer.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  m_buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void InstructionTrace::put_raw(const void* data, size_t size)
+{
+  size_t offset = m_buffer.size();
+  m_buffer.resize(offset + size);
+  memcpy(m_buffer.data() + offset, data, size);
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+#include "register_control.hpp"
+
+namespace Core
+{
+
+// 指令跟踪的紧凑二进制编码, 跟踪结束后由客户端一次性下载
+//
+// 头部 16 字节: magic(u32) version(u16) flags(u16) tid(u32) reserved(u32)
+// 之后每条指令一条记录, 记录的是执行这条指令之前的状态:
+//   varint  zigzag(pc - (上一条 pc + 4)), 顺序执行时只占 1 字节
+//   flags 含 RECORD_REGISTERS 时:
+//   varint  变化掩码, 第 0 ~ 30 位对应 x0 ~ x30, 第 31 位对应 sp, 第 32 位对应 pstate
+//   varint  每个变化寄存器的 zigzag(新值 - 旧值), 按位序排列
+// 第一条记录的"上一条"状态全为 0
+class InstructionTrace
+{
+public:
+  static constexpr uint32_t MAGIC = 0x54494441;     // "ADIT"
+  static constexpr uint16_t VERSION = 1;
+  static constexpr uint16_t RECORD_REGISTERS = 1 << 0;
+  static constexpr size_t HEADER_SIZE = 16;
+
+  // 清空并写入头部
+  void begin(pid_t tid, bool record_registers);
+
+  // 追加一条记录
+  void append(const user_pt_regs& regs);
+
+  const std::vector<uint8_t>& data() const { return m_buffer; }
+  size_t count() const { return m_count; }
+  pid_t tid() const { return m_tid; }
+
+private:
+  std::vector<uint8_t> m_buffer;
+  user_pt_regs m_previous = {};
+  bool m_record_registers = false;
+  size_t m_count = 0;
+  pid_t m_tid = -1;
+
+  void put_varint(uint64_t value);
+  void put_zigzag(int64_t value) { put_varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); }
+  void put_raw(const void* data, size_t size);
+};
+
+}
@@ -1,4 +1,8 @@
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
 #include <string>
 
 #include "log.hpp"
@@ -6,42 +10,213 @@
 namespace Base
 {
 
-void Log::add(LogLevel level, std::string content)
+// 单生产者单消费者环形缓冲区, 生产者是写日志的线程, 消费者是后台写线程
+// 每条记录: 长度(u32) + 级别(u32) + 内容, 按 8 字节对齐
+struct LogRing
 {
-  std::cout << to_string(level, content) << std::endl;
-  messages.emplace_back(std::pair(level, content));
+  std::unique_ptr<char[]> data = std::make_unique<char[]>(Log::RING_CAPACITY);
+  std::atomic<uint64_t> head{0};        // 写位置, 单调递增, 只有生产者修改
+  std::atomic<uint64_t> tail{0};        // 读位置, 单调递增, 只有消费者修改
+  std::atomic<uint64_t> dropped{0};     // 缓冲区满时丢弃的条数
+  std::atomic<bool> closed{false};      // 线程已退出, 取完后移除
+
+  void copy_in(uint64_t position, const void* source, size_t size)
+  {
+    size_t offset = position & (Log::RING_CAPACITY - 1);
+    size_t first = std::min(size, Log::RING_CAPACITY - offset);
+    memcpy(data.get() + offset, source, first);
+    memcpy(data.get(), static_cast<const char*>(source) + first, size - first);
+  }
+
+  void copy_out(uint64_t position, void* target, size_t size) const
+  {
+    size_t offset = position & (Log::RING_CAPACITY - 1);
+    size_t first = std::min(size, Log::RING_CAPACITY - offset);
+    memcpy(target, data.get() + offset, first);
+    memcpy(static_cast<char*>(target) + first, data.get(), size - first);
+  }
+};
+
+namespace
+{
+
+constexpr size_t RECORD_HEADER_SIZE = 8;
+
+// 线程退出时标记缓冲区, 后台线程取完剩余日志后释放
+struct ThreadRingHolder
+{
+  std::shared_ptr<LogRing> ring;
+
+  ~ThreadRingHolder()
+  {
+    if (ring) ring->closed.store(true, std::memory_order_release);
+  }
+};
+
+thread_local ThreadRingHolder t_ring_holder;
+
+}
+
+Log::Log()
+{
+  m_writer = std::thread(&Log::writer_loop, this);
+}
+
+Log::~Log()
+{
+  m_running.store(false, std::memory_order_release);
+  m_wakeup.notify_one();
+  if (m_writer.joinable())
+    m_writer.join();
+  flush();
+}
+
+LogRing& Log::thread_ring()
+{
+  if (!t_ring_holder.ring)
+  {
+    t_ring_holder.ring = std::make_shared<LogRing>();
+    std::lock_guard<std::mutex> lock(m_rings_mutex);
+    m_rings.push_back(t_ring_holder.ring);
+  }
+  return *t_ring_holder.ring;
+}
+
+void Log::set_level(LogLevel level)
+{
+  m_level.store(std::max(static_cast<int>(level), ANDBG_LOG_MIN_LEVEL), std::memory_order_relaxed);
+}
+
+void Log::add(LogLevel level, std::string_view content)
+{
+  LogRing& ring = thread_ring();
+
+  uint32_t size = static_cast<uint32_t>(std::min(content.size(), MAX_MESSAGE_SIZE));
+  uint64_t record_size = (RECORD_HEADER_SIZE + size + 7) & ~uint64_t(7);
+
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  uint64_t tail = ring.tail.load(std::memory_order_acquire);
+  if (head + record_size - tail > RING_CAPACITY)
+  {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  uint32_t header[2] = {size, static_cast<uint32_t>(level)};
+  ring.copy_in(head, header, sizeof(header));
+  ring.copy_in(head + RECORD_HEADER_SIZE, content.data(), size);
+  ring.head.store(head + record_size, std::memory_order_release);
+
+  if (level == LogLevel::ERROR)
+    m_wakeup.notify_one();
+}
+
+bool Log::drain(std::string& output)
+{
+  output.clear();
+
+  std::vector<std::shared_ptr<LogRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(m_rings_mutex);
+    rings = m_rings;
+  }
+
+  std::string content;
+  for (const auto& ring : rings)
+  {
+    // 先读 closed 再读 head, 保证线程退出前写入的日志都能取到
+    bool closed = ring->closed.load(std::memory_order_acquire);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    while (tail < head)
+    {
+      uint32_t header[2];
+      ring->copy_out(tail, header, sizeof(header));
+      content.resize(header[0]);
+      ring->copy_out(tail + RECORD_HEADER_SIZE, content.data(), header[0]);
+
+      output += level_to_string(static_cast<LogLevel>(header[1]));
+      output += content;
+      output += '\n';
+      tail += (RECORD_HEADER_SIZE + header[0] + 7) & ~uint64_t(7);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+
+    uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+      output += fmt::format("{}日志缓冲区已满, 丢弃 {} 条\n", level_to_string(LogLevel::WARNING), dropped);
+
+    if (closed)
+    {
+      std::lock_guard<std::mutex> lock(m_rings_mutex);
+      m_rings.erase(std::remove(m_rings.begin(), m_rings.end(), ring), m_rings.end());
+    }
+  }
+
+  if (output.empty()) return false;
+
+  // 一批日志只写一次, 刷新一次
+  fwrite(output.data(), 1, output.size(), stdout);
+  fflush(stdout);
+  return true;
+}
+
+void Log::writer_loop()
+{
+  // 后台线程不处理信号, 进程收到的信号(如 SIGCHLD)交给主线程
+  sigset_t mask;
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+  std::string output;
+  while (m_running.load(std::memory_order_acquire))
+  {
+    if (drain(output)) continue;
+
+    std::unique_lock<std::mutex> lock(m_wakeup_mutex);
+    m_wakeup.wait_for(lock, std::chrono::milliseconds(WRITER_IDLE_MS));
+  }
 }
 
-std::string Log::to_string(LogLevel level, std::string content)
+void Log::flush()
 {
-  std::string result;
-  switch (level) 
+  // 后台线程退出后直接在调用线程中写出; 运行中时唤醒它并等待缓冲区清空
+  if (!m_writer.joinable())
   {
-    case LogLevel::DEBUG:
-      result += "[DEBUG] ";
-      break;
-    case LogLevel::WARNING:
-      result += "[WARNING] "; 
-      break;
-    case LogLevel::ERROR:
-      result += "[ERROR] "; 
-      break;
-    default: 
-      result += "[UNKNOWN] "; 
-      break;
+    std::string output;
+    drain(output);
+    return;
+  }
+
+  m_wakeup.notify_one();
+  while (true)
+  {
+    bool empty = true;
+    {
+      std::lock_guard<std::mutex> lock(m_rings_mutex);
+      for (const auto& ring : m_rings)
+      {
+        if (ring->tail.load(std::memory_order_acquire) != ring->head.load(std::memory_order_acquire))
+        {
+          empty = false;
+          break;
+        }
+      }
+    }
+    if (empty) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
   }
-  result += content;
-  return result;
 }
 
-std::string Log::to_string()
+const char* Log::level_to_string(LogLevel level)
 {
-  std::ostringstream oss;
-  for (auto [level, content] : messages)
+  switch (level)
   {
-    oss << to_string(level, content) << "\n";
+    case LogLevel::DEBUG: return "[DEBUG] ";
+    case LogLevel::WARNING: return "[WARNING] ";
+    case LogLevel::ERROR: return "[ERROR] ";
+    default: return "[UNKNOWN] ";
   }
-  return oss.str();
 }
 
-}
\ No newline at end of file
+}
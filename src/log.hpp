@@ -1,14 +1,24 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
-#include <sstream> 
 
 #include "fmt/base.h"
 #include "fmt/format.h"
 #include "singleton_base.hpp"
 
+// 编译期日志级别, 低于它的日志连同参数求值和格式化一起被去掉, 0 DEBUG, 1 WARNING, 2 ERROR
+#ifndef ANDBG_LOG_MIN_LEVEL
+#define ANDBG_LOG_MIN_LEVEL 0
+#endif
+
 namespace Base
 {
 
@@ -19,6 +29,12 @@ enum class LogLevel
   ERROR,
 };
 
+// 单个线程的日志环形缓冲区, 定义在 log.cpp
+struct LogRing;
+
+// 异步日志
+// 每个写日志的线程有自己的单生产者单消费者环形缓冲区, 写入不加锁, 后台线程统一取出写到 stdout
+// 缓冲区满时丢弃新日志并计数, 内存占用有上限
 class Log : public SingletonBase<Log>
 {
 private:
@@ -26,56 +42,103 @@ private:
   friend class SingletonBase<Log>;
 
   // 私有化构造函数, 析构函数
-  Log() = default;
-  ~Log() = default;
+  Log();
+  ~Log();
+
+  // 运行时日志级别
+  std::atomic<int> m_level{ANDBG_LOG_MIN_LEVEL};
+
+  // 所有线程的缓冲区, 只在线程第一次写日志和后台线程遍历时加锁
+  std::mutex m_rings_mutex;
+  std::vector<std::shared_ptr<LogRing>> m_rings;
+
+  // 后台写线程
+  std::thread m_writer;
+  std::atomic<bool> m_running{true};
+  std::mutex m_wakeup_mutex;
+  std::condition_variable m_wakeup;
 
-  // 存储日志
-  std::vector<std::pair<LogLevel, std::string>> messages;
+  // 当前线程的缓冲区, 第一次调用时创建并登记
+  LogRing& thread_ring();
+
+  // 后台线程主循环
+  void writer_loop();
+
+  // 取出所有缓冲区中的日志写到 stdout, 返回是否写了内容
+  bool drain(std::string& output);
 
 public:
-  void add(LogLevel level, std::string content);
+  // 每个线程的缓冲区大小, 必须是 2 的幂
+  static constexpr size_t RING_CAPACITY = 1 << 16;
+
+  // 单条日志的最大长度, 超出部分截断
+  static constexpr size_t MAX_MESSAGE_SIZE = 4096;
+
+  // 没有日志时后台线程的等待时间
+  static constexpr int WRITER_IDLE_MS = 10;
+
+  bool is_enabled(LogLevel level) const
+  {
+    return static_cast<int>(level) >= m_level.load(std::memory_order_relaxed);
+  }
+
+  // 运行时级别不能低于编译期级别
+  void set_level(LogLevel level);
+  LogLevel get_level() const { return static_cast<LogLevel>(m_level.load(std::memory_order_relaxed)); }
+
+  // 写入当前线程的缓冲区, ERROR 会立即唤醒后台线程
+  void add(LogLevel level, std::string_view content);
+
+  // 同步写出所有缓冲区中的日志
+  void flush();
 
-  std::string to_string();
-  std::string to_string(LogLevel level, std::string content);
+  static const char* level_to_string(LogLevel level);
 };
 
-static std::string format_log(const char* file, int line, std::string content)
+inline const char* log_filename(const char* file)
 {
-  const char* filename = file;
   const char* slash = strrchr(file, '/');
-  if (slash) filename = slash + 1;
-  
-  std::ostringstream oss;
-  oss << "[" << filename << ":" << line << "] " << content;
-  return oss.str();
+  return slash ? slash + 1 : file;
 }
 
-template<typename... Args>
-static std::string format_log(const char* file, int line, const fmt::format_string<Args...>& format, Args&&... args)
+static void format_log(fmt::memory_buffer& buffer, const char* file, int line, std::string_view content)
 {
-  const char* filename = file;
-  const char* slash = strrchr(file, '/');
-  if (slash) filename = slash + 1;
+  fmt::format_to(fmt::appender(buffer), "[{}:{}] {}", log_filename(file), line, content);
+}
 
-  try 
+template<typename... Args>
+static void format_log(fmt::memory_buffer& buffer, const char* file, int line, const fmt::format_string<Args...>& format, Args&&... args)
+{
+  // 先写文件名, 行号, 再在同一个缓冲区中格式化内容
+  fmt::format_to(fmt::appender(buffer), "[{}:{}] ", log_filename(file), line);
+  try
   {
-    // 先通过 fmt 格式化内容, 再拼接文件名, 行号
-    std::string formatted_content = fmt::format(format, std::forward<Args>(args)...);
-    std::ostringstream oss;
-    oss << "[" << filename << ":" << line << "] " << formatted_content;
-    return oss.str();
+    fmt::format_to(fmt::appender(buffer), format, std::forward<Args>(args)...);
   }
-  catch (const fmt::format_error& e) 
+  catch (const fmt::format_error& e)
   {
     // 格式化错误处理
-    return fmt::format("[{}:{}] [Format Error: {}] (Format: {})", filename, line, e.what(), format.get());
+    fmt::format_to(fmt::appender(buffer), "[Format Error: {}] (Format: {})", e.what(), format.get());
   }
 }
 
 }
 
+// 低于编译期级别的分支被丢弃, 低于运行时级别时不格式化
 #define LOG(level, ...) \
-  Base::Log::get_instance().add(level, Base::format_log(__FILE__, __LINE__, __VA_ARGS__))
+  do \
+  { \
+    if constexpr (static_cast<int>(level) >= ANDBG_LOG_MIN_LEVEL) \
+    { \
+      Base::Log& log_instance_ = Base::Log::get_instance(); \
+      if (log_instance_.is_enabled(level)) \
+      { \
+        fmt::memory_buffer log_buffer_; \
+        Base::format_log(log_buffer_, __FILE__, __LINE__, __VA_ARGS__); \
+        log_instance_.add(level, std::string_view(log_buffer_.data(), log_buffer_.size())); \
+      } \
+    } \
+  } while (0)
 
 #define LOG_DEBUG(...) LOG(Base::LogLevel::DEBUG, __VA_ARGS__)
 #define LOG_WARNING(...) LOG(Base::LogLevel::WARNING, __VA_ARGS__)
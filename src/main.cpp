@@ -1,6 +1,8 @@
 #include "rpc_server.hpp"
 #include "debugger_core.hpp"
+#include "session_manager.hpp"
 #include "log.hpp"
+#include "process.hpp"
 #include "status.hpp"
 #include <cstdint>
 #include <string>
@@ -8,62 +10,368 @@
 #include "utils.hpp"
 
 
-void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
+void acp_init(Base::RPCServer& server, Core::SessionManager& sessions)
 {
   // 返回数据或者接受数据信息都要用 json 字符串, 如果没有信息可以穿空或者提示字符串
 
-  server.register_handler("attach", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("attach", [&sessions](const std::string& params) -> Base::Status
   {
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("target") || !json_data["target"].is_string())
       return Base::Status::fail("attach 需要 target 参数, 且必须是字符串");
 
+    // 已经附加了进程时在新会话中附加
     std::string target = json_data["target"];
-    return debugger.attach(target);
+    Base::Status s = sessions.prepare_session().attach(target);
+    if (s.is_fail()) sessions.close_current();
+    return s;
   });
 
-  server.register_handler("launch", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("launch", [&sessions](const std::string& params) -> Base::Status
   {
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("target") || !json_data["target"].is_string())
       return Base::Status::fail("launch 需要 target 参数, 且必须是字符串");
 
     std::string program = json_data["target"];
-    return debugger.launch(program);
+    Base::Status s = sessions.prepare_session().launch(program);
+    if (s.is_fail()) sessions.close_current();
+    return s;
   });
 
-  server.register_handler("detach", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("detach", [&sessions](const std::string& params) -> Base::Status
   {
-    return debugger.detach();
+    nlohmann::json json_data = params.empty() ? nlohmann::json::object() : nlohmann::json::parse(params);
+    bool force = false;
+    if (json_data.contains("force") && !json_data["force"].is_null())
+    {
+      if (!json_data["force"].is_boolean())
+        return Base::Status::fail("detach 的 force 参数必须是布尔值");
+      force = json_data["force"];
+    }
+
+    Base::Status s = sessions.current().detach(force);
+    if (s.is_success()) sessions.close_current();
+    return s;
   });
 
-  server.register_handler("kill", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("kill", [&sessions](const std::string& params) -> Base::Status
   {
-    return debugger.kill();
+    Base::Status s = sessions.current().kill();
+    if (s.is_success()) sessions.close_current();
+    return s;
   });
 
-  server.register_handler("resume", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("resume", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     return debugger.resume();
   });
 
-  server.register_handler("pause", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("pause", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     return debugger.pause();
   });
 
-  server.register_handler("step_into", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("resume_thread", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("tid") || !json_data["tid"].is_number())
+      return Base::Status::fail("resume_thread 需要 tid 参数");
+    return debugger.resume_thread(json_data["tid"].get<pid_t>());
+  });
+
+  server.register_handler("pause_thread", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("tid") || !json_data["tid"].is_number())
+      return Base::Status::fail("pause_thread 需要 tid 参数");
+    return debugger.pause_thread(json_data["tid"].get<pid_t>());
+  });
+
+  // 运行时日志级别, 不能低于编译期的 ANDBG_LOG_MIN_LEVEL
+  server.register_handler("set_log_level", [](const std::string& params) -> Base::Status
+  {
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("level") || !json_data["level"].is_string())
+      return Base::Status::fail("set_log_level 需要 level 参数, 可选 debug / warning / error");
+
+    std::string level = json_data["level"];
+    if (level == "debug") Base::Log::get_instance().set_level(Base::LogLevel::DEBUG);
+    else if (level == "warning") Base::Log::get_instance().set_level(Base::LogLevel::WARNING);
+    else if (level == "error") Base::Log::get_instance().set_level(Base::LogLevel::ERROR);
+    else return Base::Status::fail("未知的日志级别: {}", level);
+    return Base::Status::success("日志级别: {}", level);
+  });
+
+  // 按包名查找进程时使用的 packages.list, 在 Linux 上测试时可以指向本地文件
+  server.register_handler("set_packages_list_path", [](const std::string& params) -> Base::Status
+  {
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("path") || !json_data["path"].is_string())
+      return Base::Status::fail("set_packages_list_path 需要 path 参数, 且必须是字符串");
+
+    std::string path = json_data["path"];
+    Process::PROCHelper::get_instance().set_packages_list_path(path);
+    return Base::Status::success("packages.list 路径: {}", path);
+  });
+
+  server.register_handler("set_non_stop", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("enable") || !json_data["enable"].is_boolean())
+      return Base::Status::fail("set_non_stop 需要 enable 参数");
+    return debugger.set_non_stop(json_data["enable"].get<bool>());
+  });
+
+  // 单步可以指定 tid, 不停止模式下其他线程继续运行
+  server.register_handler("step_into", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = params.empty() ? nlohmann::json::object() : nlohmann::json::parse(params);
+    if (json_data.contains("tid") && json_data["tid"].is_number())
+    {
+      Base::Status s = debugger.switch_thread(json_data["tid"].get<pid_t>());
+      if (s.is_fail()) return s;
+    }
     return debugger.step_into();
   });
 
-  server.register_handler("step_over", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("step_over", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = params.empty() ? nlohmann::json::object() : nlohmann::json::parse(params);
+    if (json_data.contains("tid") && json_data["tid"].is_number())
+    {
+      Base::Status s = debugger.switch_thread(json_data["tid"].get<pid_t>());
+      if (s.is_fail()) return s;
+    }
     return debugger.step_over();
   });
+
+  server.register_handler("step_out", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = params.empty() ? nlohmann::json::object() : nlohmann::json::parse(params);
+    if (json_data.contains("tid") && json_data["tid"].is_number())
+    {
+      Base::Status s = debugger.switch_thread(json_data["tid"].get<pid_t>());
+      if (s.is_fail()) return s;
+    }
+    return debugger.step_out();
+  });
+  
+  server.register_handler("trace_instructions", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("max_count") || !json_data["max_count"].is_number())
+      return Base::Status::fail("trace_instructions 需要 max_count 参数");
+
+    pid_t tid = 0;
+    debugger.get_current_tid(tid);
+    if (json_data.contains("tid") && json_data["tid"].is_number())
+      tid = json_data["tid"].get<pid_t>();
+
+    uint64_t stop_address = 0;
+    if (json_data.contains("stop_address") && json_data["stop_address"].is_number())
+      stop_address = json_data["stop_address"];
+
+    bool record_registers = json_data.contains("registers") && json_data["registers"].is_boolean() && json_data["registers"].get<bool>();
+
+    size_t count = 0;
+    Base::Status s = debugger.trace_instructions(tid, json_data["max_count"].get<size_t>(), stop_address, record_registers, count);
+
+    std::vector<uint8_t> data;
+    size_t total_size = 0;
+    debugger.read_instruction_trace(0, 0, data, total_size);
+
+    // 跟踪被信号或线程退出打断时已记录的数据仍然可以下载
+    nlohmann::json result = {
+      {"count", count},
+      {"size", total_size},
+      {"complete", s.is_success()},
+      {"message", s.c_str()}
+    };
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("read_instruction_trace", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = params.empty() ? nlohmann::json::object() : nlohmann::json::parse(params);
+    size_t offset = 0;
+    size_t size = SIZE_MAX;
+    if (json_data.contains("offset") && json_data["offset"].is_number())
+      offset = json_data["offset"];
+    if (json_data.contains("size") && json_data["size"].is_number())
+      size = json_data["size"];
+
+    std::vector<uint8_t> data;
+    size_t total_size = 0;
+    Base::Status s = debugger.read_instruction_trace(offset, size, data, total_size);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = {
+      {"offset", offset},
+      {"total_size", total_size},
+      {"data", data}
+    };
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("start_coverage", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("module") || !json_data["module"].is_string())
+      return Base::Status::fail("start_coverage 需要 module 参数");
+
+    std::vector<uint64_t> offsets;
+    if (json_data.contains("offsets") && json_data["offsets"].is_array())
+      offsets = json_data["offsets"].get<std::vector<uint64_t>>();
+
+    return debugger.start_coverage(json_data["module"].get<std::string>(), offsets);
+  });
+
+  server.register_handler("stop_coverage", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    return debugger.stop_coverage();
+  });
+
+  server.register_handler("export_coverage", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    std::vector<uint8_t> data;
+    size_t block_count = 0;
+    size_t hit_count = 0;
+    Base::Status s = debugger.export_coverage(data, block_count, hit_count);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = {
+      {"block_count", block_count},
+      {"hit_count", hit_count},
+      {"data", data}
+    };
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("start_syscall_trace", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("numbers") || !json_data["numbers"].is_array())
+      return Base::Status::fail("start_syscall_trace 需要 numbers 参数, 且必须是数组");
+
+    size_t capture_size = 0;
+    if (json_data.contains("capture_size") && json_data["capture_size"].is_number())
+      capture_size = json_data["capture_size"];
+
+    return debugger.start_syscall_trace(json_data["numbers"].get<std::vector<int>>(), capture_size);
+  });
+
+  server.register_handler("stop_syscall_trace", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    return debugger.stop_syscall_trace();
+  });
+
+  server.register_handler("read_syscall_events", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = params.empty() ? nlohmann::json::object() : nlohmann::json::parse(params);
+    size_t max_size = 0x10000;
+    if (json_data.contains("max_size") && json_data["max_size"].is_number())
+      max_size = json_data["max_size"];
+
+    std::vector<uint8_t> data;
+    size_t count = 0;
+    uint64_t dropped = 0;
+    Base::Status s = debugger.read_syscall_events(max_size, data, count, dropped);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = {
+      {"count", count},
+      {"dropped", dropped},
+      {"data", data}
+    };
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("list_sessions", [&sessions](const std::string& params) -> Base::Status
+  {
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& [id, pid] : sessions.list())
+    {
+      nlohmann::json item;
+      item["session"] = id;
+      item["pid"] = pid;
+      item["current"] = id == sessions.current_id();
+      result.push_back(item);
+    }
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("select_session", [&sessions](const std::string& params) -> Base::Status
+  {
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("session") || !json_data["session"].is_number())
+      return Base::Status::fail("select_session 需要 session 参数, 且必须是数字");
+    return sessions.select(json_data["session"].get<int>());
+  });
+
+  server.register_handler("adopt_fork_child", [&sessions](const std::string& params) -> Base::Status
+  {
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("pid") || !json_data["pid"].is_number())
+      return Base::Status::fail("adopt_fork_child 需要 pid 参数, 且必须是数字");
+
+    int session_id = -1;
+    Base::Status s = sessions.adopt_fork_child(json_data["pid"].get<pid_t>(), session_id);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = {
+      {"session", session_id},
+      {"message", s.c_str()}
+    };
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("wait_event", [&sessions](const std::string& params) -> Base::Status
+  {
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    int timeout = 1000;
+    if (json_data.contains("timeout") && !json_data["timeout"].is_null())
+    {
+      if (!json_data["timeout"].is_number())
+        return Base::Status::fail("wait_event 的 timeout 参数必须是数字");
+      timeout = json_data["timeout"];
+    }
+
+    // 等待所有会话, 有事件的会话成为当前会话
+    int session_id = -1;
+    pid_t tid = 0;
+    int signal = 0;
+    Base::Status s = sessions.wait_event(timeout, session_id, tid, signal);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = {
+      {"session", session_id},
+      {"tid", tid},
+      {"signal", signal},
+      {"message", s.c_str()}
+    };
+    return Base::Status::success(result);
+  });
   
-  server.register_handler("read_memory", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("read_memory", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("address") || !json_data.contains("size") 
     || !json_data["address"].is_number() || !json_data["size"].is_number())
@@ -86,8 +394,9 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     }
   });
 
-  server.register_handler("write_memory", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("write_memory", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("address") || !json_data.contains("data") 
     || !json_data["address"].is_number() || !json_data["data"].is_array())
@@ -99,8 +408,9 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     return debugger.write_memory(address, buffer.data(), buffer.size());
   });
 
-  server.register_handler("get_memory_regions", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("get_memory_regions", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     std::vector<Core::MemoryRegion> regions;
     Base::Status s = debugger.get_memory_regions(regions);
     if (s.is_fail()) return s;
@@ -124,8 +434,9 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
   });
 
   // 寄存器的返回值必须是字符串, 因为要支持 128 位寄存器, 直接返回数字会有问题
-  server.register_handler("read_registers", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("read_registers", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     nlohmann::json result;
     Base::Status s = debugger.read_registers(json_data, result);
@@ -133,14 +444,16 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     else return Base::Status::success(result);
   });
 
-  server.register_handler("write_registers", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("write_registers", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     return debugger.write_registers(json_data);
   });
 
-  server.register_handler("set_breakpoint", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("set_breakpoint", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("type") || !json_data.contains("address") 
     || !json_data["type"].is_number() || !json_data["address"].is_number())
@@ -152,8 +465,25 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     return debugger.set_breakpoint(static_cast<Core::BreakpointType>(type), address, breakpoint_id);
   });
 
-  server.register_handler("remove_breakpoint", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("set_watchpoint", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("type") || !json_data["type"].is_number() || 
+    !json_data.contains("address") || !json_data["address"].is_number() ||
+    !json_data.contains("length") || !json_data["length"].is_number())
+      return Base::Status::fail("set_watchpoint 需要 type, address 和 length 参数, 且必须是数字");
+
+    int type = json_data["type"];
+    uint64_t address = json_data["address"];
+    size_t length = json_data["length"];
+    int breakpoint_id;
+    return debugger.set_watchpoint(static_cast<Core::BreakpointType>(type), address, length, breakpoint_id);
+  });
+
+  server.register_handler("remove_breakpoint", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("breakpoint_id") || !json_data["breakpoint_id"].is_number())
       return Base::Status::fail("remove_breakpoint 需要 breakpoint_id 参数, 且必须是数字");
@@ -162,8 +492,9 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     return debugger.remove_breakpoint(breakpoint_id);
   });
 
-  server.register_handler("enable_breakpoint", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("enable_breakpoint", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("breakpoint_id") || !json_data["breakpoint_id"].is_number())
       return Base::Status::fail("enable_breakpoint 需要 breakpoint_id 参数, 且必须是数字");
@@ -172,8 +503,9 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     return debugger.enable_breakpoint(breakpoint_id);
   });
 
-  server.register_handler("disable_breakpoint", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("disable_breakpoint", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("breakpoint_id") || !json_data["breakpoint_id"].is_number())
       return Base::Status::fail("disable_breakpoint 需要 breakpoint_id 参数, 且必须是数字");
@@ -182,8 +514,22 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     return debugger.disable_breakpoint(breakpoint_id);
   });
 
-  server.register_handler("get_breakpoints", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("set_ignore_count", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("breakpoint_id") || !json_data["breakpoint_id"].is_number() ||
+    !json_data.contains("count") || !json_data["count"].is_number())
+      return Base::Status::fail("set_ignore_count 需要 breakpoint_id 和 count 参数, 且必须是数字");
+
+    int breakpoint_id = json_data["breakpoint_id"];
+    uint64_t count = json_data["count"];
+    return debugger.set_ignore_count(breakpoint_id, count);
+  });
+
+  server.register_handler("get_breakpoints", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (json_data.contains("tid") && !json_data["tid"].is_null())
     {
@@ -201,7 +547,10 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
             {"tid", bp.tid},
             {"address", bp.address},
             {"type", static_cast<int>(bp.type)},
-            {"enabled", bp.enabled}
+            {"enabled", bp.enabled},
+            {"hit_count", bp.hit_count},
+            {"ignore_count", bp.ignore_count},
+            {"latency_histogram", bp.latency_histogram}
           });
         }
         return Base::Status::success(result);
@@ -222,7 +571,10 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
             {"tid", bp.tid},
             {"address", bp.address},
             {"type", static_cast<int>(bp.type)},
-            {"enabled", bp.enabled}
+            {"enabled", bp.enabled},
+            {"hit_count", bp.hit_count},
+            {"ignore_count", bp.ignore_count},
+            {"latency_histogram", bp.latency_histogram}
           });
         }
         return Base::Status::success(result);
@@ -230,8 +582,9 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     }
   });
 
-  server.register_handler("get_breakpoint", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("get_breakpoint", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (json_data.contains("address") && !json_data["address"].is_null())
     {
@@ -249,7 +602,10 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
           {"tid", breakpoint.tid},
           {"address", breakpoint.address},
           {"type", static_cast<int>(breakpoint.type)},
-          {"enabled", breakpoint.enabled}
+          {"enabled", breakpoint.enabled},
+          {"hit_count", breakpoint.hit_count},
+          {"ignore_count", breakpoint.ignore_count},
+          {"latency_histogram", breakpoint.latency_histogram}
         };
         return Base::Status::success(result);
       }
@@ -270,7 +626,10 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
           {"tid", breakpoint.tid},
           {"address", breakpoint.address},
           {"type", static_cast<int>(breakpoint.type)},
-          {"enabled", breakpoint.enabled}
+          {"enabled", breakpoint.enabled},
+          {"hit_count", breakpoint.hit_count},
+          {"ignore_count", breakpoint.ignore_count},
+          {"latency_histogram", breakpoint.latency_histogram}
         };
         return Base::Status::success(result);
       }
@@ -278,8 +637,71 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     else return Base::Status::fail("参数错误");
   });
 
-  server.register_handler("get_threads", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("get_page_watch_stats", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    std::vector<Core::PageWatchStat> stats;
+    Base::Status s = debugger.get_page_watch_stats(stats);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& stat : stats)
+    {
+      result.push_back({
+        {"page", stat.page},
+        {"original_prot", stat.original_prot},
+        {"protect_prot", stat.protect_prot},
+        {"faults", stat.faults},
+        {"hits", stat.hits}
+      });
+    }
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("read_trace_records", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    size_t max_count = Core::TraceRing::CAPACITY;
+    if (json_data.contains("max_count") && !json_data["max_count"].is_null())
+    {
+      if (!json_data["max_count"].is_number())
+        return Base::Status::fail("read_trace_records 的 max_count 参数必须是数字");
+      max_count = json_data["max_count"];
+    }
+
+    std::vector<Core::TraceRecord> records;
+    uint64_t dropped = 0;
+    Base::Status s = debugger.read_trace_records(max_count, records, dropped);
+    if (s.is_fail()) return s;
+
+    nlohmann::json records_json = nlohmann::json::array();
+    for (const auto& record : records)
+    {
+      nlohmann::json regs_json = nlohmann::json::array();
+      for (uint64_t reg : record.regs)
+        regs_json.push_back(Utils::num_to_hex_str<uint64_t>(reg).value());
+
+      records_json.push_back({
+        {"id", record.hook_id},
+        {"pc", Utils::num_to_hex_str<uint64_t>(record.pc).value()},
+        {"sp", Utils::num_to_hex_str<uint64_t>(record.sp).value()},
+        {"nzcv", Utils::num_to_hex_str<uint64_t>(record.nzcv).value()},
+        {"thread_pointer", Utils::num_to_hex_str<uint64_t>(record.thread_pointer).value()},
+        {"regs", regs_json}
+      });
+    }
+
+    nlohmann::json result = {
+      {"records", records_json},
+      {"dropped", dropped}
+    };
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("get_threads", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
     std::vector<pid_t> threads;
     Base::Status s = debugger.get_threads(threads);
     if (s.is_fail()) return s;
@@ -294,8 +716,109 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     }
   });
 
-  server.register_handler("switch_thread", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("get_thread_infos", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    std::vector<Core::ThreadInfo> threads;
+    Base::Status s = debugger.get_threads(threads);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& thread : threads)
+    {
+      nlohmann::json item;
+      item["tid"] = thread.tid;
+      item["state"] = Core::ThreadInfo::state_to_string(thread.state);
+      item["last_stop_reason"] = Core::ThreadInfo::reason_to_string(thread.last_stop_reason);
+      item["last_signal"] = thread.last_signal;
+      item["exit_code"] = thread.exit_code;
+      result.push_back(item);
+    }
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("set_signal_policy", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("signal") || !json_data["signal"].is_number())
+      return Base::Status::fail("set_signal_policy 需要 signal 参数, 且必须是数字");
+    int signal = json_data["signal"];
+
+    // 没有给出的字段保持不变
+    std::map<int, Core::SignalPolicy> policies;
+    debugger.get_signal_policies(policies);
+    auto policy_it = policies.find(signal);
+    if (policy_it == policies.end())
+      return Base::Status::fail("无效的信号: {}", signal);
+
+    Core::SignalPolicy policy = policy_it->second;
+    if (json_data.contains("stop") && json_data["stop"].is_boolean()) policy.stop = json_data["stop"];
+    if (json_data.contains("print") && json_data["print"].is_boolean()) policy.print = json_data["print"];
+    if (json_data.contains("pass") && json_data["pass"].is_boolean()) policy.pass = json_data["pass"];
+    return debugger.set_signal_policy(signal, policy.stop, policy.print, policy.pass);
+  });
+
+  server.register_handler("get_signal_policies", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    std::map<int, Core::SignalPolicy> policies;
+    Base::Status s = debugger.get_signal_policies(policies);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& [signal, policy] : policies)
+    {
+      nlohmann::json item;
+      item["signal"] = signal;
+      item["stop"] = policy.stop;
+      item["print"] = policy.print;
+      item["pass"] = policy.pass;
+      item["received"] = policy.received;
+      result.push_back(item);
+    }
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("set_follow_policy", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    Core::ForkPolicy fork_policy = Core::ForkPolicy::DETACH;
+    if (json_data.contains("fork") && json_data["fork"].is_string())
+    {
+      std::string fork = json_data["fork"];
+      if (fork == "keep")
+        fork_policy = Core::ForkPolicy::KEEP;
+      else if (fork != "detach")
+        return Base::Status::fail("fork 参数只能是 detach 或 keep");
+    }
+
+    bool stop_on_exec = json_data.contains("stop_on_exec") && json_data["stop_on_exec"].is_boolean() && json_data["stop_on_exec"].get<bool>();
+    return debugger.set_follow_policy(fork_policy, stop_on_exec);
+  });
+
+  server.register_handler("get_fork_children", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    std::vector<pid_t> children;
+    Base::Status s = debugger.get_fork_children(children);
+    if (s.is_fail()) return s;
+    return Base::Status::success(nlohmann::json(children));
+  });
+
+  server.register_handler("detach_fork_child", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    nlohmann::json json_data = nlohmann::json::parse(params);
+    if (!json_data.contains("pid") || !json_data["pid"].is_number())
+      return Base::Status::fail("detach_fork_child 需要 pid 参数, 且必须是数字");
+    return debugger.detach_fork_child(json_data["pid"].get<pid_t>());
+  });
+
+  server.register_handler("switch_thread", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
     nlohmann::json json_data = nlohmann::json::parse(params);
     if (!json_data.contains("tid") || !json_data["tid"].is_number())
       return Base::Status::fail("switch_thread 需要 tid 参数, 且必须是数字");
@@ -304,8 +827,9 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     return debugger.switch_thread(tid);
   });
 
-  server.register_handler("get_pid", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("get_pid", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     pid_t pid;
     Base::Status s = debugger.get_pid(pid);
     if (s.is_fail()) return s;
@@ -318,8 +842,28 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
     
   });
 
-  server.register_handler("get_current_tid", [&debugger](const std::string& params) -> Base::Status
+  server.register_handler("get_attach_stats", [&sessions](const std::string& params) -> Base::Status
+  {
+    Core::DebuggerCore& debugger = sessions.current();
+    Core::AttachStats stats;
+    Base::Status s = debugger.get_attach_stats(stats);
+    if (s.is_fail()) return s;
+
+    nlohmann::json result;
+    result["threads"] = stats.threads;
+    result["failed"] = stats.failed;
+    result["already_attached"] = stats.already_attached;
+    result["rounds"] = stats.rounds;
+    result["enumerate_us"] = stats.enumerate_us;
+    result["seize_us"] = stats.seize_us;
+    result["reap_us"] = stats.reap_us;
+    result["total_us"] = stats.total_us;
+    return Base::Status::success(result);
+  });
+
+  server.register_handler("get_current_tid", [&sessions](const std::string& params) -> Base::Status
   {
+    Core::DebuggerCore& debugger = sessions.current();
     pid_t tid;
     Base::Status s = debugger.get_current_tid(tid);
     if (s.is_fail()) return s;
@@ -335,9 +879,12 @@ void acp_init(Base::RPCServer& server, Core::DebuggerCore& debugger)
 
 int main()
 {
-  Core::DebuggerCore debugger;
+  // 在创建任何线程之前屏蔽 SIGCHLD, wait_event 阻塞在 signalfd 上
+  Utils::block_child_signal();
+
+  Core::SessionManager sessions;
   Base::RPCServer server;
-  acp_init(server, debugger);
+  acp_init(server, sessions);
   server.start(5073);
   return 0;
 }
\ No newline at end of file
@@ -1,12 +1,12 @@
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <charconv>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <linux/uio.h>
-#include <sstream>
 #include <string>
 #include <sys/uio.h>
 #include <vector>
@@ -77,15 +77,16 @@ std::vector<MemoryRegion> MemoryControl::get_memory_regions(pid_t pid)
 {
   std::vector<MemoryRegion> regions;
 
-  std::optional<Base::File> maps_file = Base::File::open(fmt::format("/proc/{}/maps", pid));
-  if (!maps_file || !maps_file->is_open()) 
+  // 每次暂停都可能读取, 复用缓存的描述符和缓冲区
+  if (!Process::PROCHelper::get_instance().read_proc_file(pid, Process::ProcFileType::MAPS, m_maps_buffer))
   {
-    LOG_ERROR("解析进程状态失败: 无法打开/proc/{}/maps", pid);
+    LOG_ERROR("解析进程状态失败: 无法读取/proc/{}/maps", pid);
     return regions;
   }
 
-  std::vector<std::string> lines = maps_file.value().read_lines();
-  for (const auto& line : lines)
+  Base::LineReader reader(std::string_view(m_maps_buffer.data(), m_maps_buffer.size()));
+  std::string_view line;
+  while (reader.next(line))
   {
     if (line.empty()) continue;
 
@@ -107,22 +108,40 @@ std::vector<MemoryRegion> MemoryControl::get_memory_regions(pid_t pid)
   return regions;
 }
 
-bool MemoryControl::parse_maps_line(const std::string& line, MemoryRegion& region)
+bool MemoryControl::parse_maps_line(std::string_view line, MemoryRegion& region)
 {
-  std::istringstream iss(line);
-  std::string address_range;
-  iss >> address_range;
+  // 直接在行视图上切字段, 不拷贝整行
+  std::string_view rest = line;
+  auto next_field = [&rest]() {
+    size_t begin = rest.find_first_not_of(' ');
+    if (begin == std::string_view::npos) begin = rest.size();
+    rest.remove_prefix(begin);
+    size_t space = std::min(rest.find(' '), rest.size());
+    std::string_view field = rest.substr(0, space);
+    rest.remove_prefix(space);
+    return field;
+  };
+  auto parse_number = [](std::string_view text, uint64_t& value, int base) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return error == std::errc() && end == text.data() + text.size() && !text.empty();
+  };
+
+  std::string_view address_range = next_field();
 
   // 解析地址范围
   size_t hyphen_position = address_range.find('-');
-  if (hyphen_position == std::string::npos)
+  if (hyphen_position == std::string_view::npos)
   {
     LOG_ERROR("地址范围格式错误, 缺少 '-': {}", line);
     return false;
   }
 
-  region.start_address = std::stoull(address_range.substr(0, hyphen_position), nullptr, 16);
-  region.end_address = std::stoull(address_range.substr(hyphen_position + 1), nullptr, 16);
+  if (!parse_number(address_range.substr(0, hyphen_position), region.start_address, 16) ||
+      !parse_number(address_range.substr(hyphen_position + 1), region.end_address, 16))
+  {
+    LOG_ERROR("地址范围格式错误: {}", line);
+    return false;
+  }
   region.size = region.end_address - region.start_address;
 
   // 验证区域有效性
@@ -139,25 +158,28 @@ bool MemoryControl::parse_maps_line(const std::string& line, MemoryRegion& regio
     return false;
   }
   
-  iss >> region.permissions;
+  region.permissions.assign(next_field());
   if (region.permissions.empty() || region.permissions.size() > 5)
     LOG_WARNING("权限字段格式异常: {} | 行内容: {}", region.permissions, line);
 
-  std::string offset_str;
-  iss >> offset_str;
-  region.offset = std::stoull(offset_str, nullptr, 16);
-
-  iss >> region.device;
+  if (!parse_number(next_field(), region.offset, 16))
+  {
+    LOG_ERROR("偏移字段格式错误: {}", line);
+    return false;
+  }
 
-  std::string inode_str;
-  iss >> inode_str;
-  region.inode = std::stoull(inode_str);
+  region.device.assign(next_field());
 
-  // 解析路径名
-  std::getline(iss >> std::ws, region.pathname);
+  if (!parse_number(next_field(), region.inode, 10))
+  {
+    LOG_ERROR("inode 字段格式错误: {}", line);
+    return false;
+  }
 
-  // 处理空路径名的情况
-  if (region.pathname.empty()) region.pathname = "[anonymous]";
+  // 解析路径名, 路径中可能带空格, 取剩余部分
+  size_t path_begin = rest.find_first_not_of(' ');
+  if (path_begin == std::string_view::npos) region.pathname = "[anonymous]";
+  else region.pathname.assign(rest.substr(path_begin));
 
   return true;
 }
@@ -173,6 +195,11 @@ bool MemoryControl::read_memory(pid_t pid, uint64_t address, void* buffer, size_
   LOG_ERROR("process_vm_readv 失败 | pid: {} | addr: 0x{:x} | 大小: {} | 错误: {} ({})",
   pid, address, size, strerror(errno), errno);
 
+  // 不可读的页(PROT_NONE 等) process_vm_readv 会失败, /proc/[pid]/mem 带 FOLL_FORCE 可以读, 一次调用代替逐字 PEEKDATA
+  ssize_t nread = Process::PROCHelper::get_instance().pread_proc_file(pid, 0, Process::ProcFileType::MEM,
+    buffer, size, static_cast<off_t>(address));
+  if (nread == static_cast<ssize_t>(size)) return true;
+
   // 如果 process_vm_readv 失败, 回退到 ptrace
   LOG_WARNING("process_vm_readv 失败, 使用 ptrace");
   return read_memory_ptrace(pid, address, buffer, size);
@@ -195,4 +222,12 @@ bool MemoryControl::write_memory(pid_t pid, uint64_t address, const void* buffer
   return write_memory_ptrace(pid, address, buffer, size);
 }
 
+bool MemoryControl::write_code(pid_t pid, uint64_t address, const void* buffer, size_t size)
+{
+  if (write_memory_ptrace(pid, address, buffer, size)) return true;
+
+  LOG_ERROR("写入代码失败 | pid: {} | addr: 0x{:x} | 大小: {}", pid, address, size);
+  return false;
+}
+
 }
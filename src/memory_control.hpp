@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <sys/types.h>
 #include <vector>
 #include <sys/mman.h> 
@@ -59,7 +60,10 @@ private:
   bool write_memory_ptrace(pid_t pid, uint64_t address, const void* buffer, size_t size);
 
   // maps 解析器
-  bool parse_maps_line(const std::string& line, MemoryRegion& region);
+  bool parse_maps_line(std::string_view line, MemoryRegion& region);
+
+  // 读取 maps 的缓冲区
+  std::vector<char> m_maps_buffer;
 
 public:
 
@@ -69,6 +73,9 @@ public:
   // 写入内存
   bool write_memory(pid_t pid, uint64_t address, const void* buffer, size_t size);
 
+  // 写入代码, 直接走 ptrace, 可以写只读的代码页, 内核会同步指令缓存
+  bool write_code(pid_t pid, uint64_t address, const void* buffer, size_t size);
+
   // 获取内存布局, 返回结果地址升序排列
   std::vector<MemoryRegion> get_memory_regions(pid_t pid);
 };
@@ -1,9 +1,16 @@
+#include <charconv>
 #include <cstddef>
 #include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <fcntl.h>
+#include <functional>
+#include <pwd.h>
+#include <string_view>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <filesystem>
 #include <algorithm>
 #include <vector>
@@ -21,6 +28,42 @@ namespace Process
 namespace  
 {
 
+// getdents64 返回的目录项, glibc 没有导出
+struct linux_dirent64
+{
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// 用 getdents64 遍历目录中全为数字的项, . 和 .. 自然被过滤, 返回是否读取成功
+bool for_each_numeric_entry(int dir_fd, const std::function<void(pid_t)>& callback)
+{
+  alignas(linux_dirent64) char buffer[8192];
+  while (true)
+  {
+    long nread = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+    if (nread == -1 && errno == EINTR) continue;
+    if (nread == 0) return true;
+    if (nread < 0) return false;
+
+    for (long offset = 0; offset < nread;)
+    {
+      auto* entry = reinterpret_cast<linux_dirent64*>(buffer + offset);
+      offset += entry->d_reclen;
+
+      pid_t id = 0;
+      const char* c = entry->d_name;
+      for (; *c >= '0' && *c <= '9'; ++c)
+        id = id * 10 + (*c - '0');
+      if (*c == '\0' && c != entry->d_name)
+        callback(id);
+    }
+  }
+}
+
 // 文件类型到文件名的映射
 const std::unordered_map<ProcFileType, std::string> FILE_TYPE_TO_NAME = 
 {
@@ -122,40 +165,74 @@ std::string PROCHelper::proc_file_type_to_string(ProcFileType type)
 
 std::vector<pid_t> PROCHelper::get_thread_ids(pid_t pid)
 {
-  std::optional<Base::File> task_file = Base::File::open(fmt::format("/proc/{}/task", pid));
-  if (!task_file || !task_file->is_open()) 
+  // 附加时的热路径, 直接用 getdents64 读目录, 不经过 readdir 和 Base::File
+  int fd = open(fmt::format("/proc/{}/task", pid).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1)
   {
     LOG_ERROR("解析进程状态失败：无法打开/proc/{}/task", pid);
     return {};
   }
 
   std::vector<pid_t> tids;
-  std::vector<dirent*> entrys = task_file.value().list_entries();
+  if (!for_each_numeric_entry(fd, [&tids](pid_t tid) { tids.push_back(tid); }))
+    LOG_ERROR("读取 /proc/{}/task 失败: {}", pid, strerror(errno));
 
-  for (const auto entry : entrys)
+  close(fd);
+  return tids;
+}
+
+void PROCHelper::set_packages_list_path(const std::string& path)
+{
+  m_packages_list_path = path;
+  m_package_uids.clear();
+  m_packages_list_mtime_ns = -1;
+}
+
+std::optional<uid_t> PROCHelper::find_app_uid(const std::string& package_name)
+{
+  struct stat st;
+  if (stat(m_packages_list_path.c_str(), &st) == -1)
   {
-    if (entry->d_type == DT_DIR)
+    LOG_WARNING("无法访问 {}: {}", m_packages_list_path, strerror(errno));
+    return std::nullopt;
+  }
+
+  // 安装或卸载应用时文件会被整体替换, 只比较修改时间
+  int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  if (mtime_ns != m_packages_list_mtime_ns)
+  {
+    auto list_file = Base::File::open(m_packages_list_path);
+    if (!list_file || !list_file->is_open())
     {
-      // 检查目录是否全为数字
-      bool is_numeric = true;
-      for (int i = 0; entry->d_name[i] != '\0'; ++i)
-      {
-        if (!isdigit(entry->d_name[i]))
-        {
-          is_numeric = false;
-          break;
-        }
-      }
-
-      if (is_numeric && strlen(entry->d_name) > 0)
-      {
-        tids.push_back(static_cast<pid_t>(std::stoi(entry->d_name)));
-      }
+      LOG_WARNING("打开 {} 失败", m_packages_list_path);
+      return std::nullopt;
     }
+
+    auto content = list_file->read();
+    if (!content) return std::nullopt;
+
+    // 每行: 包名 uid 是否可调试 数据目录 seinfo gids ..., 只需要前两列
+    m_package_uids.clear();
+    Base::LineReader reader(content.value());
+    std::string_view line;
+    while (reader.next(line))
+    {
+      size_t name_end = line.find(' ');
+      if (name_end == std::string_view::npos) continue;
+
+      uid_t uid = 0;
+      const char* uid_begin = line.data() + name_end + 1;
+      auto [uid_end, error] = std::from_chars(uid_begin, line.data() + line.size(), uid);
+      if (error != std::errc() || uid_end == uid_begin) continue;
+      m_package_uids[std::string(line.substr(0, name_end))] = uid;
+    }
+    m_packages_list_mtime_ns = mtime_ns;
+    LOG_DEBUG("解析 {}, 包数量: {}", m_packages_list_path, m_package_uids.size());
   }
 
-  // 编译器会自动进行 RVO(返回值优化), 加不加 std::move 都行
-  return std::move(tids); 
+  auto it = m_package_uids.find(package_name);
+  if (it == m_package_uids.end()) return std::nullopt;
+  return it->second;
 }
 
 std::vector<pid_t> PROCHelper::find_pid_by_package_name(const std::string& package_name)
@@ -166,66 +243,61 @@ std::vector<pid_t> PROCHelper::find_pid_by_package_name(const std::string& packa
     return {};
   }
 
-  std::vector<pid_t> match_pids;
+  std::optional<uid_t> app_uid = find_app_uid(package_name);
+  if (!app_uid)
+    LOG_WARNING("packages.list 中没有 {}, 扫描所有进程的 cmdline", package_name);
 
-  // 遍历 /proc 下所有条目
-  auto proc_root = Base::File::open("/proc");
-  if (!proc_root || !proc_root->is_open() || !proc_root->is_directory()) 
+  int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (proc_fd == -1)
   {
     LOG_ERROR("打开 /proc 目录失败: {}", strerror(errno));
-    return match_pids;
+    return {};
   }
 
-  auto entries = proc_root->list_entries();
-  for (auto* entry : entries)
-  {
-    if (!entry) continue;
-    const char* name = entry->d_name;
-
-    // 仅处理数字组成的目录名
-    bool is_pid = true;
-    for (const char* c = name; *c != '\0'; ++c) 
-    {
-      if (!std::isdigit(static_cast<unsigned char>(*c))) 
-      {
-        is_pid = false;
-        break;
-      }
-    }
-    if (!is_pid) continue;
-
-    // 转换为 PID 数值
-    pid_t pid = static_cast<pid_t>(std::atoi(name));
-    if (pid <= 0) continue;
-
-    // 读取 /proc/[pid]/cmdline
-    auto cmdline_file = Base::File::open(fmt::format("/proc/{}/cmdline", pid));
-    if (cmdline_file && cmdline_file->is_open()) 
+  // 主进程的进程名就是包名, android:process 指定的子进程是 包名:xxx
+  std::vector<pid_t> main_pids;
+  std::vector<pid_t> sub_pids;
+  size_t cmdline_reads = 0;
+  bool ok = for_each_numeric_entry(proc_fd, [&](pid_t pid) {
+    char path[32];
+    if (app_uid)
     {
-      std::vector<char> cmdline_data = cmdline_file->read_all();
-      // cmdline 以 '\0' 分隔参数, 替换为空格方便匹配
-      std::string cmdline;
-      for (char ch : cmdline_data)
-      {
-        if (ch == '\0')
-          cmdline += ' ';
-        else
-          cmdline += ch;
-      }
-      if (Utils::contains_string(cmdline, package_name, false)) 
-      {
-        match_pids.push_back(pid);
-        continue;
-      }
+      // 先用目录属主过滤, 不属于该应用的进程不读 cmdline
+      snprintf(path, sizeof(path), "%d", pid);
+      struct stat st;
+      if (fstatat(proc_fd, path, &st, 0) == -1 || st.st_uid % AID_USER_OFFSET != app_uid.value())
+        return;
     }
-  }
 
-  // 去重
-  std::sort(match_pids.begin(), match_pids.end());
-  auto last = std::unique(match_pids.begin(), match_pids.end());
-  match_pids.erase(last, match_pids.end());
-
-  LOG_DEBUG("找到 {} 个匹配包名 {} 的进程", match_pids.size(), package_name);
+    snprintf(path, sizeof(path), "%d/cmdline", pid);
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+
+    // 只需要第一个参数
+    char name[256];
+    ssize_t nread = read(fd, name, sizeof(name) - 1);
+    close(fd);
+    ++cmdline_reads;
+    if (nread <= 0) return;
+    name[nread] = '\0';
+
+    size_t name_size = strlen(name);
+    if (name_size == package_name.size() && package_name.compare(0, name_size, name) == 0)
+      main_pids.push_back(pid);
+    else if (name_size > package_name.size() && name[package_name.size()] == ':' &&
+      package_name.compare(0, package_name.size(), name, package_name.size()) == 0)
+      sub_pids.push_back(pid);
+  });
+  if (!ok)
+    LOG_ERROR("读取 /proc 目录失败: {}", strerror(errno));
+  close(proc_fd);
+
+  std::sort(main_pids.begin(), main_pids.end());
+  std::sort(sub_pids.begin(), sub_pids.end());
+  std::vector<pid_t> match_pids = std::move(main_pids);
+  match_pids.insert(match_pids.end(), sub_pids.begin(), sub_pids.end());
+
+  LOG_DEBUG("找到 {} 个匹配包名 {} 的进程, 读取 cmdline {} 次", match_pids.size(), package_name, cmdline_reads);
   return match_pids;
 }
 
@@ -238,31 +310,14 @@ std::optional<std::string> PROCHelper::find_package_name_by_pid(pid_t pid)
   }
 
   auto cmdline_file = Base::File::open(fmt::format("/proc/{}/cmdline", pid));
-  if (cmdline_file && cmdline_file->is_open()) 
+  std::optional<std::string_view> cmdline;
+  if (cmdline_file && cmdline_file->is_open() && (cmdline = cmdline_file->read())) 
   {
-    std::vector<char> cmdline_data = cmdline_file->read_all();
-    // cmdline 以 '\0' 分隔参数, 替换为空格方便匹配
-    std::string cmdline;
-    for (char ch : cmdline_data)
+    if (!cmdline->empty()) 
     {
-      if (ch == '\0')
-        cmdline += ' ';
-      else
-        cmdline += ch;
-    }
-    LOG_DEBUG("读取到的 cmdline: {}", cmdline);
-
-    if (!cmdline.empty()) 
-    {
-      // 直接返回 cmdline 第一项
-      std::string package_name;
-      for (char ch : cmdline_data)
-      {
-        if (ch == '\0')
-          break;
-        else
-          package_name += ch;
-      }
+      // cmdline 以 '\0' 分隔参数, 直接返回第一项
+      std::string package_name(cmdline->substr(0, cmdline->find('\0')));
+      LOG_DEBUG("读取到的 cmdline 第一项: {}", package_name);
       return package_name;
     }
     else  
@@ -288,20 +343,25 @@ std::unordered_map<std::string, std::string> PROCHelper::parse_status(pid_t pid)
   }
 
   std::unordered_map<std::string, std::string> status_map;
-
-  std::vector<std::string> lines = status_file->read_lines();
-  for (const std::string& line : lines) 
+  auto content = status_file->read();
+  if (!content) return status_map;
+
+  // 去除前缀和后缀空白
+  auto trim = [](std::string_view text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) return std::string_view();
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+  };
+
+  Base::LineReader reader(content.value());
+  std::string_view line;
+  while (reader.next(line)) 
   {
     size_t colon_pos = line.find(':');
-    if (colon_pos == std::string::npos) continue;
+    if (colon_pos == std::string_view::npos) continue;
 
-    std::string key = line.substr(0, colon_pos);
-    std::string value = line.substr(colon_pos + 1);
-
-    // 去除前缀和后缀空格
-    key = Utils::trim(key);
-    value = Utils::trim(value);
-    status_map[key] = value;
+    status_map.emplace(trim(line.substr(0, colon_pos)), trim(line.substr(colon_pos + 1)));
   }
 
   return status_map;
@@ -309,98 +369,323 @@ std::unordered_map<std::string, std::string> PROCHelper::parse_status(pid_t pid)
 
 char PROCHelper::get_process_state_char(pid_t pid)
 {
-  if (pid <= 0) 
+  return get_thread_state_char(pid, pid);
+}
+
+ProcessState PROCHelper::get_process_state(pid_t pid)
+{
+  return char_to_process_state(get_process_state_char(pid));
+}
+
+char PROCHelper::get_thread_state_char(pid_t pid, pid_t tid)
+{
+  if (pid <= 0 || tid <= 0) 
+  {
+    LOG_ERROR("解析线程状态失败: 无效 PID({}) TID({})", pid, tid);
+    return '?';
+  }
+
+  // stat 的开头是 "tid (comm) state", comm 最长 16 字节, 读 128 字节足够
+  char buffer[128];
+  ssize_t nread = pread_proc_file(pid, tid, ProcFileType::STAT, buffer, sizeof(buffer), 0);
+  if (nread <= 0)
   {
-    LOG_ERROR("解析进程状态失败: 无效PID({})", pid);
+    LOG_ERROR("解析线程状态失败: 无法读取 /proc/{}/task/{}/stat", pid, tid);
     return '?';
   }
 
-  auto status_map = parse_status(pid);
-  auto it = status_map.find("State");
-  if (it == status_map.end() || it->second.empty())
+  // comm 中可能有 ')', 取最后一个
+  const char* comm_end = static_cast<const char*>(memrchr(buffer, ')', static_cast<size_t>(nread)));
+  if (comm_end == nullptr || comm_end + 2 >= buffer + nread)
   {
-    LOG_ERROR("解析进程状态失败: PID({})的 status 文件无 State 字段", pid);
-    return '?'; 
+    LOG_ERROR("解析线程状态失败: TID({}) 的 stat 格式有误", tid);
+    return '?';
   }
 
-  return static_cast<unsigned char>(it->second[0]);
+  return comm_end[2];
 }
 
-ProcessState PROCHelper::get_process_state(pid_t pid)
+ProcessState PROCHelper::get_thread_state(pid_t pid, pid_t tid)
 {
-  return char_to_process_state(get_process_state_char(pid));
+  return char_to_process_state(get_thread_state_char(pid, tid));
 }
 
-bool PSHelper::parse_single_line(std::string line, PSItem& item)
+void PROCHelper::get_thread_states(pid_t pid, const std::vector<pid_t>& tids, std::vector<ProcessState>& states)
 {
-  auto tokens = Utils::split_by_space(line);
-  if (tokens.size() < 9)
+  states.resize(tids.size());
+  for (size_t i = 0; i < tids.size(); ++i)
+    states[i] = get_thread_state(pid, tids[i]);
+}
+
+void PROCHelper::release_thread_states(pid_t pid, const std::vector<pid_t>& tids)
+{
+  for (pid_t tid : tids)
   {
-    LOG_ERROR("要求有 9 个 字段, 但实际有 {} 个.", tokens.size());
-    return false;
+    auto fd_it = m_proc_fds.find({pid, tid, ProcFileType::STAT});
+    if (fd_it == m_proc_fds.end()) continue;
+    close(fd_it->second);
+    m_proc_fds.erase(fd_it);
   }
+}
+
+PROCHelper::~PROCHelper()
+{
+  for (const auto& [key, fd] : m_proc_fds)
+    close(fd);
+}
 
-  item.user = tokens[0];
-  item.pid = std::stoi(tokens[1]);
-  item.ppid = std::stoi(tokens[2]);
-  item.vsz = std::stoull(tokens[3]);
-  item.rss = std::stoull(tokens[4]);
-  item.wchan = tokens[5];
-  item.addr = tokens[6];
-  item.state = PROCHelper::get_instance().char_to_process_state(tokens[7][0]);
-  for (size_t i = 8; i < tokens.size(); ++i)
+int PROCHelper::cached_fd(pid_t pid, pid_t tid, ProcFileType type)
+{
+  auto fd_it = m_proc_fds.find({pid, tid, type});
+  if (fd_it != m_proc_fds.end()) return fd_it->second;
+
+  std::string path = tid == 0 ?
+    fmt::format("/proc/{}/{}", pid, proc_file_type_to_string(type)) :
+    fmt::format("/proc/{}/task/{}/{}", pid, tid, proc_file_type_to_string(type));
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
   {
-    if (i > 8) item.name += " ";
-    item.name += tokens[i];
+    LOG_DEBUG("打开 {} 失败: {}", path, strerror(errno));
+    return -1;
   }
-  
-  return true;
+
+  m_proc_fds.emplace(std::make_tuple(pid, tid, type), fd);
+  return fd;
 }
 
-std::vector<PSHelper::PSItem> PSHelper::get_items()
+ssize_t PROCHelper::pread_proc_file(pid_t pid, pid_t tid, ProcFileType type, void* buffer, size_t size, off_t offset)
 {
-  std::vector<PSItem> result;
+  for (int attempt = 0; attempt < 2; ++attempt)
+  {
+    int fd = cached_fd(pid, tid, type);
+    if (fd == -1) return -1;
+
+    ssize_t nread = pread(fd, buffer, size, offset);
 
-  const char* ps_cmd = "ps -eo user,pid,ppid,vsz,rss,wchan,addr,s,args";
-  FILE* pipe = popen(ps_cmd, "r");
-  if (!pipe) return result;
+    // maps 和 mem 绑定打开时的地址空间, exec 之后旧描述符读到 0 字节而不是 ESRCH, 按失效处理
+    bool stale_mm = nread == 0 && size > 0 &&
+      ((type == ProcFileType::MAPS && offset == 0) || type == ProcFileType::MEM);
+    if (nread >= 0 && !stale_mm) return nread;
+    if (nread == -1 && errno == EINTR)
+    {
+      --attempt;
+      continue;
+    }
+    if (nread == -1 && errno != ESRCH) return -1;
+
+    // 描述符属于已经退出的进程或线程(pid 可能已被复用)或旧的地址空间, 重新打开一次
+    close(fd);
+    m_proc_fds.erase({pid, tid, type});
+  }
+  return -1;
+}
 
-  char buffer[2048];
-  bool is_first_line = true;
-  while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+bool PROCHelper::read_proc_file(pid_t pid, ProcFileType type, std::vector<char>& data)
+{
+  // /proc 文件没有大小, 按块读到文件末尾
+  constexpr size_t CHUNK_SIZE = 16384;
+  size_t total = 0;
+  while (true)
   {
-    std::string line(buffer);
-    line.erase(std::remove(line.begin(), line.end(), '\n'), line.end());
-    line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+    if (data.size() < total + CHUNK_SIZE)
+      data.resize(total + CHUNK_SIZE);
+
+    ssize_t nread = pread_proc_file(pid, 0, type, data.data() + total, CHUNK_SIZE, static_cast<off_t>(total));
+    if (nread < 0)
+    {
+      data.clear();
+      return false;
+    }
+    if (nread == 0) break;
+    total += static_cast<size_t>(nread);
+  }
+
+  data.resize(total);
+  return true;
+}
 
-    if (is_first_line)
+void PROCHelper::release_proc_fds(pid_t pid)
+{
+  for (auto fd_it = m_proc_fds.begin(); fd_it != m_proc_fds.end();)
+  {
+    if (std::get<0>(fd_it->first) != pid)
     {
-      is_first_line = false;
+      ++fd_it;
       continue;
     }
+    close(fd_it->second);
+    fd_it = m_proc_fds.erase(fd_it);
+  }
+}
+
+PSHelper::~PSHelper()
+{
+  if (m_proc_fd != -1) close(m_proc_fd);
+}
+
+bool PSHelper::read_file(const char* path)
+{
+  int fd = openat(m_proc_fd, path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+
+  // /proc 文件没有大小, 缓冲区不够时扩大后继续读
+  m_buffer_size = 0;
+  while (true)
+  {
+    if (m_buffer_size == m_buffer.size())
+      m_buffer.resize(m_buffer.size() * 2);
+
+    ssize_t nread = read(fd, m_buffer.data() + m_buffer_size, m_buffer.size() - m_buffer_size);
+    if (nread == -1 && errno == EINTR) continue;
+    if (nread <= 0) break;
+    m_buffer_size += static_cast<size_t>(nread);
+  }
+
+  close(fd);
+  return true;
+}
+
+const std::string& PSHelper::user_name(uid_t uid)
+{
+  auto it = m_user_names.find(uid);
+  if (it != m_user_names.end()) return it->second;
+
+  // Android 的 getpwuid 按 AID 表和应用 uid 规则生成 u0_a123 这样的名字
+  passwd* pw = getpwuid(uid);
+  return m_user_names[uid] = pw ? pw->pw_name : std::to_string(uid);
+}
+
+bool PSHelper::update_entry(pid_t pid)
+{
+  char path[32];
+
+  // 进程所属用户取 /proc/[pid] 目录的属主, zygote fork 出的进程 setuid 后会变化, 每次都取
+  snprintf(path, sizeof(path), "%d", pid);
+  struct stat st;
+  if (fstatat(m_proc_fd, path, &st, 0) == -1) return false;
+
+  snprintf(path, sizeof(path), "%d/stat", pid);
+  if (!read_file(path) || m_buffer_size == 0) return false;
+
+  // pid (comm) state ppid ..., comm 可能包含空格和括号, 取最后一个 ')'
+  std::string_view stat(m_buffer.data(), m_buffer_size);
+  size_t comm_begin = stat.find('(');
+  size_t comm_end = stat.rfind(')');
+  if (comm_begin == std::string_view::npos || comm_end == std::string_view::npos || comm_end + 2 >= stat.size())
+    return false;
+  std::string_view comm = stat.substr(comm_begin + 1, comm_end - comm_begin - 1);
+
+  // 从第 3 个字段 state 开始按空格切分, fields[i] 是第 i + 3 个字段
+  std::vector<std::string_view>& fields = m_fields;
+  fields.clear();
+  std::string_view rest = stat.substr(comm_end + 2);
+  while (!rest.empty())
+  {
+    size_t space = rest.find(' ');
+    fields.push_back(rest.substr(0, space));
+    if (space == std::string_view::npos) break;
+    rest.remove_prefix(space + 1);
+  }
+  if (fields.size() < STAT_WCHAN - 2) return false;
+
+  auto field = [&fields](size_t index) {
+    uint64_t value = 0;
+    std::string_view text = fields[index - 3];
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+  };
+
+  uint64_t start_time = field(STAT_STARTTIME);
+  CacheEntry& entry = m_cache[pid];
+  bool need_cmdline = entry.item.pid != pid || entry.start_time != start_time || entry.comm != comm;
+
+  PSItem& item = entry.item;
+  item.user = user_name(st.st_uid);
+  item.pid = pid;
+  item.ppid = static_cast<pid_t>(field(STAT_PPID));
+  item.vsz = field(STAT_VSIZE) / 1024;
+  item.rss = field(STAT_RSS) * (static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) / 1024);
+  item.wchan = std::string(fields[STAT_WCHAN - 3]);
+  item.addr = fmt::format("{:x}", field(STAT_KSTKEIP));
+  item.state = PROCHelper::get_instance().char_to_process_state(fields[0].empty() ? '?' : fields[0][0]);
+  entry.start_time = start_time;
+  entry.seen = true;
+
+  // app 进程改名时会同时改 comm, comm 和启动时间都没变时沿用之前的 cmdline
+  if (!need_cmdline) return true;
+  entry.comm = std::string(comm);
+
+  // 参数以 '\0' 分隔, 替换为空格, 内核线程没有 cmdline, 和 ps 一样显示 [comm]
+  snprintf(path, sizeof(path), "%d/cmdline", pid);
+  item.name.clear();
+  if (read_file(path))
+  {
+    size_t size = m_buffer_size;
+    while (size > 0 && m_buffer[size - 1] == '\0') --size;
+    item.name.assign(m_buffer.data(), size);
+    std::replace(item.name.begin(), item.name.end(), '\0', ' ');
+  }
+  if (item.name.empty())
+    item.name = "[" + entry.comm + "]";
+
+  return true;
+}
 
-    PSItem item;
-    if (parse_single_line(line, item))
+void PSHelper::refresh()
+{
+  if (m_proc_fd == -1)
+  {
+    m_proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (m_proc_fd == -1)
     {
-      result.push_back(item);
+      LOG_ERROR("打开 /proc 目录失败: {}", strerror(errno));
+      return;
     }
   }
 
-  pclose(pipe);
+  for (auto& [pid, entry] : m_cache)
+    entry.seen = false;
+
+  lseek(m_proc_fd, 0, SEEK_SET);
+  if (!for_each_numeric_entry(m_proc_fd, [this](pid_t pid) {
+    // 读取期间退出的进程直接跳过
+    if (!update_entry(pid)) m_cache.erase(pid);
+  }))
+    LOG_ERROR("读取 /proc 目录失败: {}", strerror(errno));
+
+  // 移除已经退出的进程
+  for (auto it = m_cache.begin(); it != m_cache.end();)
+  {
+    if (it->second.seen) ++it;
+    else it = m_cache.erase(it);
+  }
+}
+
+std::vector<PSHelper::PSItem> PSHelper::get_items()
+{
+  refresh();
+
+  std::vector<PSItem> result;
+  result.reserve(m_cache.size());
+  for (const auto& [pid, entry] : m_cache)
+    result.push_back(entry.item);
+
+  std::sort(result.begin(), result.end(), [](const PSItem& a, const PSItem& b) { return a.pid < b.pid; });
   return result;
 }
 
 std::vector<pid_t> PSHelper::find_pid_by_process_name(std::string name, MatchMode mode, bool is_sensitivity)
 {
   std::vector<pid_t> result;
-  auto all_items = get_items();
-  if (all_items.empty()) return result;
+  refresh();
+  if (m_cache.empty()) return result;
 
   if (!is_sensitivity)
     name = Utils::to_lower(std::move(name)); 
 
-  for (const auto& item : all_items)
+  for (const auto& [pid, entry] : m_cache)
   {
+    const PSItem& item = entry.item;
     std::string ps_name = item.name;
 
     if (!is_sensitivity)
@@ -430,15 +715,19 @@ std::vector<pid_t> PSHelper::find_pid_by_process_name(std::string name, MatchMod
 
 std::optional<std::string> PSHelper::find_process_name_by_pid(pid_t pid)
 {
-  auto all_items = get_items();
-  if (all_items.empty()) return std::nullopt;
-
-  for (const auto& item : all_items)
+  // 只更新这一个进程
+  if (m_proc_fd == -1)
   {
-    if (item.pid == pid) return item.name;
+    refresh();
+    if (m_proc_fd == -1) return std::nullopt;
   }
 
-  return std::nullopt;
+  if (!update_entry(pid))
+  {
+    m_cache.erase(pid);
+    return std::nullopt;
+  }
+  return m_cache[pid].item.name;
 }
 
 }
\ No newline at end of file
@@ -3,9 +3,12 @@
 #include "utils.hpp"
 #include <dirent.h>
 #include <fstream>
+#include <map>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <sys/types.h>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include "file.hpp"
@@ -93,26 +96,67 @@ public:
   // 回去进程所有 pid
   std::vector<pid_t> get_thread_ids(pid_t pid);
 
-  // 用 uid 配合 /data/system/packages.list 重写
-  // 通过包名查找 pid
+  // 通过包名查找 pid, 进程名等于包名的排在前面, 之后是 包名:xxx 的子进程
+  // 先从 packages.list 查到应用 uid, 只读取属于该 uid 的进程的 cmdline; 查不到 uid 时扫描所有进程
   std::vector<pid_t> find_pid_by_package_name(const std::string& package_name);
 
+  // packages.list 路径, 在 Linux 上测试时可以指向本地文件
+  void set_packages_list_path(const std::string& path);
+
+  // 包名对应的应用 uid (不含用户号), 文件修改时间变化时重新解析
+  std::optional<uid_t> find_app_uid(const std::string& package_name);
+
   // 通过 pid 查找包名
   std::optional<std::string> find_package_name_by_pid(pid_t pid);
 
   // 解析 /proc/[pid]/status, 简单的用 ':' 分割, 然后去掉前后空格, 存入 unordered_map 返回
   std::unordered_map<std::string, std::string> parse_status(pid_t pid);
 
-  // 解析 /proc/[pid]/status 的 state 字段
+  // 进程(主线程)状态, 读取 /proc/[pid]/task/[pid]/stat
   char get_process_state_char(pid_t pid);
   ProcessState get_process_state(pid_t pid);
+
+  // 线程状态, 对缓存的 /proc/[pid]/task/[tid]/stat 做一次 pread, 不分配内存, 读取失败返回 '?'
+  char get_thread_state_char(pid_t pid, pid_t tid);
+  ProcessState get_thread_state(pid_t pid, pid_t tid);
+
+  // 批量读取, states 与 tids 一一对应
+  void get_thread_states(pid_t pid, const std::vector<pid_t>& tids, std::vector<ProcessState>& states);
+
+  // 关闭线程的 stat 文件描述符, 线程退出或分离后调用
+  void release_thread_states(pid_t pid, const std::vector<pid_t>& tids);
+
+  // 常读的 /proc 文件(maps, mem, stat, task/[tid]/stat)打开一次后保留描述符, 之后用 pread 读取
+  // tid 为 0 时是 /proc/[pid]/<type>, 否则是 /proc/[pid]/task/[tid]/<type>
+  // 描述符失效(ESRCH, 进程退出或 pid 被复用)时重新打开一次, 返回读取的字节数, 失败返回 -1
+  ssize_t pread_proc_file(pid_t pid, pid_t tid, ProcFileType type, void* buffer, size_t size, off_t offset);
+
+  // 读取整个文件到 data
+  bool read_proc_file(pid_t pid, ProcFileType type, std::vector<char>& data);
+
+  // 进程退出或分离后关闭它的所有缓存描述符
+  void release_proc_fds(pid_t pid);
   
 
 private:
   // 友元声明, 允许基类访问子类的私有构造函数
   friend class SingletonBase<PROCHelper>;
   PROCHelper() = default;
-  ~PROCHelper() = default;
+  ~PROCHelper();
+
+  // (pid, tid, 文件类型) -> 打开的描述符
+  std::map<std::tuple<pid_t, pid_t, ProcFileType>, int> m_proc_fds;
+
+  // 打开并缓存描述符, 失败返回 -1
+  int cached_fd(pid_t pid, pid_t tid, ProcFileType type);
+
+  // 多用户下 uid = 用户号 * AID_USER_OFFSET + 应用 uid
+  static constexpr uid_t AID_USER_OFFSET = 100000;
+
+  // 包名 -> 应用 uid, 来自 packages.list
+  std::string m_packages_list_path = "/data/system/packages.list";
+  std::unordered_map<std::string, uid_t> m_package_uids;
+  int64_t m_packages_list_mtime_ns = -1;
 
 };
 
@@ -138,9 +182,12 @@ public:
     EXACT,          // 严格匹配
   };
 
-  // 获取所有 ps 中的信息
+  // 获取所有 ps 中的信息, 按 pid 排序
   std::vector<PSItem> get_items();
 
+  // 重新扫描 /proc 更新进程表, 启动时间和 comm 都没变的进程不再读取 cmdline
+  void refresh();
+
   // 通过进程名查找 pid
   std::vector<pid_t> find_pid_by_process_name(std::string name, MatchMode mode, bool is_sensitivity);
 
@@ -151,10 +198,42 @@ private:
   // 友元声明, 允许基类访问子类的私有构造函数
   friend class SingletonBase<PSHelper>;
   PSHelper() = default;
-  ~PSHelper() = default;
+  ~PSHelper();
+
+  // /proc/[pid]/stat 中用到的字段序号, 从 1 开始, 见 proc(5)
+  static constexpr size_t STAT_PPID = 4;
+  static constexpr size_t STAT_STARTTIME = 22;
+  static constexpr size_t STAT_VSIZE = 23;
+  static constexpr size_t STAT_RSS = 24;
+  static constexpr size_t STAT_KSTKEIP = 30;
+  static constexpr size_t STAT_WCHAN = 35;
+
+  // 进程表项, 启动时间用来识别 pid 复用
+  struct CacheEntry
+  {
+    PSItem item;
+    uint64_t start_time = 0;
+    std::string comm;
+    bool seen = false;        // 本次扫描中存在
+  };
+
+  std::unordered_map<pid_t, CacheEntry> m_cache;
+  std::unordered_map<uid_t, std::string> m_user_names;
+  int m_proc_fd = -1;
+
+  // 读取 /proc 文件的缓冲区, 所有文件复用
+  std::vector<char> m_buffer = std::vector<char>(4096);
+  size_t m_buffer_size = 0;
+  std::vector<std::string_view> m_fields;
+
+  // 读取 /proc 下的相对路径到 m_buffer
+  bool read_file(const char* path);
+
+  // 读取 /proc/[pid]/stat 和 cmdline 更新进程表项, 进程已退出时返回 false
+  bool update_entry(pid_t pid);
 
-  // 解析单一行
-  bool parse_single_line(std::string line, PSItem& item);
+  // uid 对应的用户名
+  const std::string& user_name(uid_t uid);
 };
 
 
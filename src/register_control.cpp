@@ -178,6 +178,35 @@ bool RegisterControl::set_all_dbg(pid_t tid, const user_hwdebug_state& dbg)
   return ptrace_set_regset(tid, &dbg, sizeof(dbg), RegisterType::DBG);
 }
 
+std::optional<user_hwdebug_state> RegisterControl::get_all_watch(pid_t tid)
+{
+  user_hwdebug_state watch;
+  if (ptrace_get_regset(tid, &watch, sizeof(watch), RegisterType::WATCH)) 
+  {
+      return watch;
+  }
+  return std::nullopt;
+}
+
+bool RegisterControl::set_all_watch(pid_t tid, const user_hwdebug_state& watch)
+{
+  return ptrace_set_regset(tid, &watch, sizeof(watch), RegisterType::WATCH);
+}
+
+uint64_t RegisterControl::get_pac_insn_mask(pid_t tid)
+{
+  // 与内核 user_pac_mask 布局一致
+  struct
+  {
+    uint64_t data_mask;
+    uint64_t insn_mask;
+  } pac_mask = {};
+
+  if (ptrace_get_regset(tid, &pac_mask, sizeof(pac_mask), RegisterType::PAC))
+    return pac_mask.insn_mask;
+  return 0;
+}
+
 std::optional<uint64_t> RegisterControl::get_gpr(pid_t tid, GPRegister reg)
 {
   auto gpr_opt = get_all_gpr(tid);
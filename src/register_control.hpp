@@ -65,6 +65,7 @@ public:
     GPR = NT_PRSTATUS,
     FPR = NT_FPREGSET,
     DBG = NT_ARM_HW_BREAK,
+    WATCH = NT_ARM_HW_WATCH,
     SVE = NT_ARM_SVE,
     PAC = NT_ARM_PAC_MASK,
   };
@@ -125,6 +126,15 @@ public:
   // 设置所有调试寄存器
   bool set_all_dbg(pid_t tid, const struct user_hwdebug_state& dbg);
 
+  // 获取所有观察点寄存器, 与调试寄存器结构相同, dbg_info 低 8 位是可用数量
+  std::optional<struct user_hwdebug_state> get_all_watch(pid_t tid);
+
+  // 设置所有观察点寄存器
+  bool set_all_watch(pid_t tid, const struct user_hwdebug_state& watch);
+
+  // 获取指令地址的 PAC 位掩码, 清除这些位即可得到真实地址, 不支持 PAC 时返回 0
+  uint64_t get_pac_insn_mask(pid_t tid);
+
   // 获取单个通用寄存器值
   std::optional<GPRValue> get_gpr(pid_t tid, GPRegister reg);
 
@@ -0,0 +1,201 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "relocator.hpp"
+#include "assembly.hpp"
+#include "log.hpp"
+
+
+namespace Assembly
+{
+
+std::vector<char> Arm64Writer::bytes() const
+{
+  std::vector<char> result(m_codes.size() * 4);
+  if (!m_codes.empty())
+    memcpy(result.data(), m_codes.data(), result.size());
+  return result;
+}
+
+void Arm64Writer::emit_u64(uint64_t value)
+{
+  emit(static_cast<uint32_t>(value & 0xFFFFFFFF));
+  emit(static_cast<uint32_t>(value >> 32));
+}
+
+void Arm64Writer::ldr_literal(uint32_t rt, int64_t offset)
+{
+  emit(0x58000000 | ((static_cast<uint32_t>(offset >> 2) & 0x7FFFF) << 5) | rt);
+}
+
+void Arm64Writer::mov_u64(uint32_t rt, uint64_t value)
+{
+  ldr_literal(rt, 8);
+  b(12);
+  emit_u64(value);
+}
+
+void Arm64Writer::absolute_jump(uint64_t target)
+{
+  ldr_literal(IP1, 8);
+  br(IP1);
+  emit_u64(target);
+}
+
+void Arm64Writer::absolute_call(uint64_t target, uint64_t return_address)
+{
+  ldr_literal(LR, 16);
+  ldr_literal(IP1, 20);
+  br(IP1);
+  nop();
+  emit_u64(return_address);
+  emit_u64(target);
+}
+
+bool Arm64Writer::is_b_reachable(uint64_t from, uint64_t to)
+{
+  int64_t offset = static_cast<int64_t>(to - from);
+  return (offset & 0x3) == 0 && offset >= -(1LL << 27) && offset < (1LL << 27);
+}
+
+int64_t Relocator::sign_extend(uint64_t value, int bits)
+{
+  uint64_t sign = 1ULL << (bits - 1);
+  value &= (1ULL << bits) - 1;
+  return static_cast<int64_t>((value ^ sign) - sign);
+}
+
+bool Relocator::relocate(uint64_t from, uint32_t instruction, Arm64Writer& writer, bool* clobbers_ip1)
+{
+  if (clobbers_ip1) *clobbers_ip1 = false;
+
+  // 先用 capstone 确认是合法指令
+  std::vector<char> codes(4);
+  memcpy(codes.data(), &instruction, 4);
+  auto insns_opt = DisassemblyControl::get_instance().disassemble(codes, from);
+  if (!insns_opt || insns_opt->empty() || insns_opt->front().type == Instruction::Type::UNKNOWN)
+  {
+    LOG_ERROR("重定位失败, 无法识别 0x{:x} 处的指令 0x{:08x}", from, instruction);
+    return false;
+  }
+  LOG_DEBUG("重定位 0x{:x}: {} -> 0x{:x}", from, insns_opt->front().to_string(), writer.pc());
+
+  // b / bl
+  if ((instruction & 0x7C000000) == 0x14000000)
+  {
+    bool is_link = (instruction & 0x80000000) != 0;
+    uint64_t target = from + sign_extend(instruction, 26) * 4;
+    if (Arm64Writer::is_b_reachable(writer.pc(), target))
+    {
+      writer.emit((instruction & 0xFC000000) | (Arm64Writer::encode_b(target - writer.pc()) & 0x3FFFFFF));
+      return true;
+    }
+
+    if (is_link)
+      writer.absolute_call(target, from + 4);
+    else
+      writer.absolute_jump(target);
+    if (clobbers_ip1) *clobbers_ip1 = true;
+    return true;
+  }
+
+  // b.cond, cbz/cbnz, tbz/tbnz: 条件成立跳到 +8 的跳转, 否则跳过它
+  // 目标在 b 的范围内时用 b, 否则用破坏 x17 的绝对跳转
+  bool is_b_cond = (instruction & 0xFF000010) == 0x54000000;
+  bool is_cb = (instruction & 0x7E000000) == 0x34000000;
+  bool is_tb = (instruction & 0x7E000000) == 0x36000000;
+  if (is_b_cond || is_cb || is_tb)
+  {
+    uint64_t target;
+    uint32_t rewritten;
+    if (is_tb)
+    {
+      target = from + sign_extend(instruction >> 5, 14) * 4;
+      rewritten = (instruction & 0xFFF8001F) | (2 << 5);
+    }
+    else
+    {
+      target = from + sign_extend(instruction >> 5, 19) * 4;
+      rewritten = (instruction & 0xFF00001F) | (2 << 5);
+    }
+
+    writer.emit(rewritten);
+    uint64_t jump_pc = writer.pc() + 4;
+    if (Arm64Writer::is_b_reachable(jump_pc, target))
+    {
+      writer.b(8);
+      writer.b(static_cast<int64_t>(target - jump_pc));
+      return true;
+    }
+
+    writer.b(4 + 16);
+    writer.absolute_jump(target);
+    if (clobbers_ip1) *clobbers_ip1 = true;
+    return true;
+  }
+
+  // adr / adrp
+  if ((instruction & 0x1F000000) == 0x10000000)
+  {
+    uint32_t rd = instruction & 0x1F;
+    int64_t imm = sign_extend((((instruction >> 5) & 0x7FFFF) << 2) | ((instruction >> 29) & 0x3), 21);
+    uint64_t value;
+    if (instruction & 0x80000000)
+      value = (from & ~0xFFFULL) + (static_cast<uint64_t>(imm) << 12);
+    else
+      value = from + imm;
+
+    writer.mov_u64(rd, value);
+    return true;
+  }
+
+  // ldr literal(通用寄存器和 SIMD 寄存器)
+  if ((instruction & 0x3B000000) == 0x18000000)
+  {
+    uint32_t rt = instruction & 0x1F;
+    uint32_t opc = instruction >> 30;
+    bool is_simd = (instruction & (1 << 26)) != 0;
+    uint64_t address = from + sign_extend(instruction >> 5, 19) * 4;
+
+    // prfm 直接丢弃
+    if (!is_simd && opc == 3)
+    {
+      writer.nop();
+      return true;
+    }
+
+    // 先把地址放进 x17, 再用 [x17] 形式读取
+    writer.mov_u64(Arm64Writer::IP1, address);
+    if (clobbers_ip1) *clobbers_ip1 = is_simd || rt != Arm64Writer::IP1;
+    uint32_t base = Arm64Writer::IP1 << 5;
+    if (!is_simd)
+    {
+      switch (opc)
+      {
+        case 0: writer.emit(0xB9400000 | base | rt); break;   // ldr wt, [x17]
+        case 1: writer.emit(0xF9400000 | base | rt); break;   // ldr xt, [x17]
+        case 2: writer.emit(0xB9800000 | base | rt); break;   // ldrsw xt, [x17]
+      }
+    }
+    else
+    {
+      switch (opc)
+      {
+        case 0: writer.emit(0xBD400000 | base | rt); break;   // ldr st, [x17]
+        case 1: writer.emit(0xFD400000 | base | rt); break;   // ldr dt, [x17]
+        case 2: writer.emit(0x3DC00000 | base | rt); break;   // ldr qt, [x17]
+        default:
+          LOG_ERROR("不支持的 ldr literal 编码 0x{:08x}", instruction);
+          return false;
+      }
+    }
+    return true;
+  }
+
+  // 与 pc 无关的指令原样复制
+  writer.emit(instruction);
+  return true;
+}
+
+}
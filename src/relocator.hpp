@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Assembly
+{
+
+// ARM64 机器码生成器, 只实现蹦床和重定位需要用到的少量编码
+// 寄存器参数直接使用编号, 31 在不同指令中表示 sp 或 xzr
+class Arm64Writer
+{
+private:
+  uint64_t m_base;                  // 生成代码的起始地址
+  std::vector<uint32_t> m_codes;    // 已生成的指令
+
+public:
+  // x16, x17 是过程内调用临时寄存器(IP0, IP1), 蹦床和重定位代码用它们做跳板
+  static constexpr uint32_t IP0 = 16;
+  static constexpr uint32_t IP1 = 17;
+  static constexpr uint32_t LR = 30;
+  static constexpr uint32_t SP = 31;
+  static constexpr uint32_t XZR = 31;
+
+  explicit Arm64Writer(uint64_t base) : m_base(base) {}
+
+  // 当前写入位置的地址
+  uint64_t pc() const { return m_base + m_codes.size() * 4; }
+
+  // 已生成的字节数
+  size_t size() const { return m_codes.size() * 4; }
+
+  // 当前写入位置的下标, 配合 patch 回填跳转偏移
+  size_t index() const { return m_codes.size(); }
+
+  // 输出字节
+  std::vector<char> bytes() const;
+
+  // 原样写入一条指令或一个 64 位常量(占两个字)
+  void emit(uint32_t code) { m_codes.push_back(code); }
+  void emit_u64(uint64_t value);
+
+  // 回填 index 处的指令
+  void patch(size_t index, uint32_t code) { m_codes[index] = code; }
+
+  // ldr xt, #offset 读取字面量, offset 相对于本条指令
+  void ldr_literal(uint32_t rt, int64_t offset);
+
+  // 把 64 位常量加载到 xt: ldr xt, #8; b #12; .quad value
+  void mov_u64(uint32_t rt, uint64_t value);
+
+  // 跳到绝对地址, 会破坏 x17: ldr x17, #8; br x17; .quad target
+  void absolute_jump(uint64_t target);
+
+  // 调用绝对地址, lr 指定为 return_address, 会破坏 x17
+  void absolute_call(uint64_t target, uint64_t return_address);
+
+  void br(uint32_t rn) { emit(0xD61F0000 | (rn << 5)); }
+  void b(int64_t offset) { emit(encode_b(offset)); }
+  void nop() { emit(0xD503201F); }
+
+  // add/sub xd, xn, #imm12
+  void add_imm(uint32_t rd, uint32_t rn, uint32_t imm12) { emit(0x91000000 | ((imm12 & 0xFFF) << 10) | (rn << 5) | rd); }
+  void sub_imm(uint32_t rd, uint32_t rn, uint32_t imm12) { emit(0xD1000000 | ((imm12 & 0xFFF) << 10) | (rn << 5) | rd); }
+
+  // 寄存器运算
+  void sub_reg(uint32_t rd, uint32_t rn, uint32_t rm) { emit(0xCB000000 | (rm << 16) | (rn << 5) | rd); }
+  void and_reg(uint32_t rd, uint32_t rn, uint32_t rm) { emit(0x8A000000 | (rm << 16) | (rn << 5) | rd); }
+  void cmp_reg(uint32_t rn, uint32_t rm) { emit(0xEB000000 | (rm << 16) | (rn << 5) | XZR); }
+  // rd = ra + rn * rm
+  void madd(uint32_t rd, uint32_t rn, uint32_t rm, uint32_t ra) { emit(0x9B000000 | (rm << 16) | (ra << 10) | (rn << 5) | rd); }
+  void movz(uint32_t rd, uint16_t imm16) { emit(0xD2800000 | (static_cast<uint32_t>(imm16) << 5) | rd); }
+
+  // 访存, offset 以字节为单位, 必须 8 字节对齐
+  void ldr(uint32_t rt, uint32_t rn, uint32_t offset) { emit(0xF9400000 | ((offset / 8) << 10) | (rn << 5) | rt); }
+  void str(uint32_t rt, uint32_t rn, uint32_t offset) { emit(0xF9000000 | ((offset / 8) << 10) | (rn << 5) | rt); }
+  void ldp(uint32_t rt, uint32_t rt2, uint32_t rn, int32_t offset) { emit(0xA9400000 | ((static_cast<uint32_t>(offset / 8) & 0x7F) << 15) | (rt2 << 10) | (rn << 5) | rt); }
+  void stp(uint32_t rt, uint32_t rt2, uint32_t rn, int32_t offset) { emit(0xA9000000 | ((static_cast<uint32_t>(offset / 8) & 0x7F) << 15) | (rt2 << 10) | (rn << 5) | rt); }
+  // 后变址 ldr xt, [xn], #imm9 / str xt, [xn], #imm9
+  void ldr_post(uint32_t rt, uint32_t rn, int32_t imm9) { emit(0xF8400400 | ((static_cast<uint32_t>(imm9) & 0x1FF) << 12) | (rn << 5) | rt); }
+  void str_post(uint32_t rt, uint32_t rn, int32_t imm9) { emit(0xF8000400 | ((static_cast<uint32_t>(imm9) & 0x1FF) << 12) | (rn << 5) | rt); }
+
+  // 独占访存
+  void ldaxr(uint32_t rt, uint32_t rn) { emit(0xC85FFC00 | (rn << 5) | rt); }
+  void stlxr(uint32_t rs, uint32_t rt, uint32_t rn) { emit(0xC800FC00 | (rs << 16) | (rn << 5) | rt); }
+  void stlr(uint32_t rt, uint32_t rn) { emit(0xC89FFC00 | (rn << 5) | rt); }
+  void clrex() { emit(0xD503305F); }
+
+  // 系统寄存器
+  void mrs_nzcv(uint32_t rt) { emit(0xD53B4200 | rt); }
+  void msr_nzcv(uint32_t rt) { emit(0xD51B4200 | rt); }
+  void mrs_tpidr_el0(uint32_t rt) { emit(0xD53BD040 | rt); }
+
+  // 编码, 供回填使用, offset 相对于跳转指令本身
+  static uint32_t encode_b(int64_t offset) { return 0x14000000 | (static_cast<uint32_t>(offset >> 2) & 0x3FFFFFF); }
+  static uint32_t encode_b_cond(uint32_t cond, int64_t offset) { return 0x54000000 | ((static_cast<uint32_t>(offset >> 2) & 0x7FFFF) << 5) | (cond & 0xF); }
+  static uint32_t encode_cbnz_w(uint32_t rt, int64_t offset) { return 0x35000000 | ((static_cast<uint32_t>(offset >> 2) & 0x7FFFF) << 5) | rt; }
+
+  // B 指令能否从 from 跳到 to (±128MB)
+  static bool is_b_reachable(uint64_t from, uint64_t to);
+};
+
+// ARM64 指令重定位, 把一条指令从原地址搬到新地址后保持语义不变
+// 与 pc 相关的指令(b, bl, b.cond, cbz, tbz, adr, adrp, ldr literal) 会被改写
+// 跳转目标在 b 的范围内时仍用 b, 超出范围的跳转和 ldr literal 改写成绝对地址形式, 会破坏 x17
+class Relocator
+{
+public:
+  // 重定位结束后还需要由调用方写入跳回 from + 4 的代码, 改写后的代码破坏 x17 时 clobbers_ip1 置为 true
+  static bool relocate(uint64_t from, uint32_t instruction, Arm64Writer& writer, bool* clobbers_ip1 = nullptr);
+
+private:
+  // 位域提取, 有符号扩展
+  static int64_t sign_extend(uint64_t value, int bits);
+};
+
+}
@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <optional>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <vector>
+
+#include "remote_control.hpp"
+#include "memory_control.hpp"
+#include "register_control.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+// 老版本头文件中没有, 内核 4.17 引入, 不支持的内核会把它当作普通的地址提示
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+
+namespace Core
+{
+
+std::optional<uint64_t> RemoteControl::run_syscall(pid_t tid, uint64_t stub, long number, const std::vector<uint64_t>& args)
+{
+  auto& register_control = RegisterControl::get_instance();
+
+  if (args.size() > 6)
+  {
+    LOG_ERROR("系统调用参数最多 6 个, 实际 {} 个", args.size());
+    return std::nullopt;
+  }
+
+  auto saved_opt = register_control.get_all_gpr(tid);
+  if (!saved_opt)
+  {
+    LOG_ERROR("注入系统调用失败, 读取线程 {} 寄存器失败", tid);
+    return std::nullopt;
+  }
+  const user_pt_regs saved = saved_opt.value();
+
+  // x8 放调用号, x0 ~ x5 放参数, pc 指向 svc; brk
+  user_pt_regs regs = saved;
+  regs.regs[8] = static_cast<uint64_t>(number);
+  for (size_t i = 0; i < args.size(); ++i)
+    regs.regs[i] = args[i];
+  regs.pc = stub;
+
+  if (!register_control.set_all_gpr(tid, regs))
+  {
+    LOG_ERROR("注入系统调用失败, 设置线程 {} 寄存器失败", tid);
+    return std::nullopt;
+  }
+
+  // 运行到 brk, 期间收到的其他信号原样转交给目标, SIGSTOP 直接吞掉
+  int signal = 0;
+  bool trapped = false;
+  while (!trapped)
+  {
+    if (!Utils::ptrace_wrapper(PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(signal))))
+      break;
+
+    int status = 0;
+    if (Utils::waitpid_wrapper(tid, &status, __WALL) != tid)
+      break;
+
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+      LOG_ERROR("注入系统调用期间线程 {} 退出", tid);
+      return std::nullopt;
+    }
+
+    if (!WIFSTOPPED(status)) continue;
+
+    signal = WSTOPSIG(status);
+    if (signal == SIGTRAP)
+      trapped = true;
+    else if (signal == SIGSTOP)
+      signal = 0;
+  }
+
+  std::optional<uint64_t> result = std::nullopt;
+  auto result_opt = register_control.get_all_gpr(tid);
+  if (trapped && result_opt && result_opt->pc == stub + 4)
+    result = result_opt->regs[0];
+  else
+    LOG_ERROR("注入系统调用 {} 没有停在预期位置", number);
+
+  // 不论结果如何都要恢复现场
+  if (!register_control.set_all_gpr(tid, saved))
+    LOG_ERROR("恢复线程 {} 寄存器失败, 目标进程状态可能被破坏", tid);
+
+  return result;
+}
+
+std::optional<uint64_t> RemoteControl::ensure_syscall_stub(pid_t pid, pid_t tid)
+{
+  auto stub_it = m_syscall_stubs_.find(pid);
+  if (stub_it != m_syscall_stubs_.end())
+    return stub_it->second;
+
+  auto& memory_control = MemoryControl::get_instance();
+  auto& register_control = RegisterControl::get_instance();
+
+  // 第一次调用时借用当前 pc 处的 8 个字节执行 mmap, 申请专用的存根页
+  auto pc_opt = register_control.get_gpr(tid, GPRegister::PC);
+  if (!pc_opt) return std::nullopt;
+  uint64_t pc = pc_opt.value();
+
+  uint64_t original = 0;
+  if (!memory_control.read_memory(pid, pc, &original, sizeof(original)))
+    return std::nullopt;
+
+  const uint32_t stub_codes[2] = {SVC_OPCODE, BRK_OPCODE};
+  if (!memory_control.write_code(pid, pc, stub_codes, sizeof(stub_codes)))
+    return std::nullopt;
+
+  uint64_t page_size = static_cast<uint64_t>(Utils::get_page_size());
+  auto result = run_syscall(tid, pc, SYS_mmap,
+    {0, page_size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, static_cast<uint64_t>(-1), 0});
+
+  if (!memory_control.write_code(pid, pc, &original, sizeof(original)))
+    LOG_ERROR("恢复 0x{:x} 处原指令失败, 目标进程可能被破坏", pc);
+
+  if (!result || is_error(result.value()))
+  {
+    LOG_ERROR("在进程 {} 中申请系统调用存根页失败", pid);
+    return std::nullopt;
+  }
+
+  uint64_t stub = result.value();
+  if (!memory_control.write_code(pid, stub, stub_codes, sizeof(stub_codes)))
+    return std::nullopt;
+
+  LOG_DEBUG("进程 {} 的系统调用存根位于 0x{:x}", pid, stub);
+  m_syscall_stubs_[pid] = stub;
+  return stub;
+}
+
+std::optional<uint64_t> RemoteControl::syscall(pid_t pid, pid_t tid, long number, const std::vector<uint64_t>& args)
+{
+  auto stub_opt = ensure_syscall_stub(pid, tid);
+  if (!stub_opt) return std::nullopt;
+
+  return run_syscall(tid, stub_opt.value(), number, args);
+}
+
+std::optional<uint64_t> RemoteControl::mmap(pid_t pid, pid_t tid, uint64_t hint, size_t size, int prot, int flags, int fd, uint64_t offset)
+{
+  auto result = syscall(pid, tid, SYS_mmap, {hint, size, static_cast<uint64_t>(prot),
+    static_cast<uint64_t>(flags), static_cast<uint64_t>(static_cast<int64_t>(fd)), offset});
+  if (!result || is_error(result.value()))
+  {
+    LOG_ERROR("远程 mmap 失败, hint: 0x{:x}, size: 0x{:x}", hint, size);
+    return std::nullopt;
+  }
+  return result;
+}
+
+bool RemoteControl::munmap(pid_t pid, pid_t tid, uint64_t address, size_t size)
+{
+  auto result = syscall(pid, tid, SYS_munmap, {address, size});
+  return result && !is_error(result.value());
+}
+
+std::optional<uint64_t> RemoteControl::write_scratch(pid_t pid, pid_t tid, const void* data, size_t size)
+{
+  auto stub_opt = ensure_syscall_stub(pid, tid);
+  if (!stub_opt) return std::nullopt;
+
+  if (size > static_cast<size_t>(Utils::get_page_size()) - SCRATCH_OFFSET)
+  {
+    LOG_ERROR("临时数据过大: {}", size);
+    return std::nullopt;
+  }
+
+  uint64_t address = stub_opt.value() + SCRATCH_OFFSET;
+  if (!MemoryControl::get_instance().write_code(pid, address, data, size))
+    return std::nullopt;
+
+  return address;
+}
+
+std::optional<uint64_t> RemoteControl::find_free_gap(pid_t pid, size_t size, uint64_t near, uint64_t range)
+{
+  auto regions = MemoryControl::get_instance().get_memory_regions(pid);
+  if (regions.empty()) return std::nullopt;
+
+  auto distance = [near](uint64_t address) {
+    return address > near ? address - near : near - address;
+  };
+
+  std::optional<uint64_t> best = std::nullopt;
+  uint64_t low = Utils::align_page_up(0x100000);
+  for (const auto& region : regions)
+  {
+    uint64_t high = region.start_address;
+    if (high > low && high - low >= size)
+    {
+      // 在空洞 [low, high) 中取离 near 最近的位置
+      uint64_t candidate;
+      if (near < low)
+        candidate = low;
+      else if (near > high - size)
+        candidate = Utils::align_page_down(high - size);
+      else
+        candidate = Utils::align_page_down(near);
+      candidate = std::max(candidate, low);
+
+      bool in_range = distance(candidate) < range && distance(candidate + size) < range;
+      if (in_range && (!best || distance(candidate) < distance(best.value())))
+        best = candidate;
+    }
+    low = std::max(low, Utils::align_page_up(region.end_address));
+  }
+
+  return best;
+}
+
+std::optional<uint64_t> RemoteControl::allocate(pid_t pid, pid_t tid, size_t size, uint64_t near, uint64_t range)
+{
+  if (size == 0) return std::nullopt;
+  size = Utils::align_up(size, 16);
+
+  auto in_range = [near, range](uint64_t address, size_t length) {
+    if (range == 0) return true;
+    uint64_t end = address + length;
+    uint64_t low = near > range ? near - range : 0;
+    return address > low && end < near + range;
+  };
+
+  // 先在已有块中首次适配
+  for (auto& chunk : m_chunks_[pid])
+  {
+    for (auto it = chunk.free_blocks.begin(); it != chunk.free_blocks.end(); ++it)
+    {
+      auto [address, block_size] = *it;
+      if (block_size < size || !in_range(address, size)) continue;
+
+      chunk.free_blocks.erase(it);
+      if (block_size > size)
+        chunk.free_blocks[address + size] = block_size - size;
+      chunk.used_blocks[address] = size;
+      return address;
+    }
+  }
+
+  // 没有合适的空闲块, 申请新块
+  size_t chunk_size = std::max(CHUNK_SIZE, static_cast<size_t>(Utils::align_page_up(size)));
+  uint64_t hint = 0;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (range != 0)
+  {
+    auto gap_opt = find_free_gap(pid, chunk_size, near, range);
+    if (!gap_opt)
+    {
+      LOG_ERROR("0x{:x} 附近 0x{:x} 范围内没有可用的地址空间", near, range);
+      return std::nullopt;
+    }
+    hint = gap_opt.value();
+    flags |= MAP_FIXED_NOREPLACE;
+  }
+
+  auto base_opt = mmap(pid, tid, hint, chunk_size, PROT_READ | PROT_EXEC, flags);
+  if (!base_opt) return std::nullopt;
+
+  uint64_t base = base_opt.value();
+  if (!in_range(base, chunk_size))
+  {
+    LOG_ERROR("申请到的内存 0x{:x} 不在 0x{:x} 附近", base, near);
+    munmap(pid, tid, base, chunk_size);
+    return std::nullopt;
+  }
+
+  Chunk chunk;
+  chunk.base = base;
+  chunk.size = chunk_size;
+  chunk.used_blocks[base] = size;
+  if (chunk_size > size)
+    chunk.free_blocks[base + size] = chunk_size - size;
+  m_chunks_[pid].push_back(std::move(chunk));
+
+  LOG_DEBUG("进程 {} 新增远程内存块 0x{:x}, 大小 0x{:x}", pid, base, chunk_size);
+  return base;
+}
+
+bool RemoteControl::free(pid_t pid, uint64_t address)
+{
+  auto chunks_it = m_chunks_.find(pid);
+  if (chunks_it == m_chunks_.end()) return false;
+
+  for (auto& chunk : chunks_it->second)
+  {
+    auto used_it = chunk.used_blocks.find(address);
+    if (used_it == chunk.used_blocks.end()) continue;
+
+    size_t size = used_it->second;
+    chunk.used_blocks.erase(used_it);
+
+    // 与后一个空闲块合并
+    auto next = chunk.free_blocks.find(address + size);
+    if (next != chunk.free_blocks.end())
+    {
+      size += next->second;
+      chunk.free_blocks.erase(next);
+    }
+
+    // 与前一个空闲块合并
+    auto prev = chunk.free_blocks.lower_bound(address);
+    if (prev != chunk.free_blocks.begin())
+    {
+      --prev;
+      if (prev->first + prev->second == address)
+      {
+        prev->second += size;
+        return true;
+      }
+    }
+
+    chunk.free_blocks[address] = size;
+    return true;
+  }
+
+  LOG_WARNING("进程 {} 中没有 0x{:x} 的分配记录", pid, address);
+  return false;
+}
+
+void RemoteControl::reset(pid_t pid)
+{
+  m_chunks_.erase(pid);
+  m_syscall_stubs_.erase(pid);
+}
+
+}
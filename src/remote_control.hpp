@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+#include "singleton_base.hpp"
+
+namespace Core
+{
+
+// 在目标进程中注入系统调用, 并在此基础上实现远程内存分配
+// 所有接口都要求 tid 处于 ptrace 暂停状态
+class RemoteControl : public SingletonBase<RemoteControl>
+{
+public:
+  // svc #0 与 brk #0
+  static constexpr uint32_t SVC_OPCODE = 0xD4000001;
+  static constexpr uint32_t BRK_OPCODE = 0xD4200000;
+
+  // 每次向目标申请的内存块大小, 之后在块内子分配
+  static constexpr size_t CHUNK_SIZE = 0x10000;
+
+  // 存根页中临时数据区的偏移, 用于给系统调用传字符串等参数
+  static constexpr uint64_t SCRATCH_OFFSET = 0x100;
+
+  // 系统调用返回值是否表示错误(-4095 ~ -1)
+  static bool is_error(uint64_t result) { return result > static_cast<uint64_t>(-4096); }
+
+  // 执行系统调用, 返回 x0 的原始值, 注入失败返回 std::nullopt
+  std::optional<uint64_t> syscall(pid_t pid, pid_t tid, long number, const std::vector<uint64_t>& args);
+
+  // 远程 mmap / munmap
+  std::optional<uint64_t> mmap(pid_t pid, pid_t tid, uint64_t hint, size_t size, int prot, int flags, int fd = -1, uint64_t offset = 0);
+  bool munmap(pid_t pid, pid_t tid, uint64_t address, size_t size);
+
+  // 把数据写入存根页的临时区, 返回其远程地址, 下一次调用会覆盖
+  std::optional<uint64_t> write_scratch(pid_t pid, pid_t tid, const void* data, size_t size);
+
+  // 申请可执行内存, range 不为 0 时保证整块落在 near ± range 内
+  std::optional<uint64_t> allocate(pid_t pid, pid_t tid, size_t size, uint64_t near = 0, uint64_t range = 0);
+
+  // 归还 allocate 申请的内存, 只回收到本地空闲表, 不会 munmap
+  bool free(pid_t pid, uint64_t address);
+
+  // 目标进程退出或分离后清理记录
+  void reset(pid_t pid);
+
+private:
+  // 友元声明, 允许基类访问子类的私有构造函数
+  friend class SingletonBase<RemoteControl>;
+  RemoteControl() = default;
+  ~RemoteControl() = default;
+
+  // 远程内存块
+  struct Chunk
+  {
+    uint64_t base;                                  // 起始地址
+    size_t size;                                    // 大小
+    std::map<uint64_t, size_t> free_blocks;         // 空闲块, 地址 -> 大小, 按地址排序方便合并
+    std::unordered_map<uint64_t, size_t> used_blocks;  // 已分配块
+  };
+
+  // 每个进程的内存块
+  std::unordered_map<pid_t, std::vector<Chunk>> m_chunks_;
+
+  // 每个进程的系统调用存根地址
+  std::unordered_map<pid_t, uint64_t> m_syscall_stubs_;
+
+  // 在 stub 处执行 svc; brk, 返回 x0
+  std::optional<uint64_t> run_syscall(pid_t tid, uint64_t stub, long number, const std::vector<uint64_t>& args);
+
+  // 确保存根页已经存在
+  std::optional<uint64_t> ensure_syscall_stub(pid_t pid, pid_t tid);
+
+  // 在 near ± range 内寻找可以容纳 size 的空洞
+  std::optional<uint64_t> find_free_gap(pid_t pid, size_t size, uint64_t near, uint64_t range);
+};
+
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+
+#include "session_manager.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+namespace Core
+{
+
+SessionManager::SessionManager() : m_current(-1), m_next_id(1)
+{
+  m_current = create_session();
+}
+
+int SessionManager::create_session()
+{
+  int session_id = m_next_id++;
+  auto session = std::make_unique<DebuggerCore>();
+
+  // 本会话的 waitpid(-1) 收到的其他会话的事件
+  session->set_event_router([this, session_id](pid_t wpid, int status) {
+    for (auto& [id, other] : m_sessions)
+    {
+      if (id == session_id || !other->owns_tid(wpid)) continue;
+      other->queue_event(wpid, status);
+      return true;
+    }
+    return false;
+  });
+
+  m_sessions.emplace(session_id, std::move(session));
+  LOG_DEBUG("新建会话 {}", session_id);
+  return session_id;
+}
+
+DebuggerCore& SessionManager::prepare_session()
+{
+  if (!current().is_attached())
+    return current();
+
+  m_current = create_session();
+  return current();
+}
+
+void SessionManager::close_current()
+{
+  if (m_sessions.size() <= 1) return;
+
+  LOG_DEBUG("关闭会话 {}", m_current);
+  m_sessions.erase(m_current);
+  m_current = m_sessions.begin()->first;
+}
+
+Base::Status SessionManager::select(int session_id)
+{
+  if (m_sessions.find(session_id) == m_sessions.end())
+    return Base::Status::fail("会话 {} 不存在", session_id);
+
+  m_current = session_id;
+  return Base::Status::success("切换到会话 {}", session_id);
+}
+
+std::map<int, pid_t> SessionManager::list()
+{
+  std::map<int, pid_t> sessions;
+  for (auto& [id, session] : m_sessions)
+  {
+    pid_t pid = -1;
+    if (session->is_attached())
+      session->get_pid(pid);
+    sessions[id] = pid;
+  }
+  return sessions;
+}
+
+Base::Status SessionManager::adopt_fork_child(pid_t pid, int& session_id)
+{
+  DebuggerCore& parent = current();
+  session_id = create_session();
+
+  Base::Status s = m_sessions.at(session_id)->adopt_fork_child(parent, pid);
+  if (s.is_fail())
+  {
+    m_sessions.erase(session_id);
+    session_id = -1;
+    return s;
+  }
+
+  m_current = session_id;
+  return s;
+}
+
+Base::Status SessionManager::wait_event(int timeout_ms, int& session_id, pid_t& tid, int& signal)
+{
+  auto start_time = std::chrono::steady_clock::now();
+  while (true)
+  {
+    bool any_attached = false;
+    for (auto& [id, session] : m_sessions)
+    {
+      if (!session->is_attached()) continue;
+      any_attached = true;
+
+      auto result_opt = session->poll_event(tid, signal);
+      if (!result_opt) continue;
+
+      session_id = id;
+      m_current = id;
+      return result_opt.value();
+    }
+
+    if (!any_attached)
+      return Base::Status::fail("wait_event: 未附加任何进程");
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start_time).count();
+    if (elapsed > timeout_ms)
+      return Base::Status::fail("wait_event: 等待超时");
+
+    // 所有会话的事件都来自同一个 waitpid(-1), 阻塞到有新的 SIGCHLD 再逐个会话取
+    Utils::wait_child_signal(static_cast<int>(timeout_ms - elapsed));
+  }
+}
+
+}
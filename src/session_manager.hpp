@@ -0,0 +1,56 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <sys/types.h>
+
+#include "debugger_core.hpp"
+#include "status.hpp"
+
+namespace Core
+{
+
+// 多进程调试会话
+// 每个被调试进程对应一个 DebuggerCore, 各自维护线程表, 断点, 缓存和事件队列
+// 所有会话共用一个 RPC 服务和一个事件循环, 任意会话的 waitpid(-1) 收到其他会话的事件时转入对方的队列
+class SessionManager
+{
+public:
+  SessionManager();
+
+  // 禁止拷贝, 会话中的事件路由引用了 this
+  SessionManager(const SessionManager&) = delete;
+  SessionManager& operator=(const SessionManager&) = delete;
+
+  // 当前会话, RPC 命令默认作用于它
+  DebuggerCore& current() { return *m_sessions.at(m_current); }
+  int current_id() const { return m_current; }
+
+  // attach / launch 前调用: 当前会话没有附加进程时直接使用, 否则新建会话并切换过去
+  DebuggerCore& prepare_session();
+
+  // 移除当前会话并切换到 ID 最小的会话, 至少保留一个会话
+  void close_current();
+
+  // 切换当前会话
+  Base::Status select(int session_id);
+
+  // 会话 ID -> 进程号, 没有附加进程的会话为 -1
+  std::map<int, pid_t> list();
+
+  // 把当前会话中 KEEP 策略保持暂停的子进程放到新会话中, 并切换过去
+  Base::Status adopt_fork_child(pid_t pid, int& session_id);
+
+  // 等待任意会话的事件, 有事件的会话成为当前会话
+  Base::Status wait_event(int timeout_ms, int& session_id, pid_t& tid, int& signal);
+
+private:
+  std::map<int, std::unique_ptr<DebuggerCore>> m_sessions;
+  int m_current;
+  int m_next_id;
+
+  // 新建会话, 返回 ID
+  int create_session();
+};
+
+}
@@ -0,0 +1,257 @@
+#include <cstdint>
+#include <optional>
+
+#include "step_predictor.hpp"
+#include "log.hpp"
+
+namespace Core
+{
+
+namespace
+{
+
+// pstate 中的条件标志位
+constexpr uint64_t PSTATE_N = 1ULL << 31;
+constexpr uint64_t PSTATE_Z = 1ULL << 30;
+constexpr uint64_t PSTATE_C = 1ULL << 29;
+constexpr uint64_t PSTATE_V = 1ULL << 28;
+
+// 序言和函数边界的特征指令
+constexpr uint32_t PACIASP = 0xD503233F;
+constexpr uint32_t PACIBSP = 0xD503237F;
+constexpr uint32_t BTI_C = 0xD503245F;
+constexpr uint32_t BTI_JC = 0xD50324DF;
+constexpr uint32_t AUTIASP = 0xD50323BF;
+constexpr uint32_t AUTIBSP = 0xD50323FF;
+
+// add x29, sp, #imm(包含 mov x29, sp)
+bool is_set_frame_pointer(uint32_t code) { return (code & 0xFF8003FF) == 0x910003FD; }
+
+// stp x29, x30, [sp, #-imm]! 或 stp x29, x30, [sp, #imm]
+bool is_save_frame_record(uint32_t code)
+{
+  return (code & 0xFFC07FFF) == 0xA9807BFD || (code & 0xFFC07FFF) == 0xA9007BFD;
+}
+
+// ldp x29, x30, [sp], #imm 或 ldp x29, x30, [sp, #imm]
+bool is_restore_frame_record(uint32_t code)
+{
+  return (code & 0xFFC07FFF) == 0xA8C07BFD || (code & 0xFFC07FFF) == 0xA9407BFD;
+}
+
+// ret / retaa / retab
+bool is_return(uint32_t code)
+{
+  return (code & 0xFFFFFC1F) == 0xD65F0000 || code == 0xD65F0BFF || code == 0xD65F0FFF;
+}
+
+// ret 之前紧挨着恢复帧记录(中间可能有 autiasp / add sp), 是有栈帧函数的收尾, 可能是当前函数中间的提前返回
+// 否则是没有栈帧的函数的结尾, b / br 在函数内部也很常见, 不作为边界
+bool is_frame_epilogue(const std::vector<uint32_t>& preceding, size_t ret_index)
+{
+  constexpr size_t EPILOGUE_SCAN = 3;
+  for (size_t i = ret_index + 1; i < preceding.size() && i <= ret_index + EPILOGUE_SCAN; ++i)
+  {
+    if (is_restore_frame_record(preceding[i])) return true;
+    if (preceding[i] != AUTIASP && preceding[i] != AUTIBSP && (preceding[i] & 0xFF8003FF) != 0x910003FF)
+      return false;
+  }
+  return false;
+}
+
+}
+
+std::optional<uint64_t> StepPredictor::read_register(uint32_t reg, const user_pt_regs& regs)
+{
+  if (reg >= ARM64_REG_X0 && reg <= ARM64_REG_X28)
+    return regs.regs[reg - ARM64_REG_X0];
+  if (reg >= ARM64_REG_W0 && reg <= ARM64_REG_W30)
+    return regs.regs[reg - ARM64_REG_W0] & 0xFFFFFFFF;
+
+  switch (reg)
+  {
+    case ARM64_REG_X29: return regs.regs[29];
+    case ARM64_REG_X30: return regs.regs[30];
+    case ARM64_REG_XZR:
+    case ARM64_REG_WZR: return 0;
+    case ARM64_REG_SP: return regs.sp;
+    case ARM64_REG_WSP: return regs.sp & 0xFFFFFFFF;
+    default:
+      LOG_ERROR("无法识别的寄存器 ID: {}", reg);
+      return std::nullopt;
+  }
+}
+
+bool StepPredictor::evaluate_condition(int32_t cc, uint64_t pstate)
+{
+  bool n = (pstate & PSTATE_N) != 0;
+  bool z = (pstate & PSTATE_Z) != 0;
+  bool c = (pstate & PSTATE_C) != 0;
+  bool v = (pstate & PSTATE_V) != 0;
+
+  switch (cc)
+  {
+    case ARM64_CC_EQ: return z;
+    case ARM64_CC_NE: return !z;
+    case ARM64_CC_HS: return c;
+    case ARM64_CC_LO: return !c;
+    case ARM64_CC_MI: return n;
+    case ARM64_CC_PL: return !n;
+    case ARM64_CC_VS: return v;
+    case ARM64_CC_VC: return !v;
+    case ARM64_CC_HI: return c && !z;
+    case ARM64_CC_LS: return !c || z;
+    case ARM64_CC_GE: return n == v;
+    case ARM64_CC_LT: return n != v;
+    case ARM64_CC_GT: return !z && n == v;
+    case ARM64_CC_LE: return z || n != v;
+    // al / nv 都是总是成立
+    default: return true;
+  }
+}
+
+StepPredictor::FrameState StepPredictor::classify_frame(const std::vector<uint32_t>& preceding)
+{
+  // 扫描到当前函数的序言为止, 函数中间提前返回的 ldp x29, x30 / ret 不是边界
+  for (size_t i = 0; i < preceding.size(); ++i)
+  {
+    uint32_t code = preceding[i];
+    if (is_set_frame_pointer(code))
+      return FrameState::FRAME_RECORD;
+
+    // 保存了帧记录但还没有设置 x29, x30 还没有被调用覆盖
+    if (is_save_frame_record(code))
+      return FrameState::LINK_REGISTER;
+
+    // 到达函数开头还没有建立栈帧
+    if (code == PACIASP || code == PACIBSP || code == BTI_C || code == BTI_JC)
+      return FrameState::LINK_REGISTER;
+
+    // 没有栈帧的函数的结尾, 当前函数从它之后开始
+    if (is_return(code) && !is_frame_epilogue(preceding, i))
+      return FrameState::LINK_REGISTER;
+  }
+  return FrameState::UNKNOWN;
+}
+
+std::optional<StepPredictor::Prediction> StepPredictor::predict(const Assembly::Instruction& insn, const user_pt_regs& regs, uint64_t pac_insn_mask)
+{
+  using Assembly::Instruction;
+  using Assembly::Operand;
+
+  Prediction prediction;
+  uint64_t fallthrough = insn.address + 4;
+
+  switch (insn.type)
+  {
+    case Instruction::Type::UNKNOWN:
+      LOG_ERROR("0x{:x} 处的指令无法识别, 不能预测下一条指令", insn.address);
+      return std::nullopt;
+
+    // svc 返回后从下一条继续
+    case Instruction::Type::NORMAL:
+    case Instruction::Type::SYSCALL:
+      prediction.next_pc = fallthrough;
+      return prediction;
+
+    case Instruction::Type::RETURN:
+    {
+      // ret 不带操作数时使用 x30
+      uint32_t reg = insn.op_count > 0 && insn.ops[0].type == Operand::type::REG ? insn.ops[0].reg : static_cast<uint32_t>(ARM64_REG_X30);
+      auto target_opt = read_register(reg, regs);
+      if (!target_opt) return std::nullopt;
+      prediction.next_pc = strip_pac(target_opt.value(), pac_insn_mask);
+      return prediction;
+    }
+
+    case Instruction::Type::UNCONDITIONAL_BRANCH:
+    {
+      switch (insn.id)
+      {
+        case ARM64_INS_BL:
+        case ARM64_INS_BLR:
+        case ARM64_INS_BLRAA:
+        case ARM64_INS_BLRAAZ:
+        case ARM64_INS_BLRAB:
+        case ARM64_INS_BLRABZ:
+          prediction.is_call = true;
+          break;
+
+        // brb 是分支记录缓冲区的维护指令, 不会跳转
+        case ARM64_INS_BRB:
+          prediction.next_pc = fallthrough;
+          return prediction;
+
+        default:
+          break;
+      }
+
+      if (insn.op_count == 0)
+        return std::nullopt;
+
+      // b / bl 的立即数已经是绝对地址, br / blr 系列跳到寄存器, 带认证的版本成功时会去掉签名
+      const Operand& target = insn.ops[0];
+      if (target.type == Operand::type::IMM)
+        prediction.next_pc = static_cast<uint64_t>(target.imm);
+      else if (target.type == Operand::type::REG)
+      {
+        auto target_opt = read_register(target.reg, regs);
+        if (!target_opt) return std::nullopt;
+        prediction.next_pc = strip_pac(target_opt.value(), pac_insn_mask);
+      }
+      else
+        return std::nullopt;
+      return prediction;
+    }
+
+    case Instruction::Type::CONDITIONAL_BRANCH:
+    {
+      bool taken = false;
+      uint64_t target = 0;
+
+      switch (insn.id)
+      {
+        case ARM64_INS_CBZ:
+        case ARM64_INS_CBNZ:
+        {
+          if (insn.op_count < 2) return std::nullopt;
+          auto value_opt = read_register(insn.ops[0].reg, regs);
+          if (!value_opt) return std::nullopt;
+          taken = (value_opt.value() == 0) == (insn.id == ARM64_INS_CBZ);
+          target = static_cast<uint64_t>(insn.ops[1].imm);
+          break;
+        }
+
+        case ARM64_INS_TBZ:
+        case ARM64_INS_TBNZ:
+        {
+          if (insn.op_count < 3) return std::nullopt;
+          auto value_opt = read_register(insn.ops[0].reg, regs);
+          if (!value_opt) return std::nullopt;
+          bool bit_set = ((value_opt.value() >> (insn.ops[1].imm & 63)) & 1) != 0;
+          taken = bit_set == (insn.id == ARM64_INS_TBNZ);
+          target = static_cast<uint64_t>(insn.ops[2].imm);
+          break;
+        }
+
+        // b.cond / bc.cond
+        default:
+        {
+          if (insn.op_count < 1) return std::nullopt;
+          taken = evaluate_condition(insn.cc, regs.pstate);
+          target = static_cast<uint64_t>(insn.ops[0].imm);
+          break;
+        }
+      }
+
+      prediction.next_pc = taken ? target : fallthrough;
+      if (target != fallthrough)
+        prediction.alternate = taken ? fallthrough : target;
+      return prediction;
+    }
+  }
+
+  return std::nullopt;
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "assembly.hpp"
+#include "register_control.hpp"
+
+namespace Core
+{
+
+// 下一条指令地址预测, 供软件单步放置临时断点
+// 条件标志, cbz / tbz 的寄存器, br / blr / ret 的目标都直接从暂停时的寄存器求值
+class StepPredictor
+{
+public:
+  struct Prediction
+  {
+    uint64_t next_pc = 0;                 // 按当前寄存器计算出的下一条指令地址
+    std::optional<uint64_t> alternate;    // 条件跳转的另一条路径, 同时下断点防止预测失误时线程跑飞
+    bool is_call = false;                 // bl / blr 系列, 返回地址是 pc + 4
+  };
+
+  // insn 必须是 regs.pc 处的指令, 无法识别的指令返回 std::nullopt
+  static std::optional<Prediction> predict(const Assembly::Instruction& insn, const user_pt_regs& regs, uint64_t pac_insn_mask);
+
+  // 根据 pstate 中的 nzcv 判断条件码是否成立, cc 为 capstone 的 arm64_cc
+  static bool evaluate_condition(int32_t cc, uint64_t pstate);
+
+  // 当前函数的栈帧状态
+  enum class FrameState
+  {
+    FRAME_RECORD,   // 已经执行 mov x29, sp, 返回地址保存在 [x29 + 8]
+    LINK_REGISTER,  // 还在序言之前或者是叶子函数, 返回地址在 lr
+    UNKNOWN,        // 扫描范围内没有找到特征指令
+  };
+
+  // 从 pc 往前扫描判断栈帧状态, preceding[0] 是 pc - 4 处的指令, preceding[1] 是 pc - 8, 依此类推
+  static FrameState classify_frame(const std::vector<uint32_t>& preceding);
+
+  // 去掉指令地址中的 PAC 签名
+  static uint64_t strip_pac(uint64_t address, uint64_t pac_insn_mask) { return address & ~pac_insn_mask; }
+
+private:
+  // 读取 capstone 寄存器 ID 对应的值, w 寄存器只取低 32 位
+  static std::optional<uint64_t> read_register(uint32_t reg, const user_pt_regs& regs);
+};
+
+}
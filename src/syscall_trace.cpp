@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <asm/unistd.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#include "syscall_trace.hpp"
+#include "memory_control.hpp"
+#include "remote_control.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+namespace Core
+{
+
+namespace
+{
+
+static_assert(sizeof(SyscallEvent) == 88, "SyscallEvent 布局已改变, 客户端解析需要同步修改");
+static_assert((SyscallTracer::RING_CAPACITY & (SyscallTracer::RING_CAPACITY - 1)) == 0, "RING_CAPACITY 必须是 2 的幂");
+
+// 系统调用中缓冲区参数的含义
+enum class CaptureKind
+{
+  STRING_IN,    // 以 '\0' 结尾的路径, 入口读取
+  BUFFER_IN,    // 长度在 size_arg 中的输入缓冲区, 入口读取
+  BUFFER_OUT,   // 输出缓冲区, 出口按返回值读取
+};
+
+struct CaptureRule
+{
+  long number;
+  int arg;
+  CaptureKind kind;
+  int size_arg;
+};
+
+constexpr CaptureRule CAPTURE_RULES[] = {
+  {__NR_openat, 1, CaptureKind::STRING_IN, -1},
+  {__NR_faccessat, 1, CaptureKind::STRING_IN, -1},
+  {__NR_newfstatat, 1, CaptureKind::STRING_IN, -1},
+  {__NR_unlinkat, 1, CaptureKind::STRING_IN, -1},
+  {__NR_readlinkat, 1, CaptureKind::STRING_IN, -1},
+  {__NR_execve, 0, CaptureKind::STRING_IN, -1},
+  {__NR_write, 1, CaptureKind::BUFFER_IN, 2},
+  {__NR_pwrite64, 1, CaptureKind::BUFFER_IN, 2},
+  {__NR_sendto, 1, CaptureKind::BUFFER_IN, 2},
+  {__NR_connect, 1, CaptureKind::BUFFER_IN, 2},
+  {__NR_read, 1, CaptureKind::BUFFER_OUT, 2},
+  {__NR_pread64, 1, CaptureKind::BUFFER_OUT, 2},
+  {__NR_recvfrom, 1, CaptureKind::BUFFER_OUT, 2},
+};
+
+const CaptureRule* find_capture_rule(uint64_t number)
+{
+  for (const auto& rule : CAPTURE_RULES)
+  {
+    if (static_cast<uint64_t>(rule.number) == number)
+      return &rule;
+  }
+  return nullptr;
+}
+
+// 这些调用成功时不会回到出口
+bool is_no_return(uint64_t number)
+{
+  return number == __NR_exit || number == __NR_exit_group;
+}
+
+uint64_t monotonic_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+Base::Status SyscallTracer::start(pid_t pid, pid_t tid, const std::vector<int>& numbers, size_t capture_size)
+{
+  if (numbers.empty())
+    return Base::Status::fail("没有指定要跟踪的系统调用");
+
+  if (m_pid != pid) reset();
+  m_pid = pid;
+
+  // 已经安装过的调用号不需要再追加过滤器
+  std::vector<int> new_numbers;
+  for (const int number : numbers)
+  {
+    if (number < 0)
+      return Base::Status::fail("无效的系统调用号: {}", number);
+    if (m_installed.count(number) == 0 &&
+      std::find(new_numbers.begin(), new_numbers.end(), number) == new_numbers.end())
+      new_numbers.push_back(number);
+  }
+
+  if (!new_numbers.empty())
+  {
+    Base::Status s = install_filter(tid, new_numbers);
+    if (s.is_fail()) return s;
+    m_installed.insert(new_numbers.begin(), new_numbers.end());
+  }
+
+  m_selected.clear();
+  m_selected.insert(numbers.begin(), numbers.end());
+  m_capture_size = std::min(capture_size, MAX_CAPTURE_SIZE);
+  m_enabled = true;
+  // 过滤器无法移除, 分离后被选中的系统调用返回 ENOSYS, 在成功信息中提醒
+  if (capture_size > MAX_CAPTURE_SIZE)
+    return Base::Status::success("开始跟踪 {} 个系统调用, 新安装 {} 个, capture_size 限制为 {}, 过滤器无法移除, 分离后这些调用会返回 ENOSYS",
+      m_selected.size(), new_numbers.size(), MAX_CAPTURE_SIZE);
+  return Base::Status::success("开始跟踪 {} 个系统调用, 新安装 {} 个, 过滤器无法移除, 分离后这些调用会返回 ENOSYS",
+    m_selected.size(), new_numbers.size());
+}
+
+void SyscallTracer::stop()
+{
+  m_enabled = false;
+  for (auto& [tid, call] : m_pending)
+  {
+    call.event.flags |= SyscallEvent::NO_RETURN;
+    push(call);
+  }
+  m_pending.clear();
+}
+
+Base::Status SyscallTracer::install_filter(pid_t tid, const std::vector<int>& numbers)
+{
+  if (numbers.size() > MAX_FILTER_NUMBERS)
+    return Base::Status::fail("一次最多跟踪 {} 个系统调用", MAX_FILTER_NUMBERS);
+
+  // 不是 aarch64 的调用直接放行; 调用号命中时跳到最后的 RET_TRACE
+  const uint8_t count = static_cast<uint8_t>(numbers.size());
+  std::vector<sock_filter> filter;
+  filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)));
+  filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_AARCH64, 1, 0));
+  filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+  filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)));
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    // BPF_JUMP 是花括号初始化, 跳转距离要先转成 __u8, 否则 clang 报收窄错误
+    const __u8 jump_true = static_cast<__u8>(count - i);
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(numbers[i]), jump_true, 0));
+  }
+  filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+  filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+
+  // sock_fprog 和过滤器放在一起写入临时区, filter 指针要等拿到临时区地址后再填
+  sock_fprog program = {};
+  program.len = static_cast<unsigned short>(filter.size());
+  const size_t header_size = Utils::align_up(sizeof(program), 8);
+  std::vector<uint8_t> buffer(header_size + filter.size() * sizeof(sock_filter));
+  memcpy(buffer.data() + header_size, filter.data(), filter.size() * sizeof(sock_filter));
+
+  auto& remote_control = RemoteControl::get_instance();
+  auto scratch_opt = remote_control.write_scratch(m_pid, tid, buffer.data(), buffer.size());
+  if (!scratch_opt)
+    return Base::Status::fail("写入 seccomp 过滤器失败");
+
+  program.filter = reinterpret_cast<sock_filter*>(scratch_opt.value() + header_size);
+  memcpy(buffer.data(), &program, sizeof(program));
+  scratch_opt = remote_control.write_scratch(m_pid, tid, buffer.data(), buffer.size());
+  if (!scratch_opt)
+    return Base::Status::fail("写入 seccomp 过滤器失败");
+
+  // 没有 CAP_SYS_ADMIN 时安装过滤器要求 no_new_privs, 应用进程由 zygote 设置过, 这里再确认一次
+  auto prctl_opt = remote_control.syscall(m_pid, tid, __NR_prctl, {PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0});
+  if (!prctl_opt || RemoteControl::is_error(prctl_opt.value()))
+    return Base::Status::fail("目标进程 prctl(PR_SET_NO_NEW_PRIVS) 失败");
+
+  // TSYNC 让进程中所有线程使用同一个过滤器, 失败时返回冲突线程的 tid
+  auto seccomp_opt = remote_control.syscall(m_pid, tid, __NR_seccomp,
+    {SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_TSYNC, scratch_opt.value()});
+  if (!seccomp_opt)
+    return Base::Status::fail("注入 seccomp 系统调用失败");
+  if (RemoteControl::is_error(seccomp_opt.value()))
+    return Base::Status::fail("目标进程安装 seccomp 过滤器失败, errno: {}", strerror(-static_cast<int>(seccomp_opt.value())));
+  if (seccomp_opt.value() != 0)
+    return Base::Status::fail("线程 {} 的 seccomp 状态与其他线程不一致, 无法同步过滤器", seccomp_opt.value());
+
+  LOG_DEBUG("进程 {} 安装 seccomp 过滤器, 调用号 {} 个, 指令 {} 条", m_pid, numbers.size(), filter.size());
+  return Base::Status::success("安装 seccomp 过滤器成功");
+}
+
+bool SyscallTracer::on_entry(pid_t tid)
+{
+  if (!m_enabled) return false;
+
+  auto regs_opt = RegisterControl::get_instance().get_all_gpr(tid);
+  if (!regs_opt) return false;
+  const user_pt_regs& regs = regs_opt.value();
+
+  // 早先安装过但当前没有选中的调用号
+  uint64_t number = regs.regs[8];
+  if (m_selected.count(static_cast<int>(number)) == 0) return false;
+
+  // 上一次的调用没有等到出口, 比如被 pause 打断后用 PTRACE_CONT 恢复
+  auto pending_it = m_pending.find(tid);
+  if (pending_it != m_pending.end())
+  {
+    pending_it->second.event.flags |= SyscallEvent::NO_RETURN;
+    push(pending_it->second);
+    m_pending.erase(pending_it);
+  }
+
+  PendingCall call;
+  call.event = {};
+  call.event.tid = static_cast<uint32_t>(tid);
+  call.event.timestamp_ns = monotonic_ns();
+  call.event.number = number;
+  for (int i = 0; i < 6; ++i)
+    call.event.args[i] = regs.regs[i];
+  capture_entry(regs, call);
+
+  if (is_no_return(number))
+  {
+    call.event.flags |= SyscallEvent::NO_RETURN;
+    push(call);
+    return false;
+  }
+
+  m_pending[tid] = std::move(call);
+  return true;
+}
+
+void SyscallTracer::on_exit(pid_t tid)
+{
+  auto pending_it = m_pending.find(tid);
+  if (pending_it == m_pending.end()) return;
+
+  PendingCall& call = pending_it->second;
+  auto regs_opt = RegisterControl::get_instance().get_all_gpr(tid);
+  if (regs_opt)
+  {
+    call.event.result = regs_opt->regs[0];
+    capture_exit(regs_opt.value(), call);
+  }
+  else
+    call.event.flags |= SyscallEvent::NO_RETURN;
+
+  push(call);
+  m_pending.erase(pending_it);
+}
+
+void SyscallTracer::forget_thread(pid_t tid)
+{
+  auto pending_it = m_pending.find(tid);
+  if (pending_it == m_pending.end()) return;
+
+  pending_it->second.event.flags |= SyscallEvent::NO_RETURN;
+  push(pending_it->second);
+  m_pending.erase(pending_it);
+}
+
+void SyscallTracer::capture_entry(const user_pt_regs& regs, PendingCall& call)
+{
+  if (m_capture_size == 0) return;
+
+  const CaptureRule* rule = find_capture_rule(call.event.number);
+  if (!rule || rule->kind == CaptureKind::BUFFER_OUT) return;
+
+  size_t size = m_capture_size;
+  if (rule->kind == CaptureKind::BUFFER_IN)
+    size = std::min<uint64_t>(size, regs.regs[rule->size_arg]);
+
+  bool truncated = read_remote(regs.regs[rule->arg], size, rule->kind == CaptureKind::STRING_IN, call.data);
+  if (truncated || (rule->kind == CaptureKind::BUFFER_IN && regs.regs[rule->size_arg] > size))
+    call.event.flags |= SyscallEvent::DATA_TRUNCATED;
+}
+
+void SyscallTracer::capture_exit(const user_pt_regs& regs, PendingCall& call)
+{
+  if (m_capture_size == 0) return;
+
+  const CaptureRule* rule = find_capture_rule(call.event.number);
+  if (!rule || rule->kind != CaptureKind::BUFFER_OUT) return;
+
+  // 出口时 x0 已经是返回值, 缓冲区地址用入口保存的参数
+  uint64_t result = regs.regs[0];
+  if (RemoteControl::is_error(result) || result == 0) return;
+
+  size_t size = std::min<uint64_t>(m_capture_size, result);
+  read_remote(call.event.args[rule->arg], size, false, call.data);
+  if (result > size)
+    call.event.flags |= SyscallEvent::DATA_TRUNCATED;
+}
+
+bool SyscallTracer::read_remote(uint64_t address, size_t size, bool is_string, std::vector<uint8_t>& data)
+{
+  data.clear();
+  if (address == 0 || size == 0) return false;
+
+  // 按页读取, 字符串可能紧挨着未映射的页
+  auto& memory_control = MemoryControl::get_instance();
+  const uint64_t page_size = static_cast<uint64_t>(Utils::get_page_size());
+  while (data.size() < size)
+  {
+    uint64_t current = address + data.size();
+    size_t chunk_size = std::min<uint64_t>(size - data.size(), page_size - (current & (page_size - 1)));
+    size_t offset = data.size();
+    data.resize(offset + chunk_size);
+    if (!memory_control.read_memory(m_pid, current, data.data() + offset, chunk_size))
+    {
+      data.resize(offset);
+      return false;
+    }
+
+    if (is_string)
+    {
+      auto end_it = std::find(data.begin() + offset, data.end(), 0);
+      if (end_it != data.end())
+      {
+        data.erase(end_it, data.end());
+        return false;
+      }
+    }
+  }
+  return is_string;
+}
+
+void SyscallTracer::push(PendingCall& call)
+{
+  call.event.data_size = static_cast<uint32_t>(call.data.size());
+  size_t record_size = Utils::align_up(sizeof(SyscallEvent) + call.data.size(), 8);
+  if (record_size > RING_CAPACITY)
+  {
+    ++m_dropped;
+    return;
+  }
+  call.event.size = static_cast<uint32_t>(record_size);
+
+  // 空间不足时从尾部丢弃整条旧记录
+  while (RING_CAPACITY - (m_head - m_tail) < record_size)
+  {
+    uint32_t old_size = 0;
+    ring_read(m_tail, &old_size, sizeof(old_size));
+    m_tail += old_size;
+    ++m_dropped;
+  }
+
+  ring_write(m_head, &call.event, sizeof(SyscallEvent));
+  if (!call.data.empty())
+    ring_write(m_head + sizeof(SyscallEvent), call.data.data(), call.data.size());
+  m_head += record_size;
+}
+
+size_t SyscallTracer::read(std::vector<uint8_t>& data, size_t max_size)
+{
+  data.clear();
+  size_t count = 0;
+  while (m_tail != m_head)
+  {
+    uint32_t size = 0;
+    ring_read(m_tail, &size, sizeof(size));
+    if (data.size() + size > max_size)
+    {
+      // 第一条记录就放不下时截断缓冲区内容, 记录头总是完整的
+      if (count == 0)
+      {
+        SyscallEvent event;
+        ring_read(m_tail, &event, sizeof(event));
+        size_t room = Utils::align_down(max_size, 8);
+        size_t keep = room > sizeof(event) ? std::min<size_t>(event.data_size, room - sizeof(event)) : 0;
+        event.data_size = static_cast<uint32_t>(keep);
+        event.size = static_cast<uint32_t>(Utils::align_up(sizeof(event) + keep, 8));
+        event.flags |= SyscallEvent::DATA_TRUNCATED;
+
+        data.resize(event.size);
+        memcpy(data.data(), &event, sizeof(event));
+        ring_read(m_tail + sizeof(event), data.data() + sizeof(event), keep);
+        m_tail += size;
+        ++count;
+      }
+      break;
+    }
+
+    size_t offset = data.size();
+    data.resize(offset + size);
+    ring_read(m_tail, data.data() + offset, size);
+    m_tail += size;
+    ++count;
+  }
+  return count;
+}
+
+void SyscallTracer::reset()
+{
+  m_pid = -1;
+  m_enabled = false;
+  m_capture_size = 0;
+  m_selected.clear();
+  m_installed.clear();
+  m_pending.clear();
+  m_head = 0;
+  m_tail = 0;
+  m_dropped = 0;
+}
+
+void SyscallTracer::ring_write(uint64_t position, const void* data, size_t size)
+{
+  size_t index = position & (RING_CAPACITY - 1);
+  size_t first = std::min(size, RING_CAPACITY - index);
+  memcpy(m_ring.data() + index, data, first);
+  memcpy(m_ring.data(), static_cast<const uint8_t*>(data) + first, size - first);
+}
+
+void SyscallTracer::ring_read(uint64_t position, void* data, size_t size) const
+{
+  size_t index = position & (RING_CAPACITY - 1);
+  size_t first = std::min(size, RING_CAPACITY - index);
+  memcpy(data, m_ring.data() + index, first);
+  memcpy(static_cast<uint8_t*>(data) + first, m_ring.data(), size - first);
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "register_control.hpp"
+#include "status.hpp"
+
+namespace Core
+{
+
+// 一次系统调用的记录头, 之后紧跟 data_size 字节的缓冲区内容
+// 记录按 8 字节对齐, size 包含头部, 数据和对齐填充
+struct SyscallEvent
+{
+  uint32_t size;              // 整条记录的字节数
+  uint32_t tid;               // 线程
+  uint64_t timestamp_ns;      // 进入系统调用的时间, CLOCK_MONOTONIC
+  uint64_t number;            // 调用号
+  uint64_t args[6];           // x0 ~ x5
+  uint64_t result;            // 返回值, 带 NO_RETURN 时无效
+  uint32_t data_size;         // 缓冲区内容字节数
+  uint32_t flags;             // SyscallEvent::Flags
+
+  enum Flags : uint32_t
+  {
+    NO_RETURN = 1 << 0,       // 没有拿到返回值: exit / 线程退出 / 出口前被打断
+    DATA_TRUNCATED = 1 << 1,  // 缓冲区内容超过 capture_size 被截断
+  };
+};
+
+// 基于 seccomp 的系统调用跟踪
+// 在目标进程中安装 SECCOMP_RET_TRACE 过滤器, 只有选中的调用号会停下, 其他系统调用没有额外开销
+// 入口记录参数和输入缓冲区, 用 PTRACE_SYSCALL 运行到出口再记录返回值和输出缓冲区, 写入二进制环形缓冲区
+//
+// seccomp 过滤器无法卸载: stop 之后选中的调用仍然会停下, 由调试器直接放行
+// 没有跟踪者时 SECCOMP_RET_TRACE 会让系统调用返回 ENOSYS, 安装过过滤器的进程分离后这些调用会失败
+class SyscallTracer
+{
+public:
+  // 环形缓冲区大小, 必须是 2 的幂
+  static constexpr size_t RING_CAPACITY = 1 << 20;
+
+  // BPF 条件跳转的偏移只有 8 位, 一个过滤器最多容纳的调用号
+  static constexpr size_t MAX_FILTER_NUMBERS = 250;
+
+  // 单条记录的缓冲区内容上限, 保证环形缓冲区能容纳足够多的记录
+  static constexpr size_t MAX_CAPTURE_SIZE = RING_CAPACITY / 16;
+
+  // 开始跟踪 numbers 中的系统调用, 新的调用号追加安装过滤器, 所有线程同步生效
+  // capture_size 为 0 时不记录缓冲区内容, 超过 MAX_CAPTURE_SIZE 时按上限记录
+  Base::Status start(pid_t pid, pid_t tid, const std::vector<int>& numbers, size_t capture_size);
+
+  // 停止记录, 已安装的过滤器保留
+  void stop();
+
+  bool is_enabled() const { return m_enabled; }
+  bool is_installed() const { return !m_installed.empty(); }
+
+  // seccomp 入口事件, 返回 true 表示需要用 PTRACE_SYSCALL 运行到出口
+  bool on_entry(pid_t tid);
+
+  // 系统调用出口事件
+  void on_exit(pid_t tid);
+
+  // 线程退出, 把没有返回的调用写入缓冲区
+  void forget_thread(pid_t tid);
+
+  // 取出不超过 max_size 字节的完整记录
+  // 第一条记录就超过 max_size 时截断它的缓冲区内容后返回, 保证有记录时至少返回一条, 不会卡住
+  size_t read(std::vector<uint8_t>& data, size_t max_size);
+
+  // 缓冲区满时丢弃的旧记录数
+  uint64_t dropped() const { return m_dropped; }
+
+  // 分离后清理
+  void reset();
+
+private:
+  // 入口已记录, 等待出口的调用
+  struct PendingCall
+  {
+    SyscallEvent event;
+    std::vector<uint8_t> data;
+  };
+
+  pid_t m_pid = -1;
+  bool m_enabled = false;
+  size_t m_capture_size = 0;
+  std::unordered_set<int> m_selected;                       // 当前要记录的调用号
+  std::unordered_set<int> m_installed;                      // 已经安装到过滤器中的调用号
+  std::unordered_map<pid_t, PendingCall> m_pending;
+
+  std::vector<uint8_t> m_ring = std::vector<uint8_t>(RING_CAPACITY);
+  uint64_t m_head = 0;                                      // 写位置, 单调递增
+  uint64_t m_tail = 0;                                      // 读位置, 单调递增
+  uint64_t m_dropped = 0;
+
+  // 在目标进程中安装只跟踪 numbers 的过滤器
+  Base::Status install_filter(pid_t tid, const std::vector<int>& numbers);
+
+  // 按调用号读取入口或出口的缓冲区参数
+  void capture_entry(const user_pt_regs& regs, PendingCall& call);
+  void capture_exit(const user_pt_regs& regs, PendingCall& call);
+
+  // 读取目标内存, 字符串读到 '\0' 为止, 返回是否被截断
+  bool read_remote(uint64_t address, size_t size, bool is_string, std::vector<uint8_t>& data);
+
+  // 写入一条记录, 空间不足时丢弃最旧的记录
+  void push(PendingCall& call);
+
+  void ring_write(uint64_t position, const void* data, size_t size);
+  void ring_read(uint64_t position, void* data, size_t size) const;
+};
+
+}
@@ -0,0 +1,277 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "trace_ring.hpp"
+#include "relocator.hpp"
+#include "remote_control.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace Core
+{
+
+namespace
+{
+
+// 记录从头部之后开始
+constexpr uint64_t RECORDS_OFFSET = sizeof(TraceRingHeader);
+
+// 蹦床栈帧: x0 ~ x30, nzcv, 原始 sp, 16 字节对齐
+constexpr uint32_t FRAME_SIZE = 0x110;
+constexpr uint32_t FRAME_LR = 240;
+constexpr uint32_t FRAME_NZCV = 248;
+constexpr uint32_t FRAME_SP = 256;
+
+static_assert(sizeof(TraceRingHeader) == 64, "TraceRingHeader 布局与蹦床代码不一致");
+static_assert(offsetof(TraceRecord, regs) == 48, "TraceRecord 布局与蹦床代码不一致");
+static_assert((TraceRing::CAPACITY & (TraceRing::CAPACITY - 1)) == 0, "CAPACITY 必须是 2 的幂");
+
+}
+
+TraceRing::TraceRing() : m_pid(-1), m_local_fd(-1), m_local_address(nullptr), m_remote_address(0), m_size(0)
+{
+}
+
+TraceRing::~TraceRing()
+{
+  destroy();
+}
+
+TraceRecord* TraceRing::record_at(uint64_t position) const
+{
+  uint64_t index = position & (CAPACITY - 1);
+  return reinterpret_cast<TraceRecord*>(m_local_address + RECORDS_OFFSET + index * sizeof(TraceRecord));
+}
+
+Base::Status TraceRing::create(pid_t pid, pid_t tid)
+{
+  if (is_ready())
+    return Base::Status::success("环形缓冲区已经创建");
+
+  auto& remote_control = RemoteControl::get_instance();
+  size_t size = Utils::align_page_up(RECORDS_OFFSET + CAPACITY * sizeof(TraceRecord));
+
+  // 目标进程中: memfd_create + ftruncate + mmap
+  const char name[] = "andbg_trace";
+  auto name_address = remote_control.write_scratch(pid, tid, name, sizeof(name));
+  if (!name_address)
+    return Base::Status::fail("写入 memfd 名称失败");
+
+  auto fd_opt = remote_control.syscall(pid, tid, SYS_memfd_create, {name_address.value(), MFD_CLOEXEC});
+  if (!fd_opt || RemoteControl::is_error(fd_opt.value()))
+    return Base::Status::fail("目标进程 memfd_create 失败");
+  uint64_t remote_fd = fd_opt.value();
+
+  auto close_remote_fd = [&]() { remote_control.syscall(pid, tid, SYS_close, {remote_fd}); };
+
+  auto truncate_opt = remote_control.syscall(pid, tid, SYS_ftruncate, {remote_fd, size});
+  if (!truncate_opt || RemoteControl::is_error(truncate_opt.value()))
+  {
+    close_remote_fd();
+    return Base::Status::fail("目标进程 ftruncate 失败");
+  }
+
+  auto remote_address = remote_control.mmap(pid, tid, 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, static_cast<int>(remote_fd), 0);
+  if (!remote_address)
+  {
+    close_remote_fd();
+    return Base::Status::fail("目标进程映射环形缓冲区失败");
+  }
+
+  // 调试器侧: 通过 /proc/[pid]/fd 打开同一个 memfd
+  std::string fd_path = fmt::format("/proc/{}/fd/{}", pid, remote_fd);
+  int local_fd = open(fd_path.c_str(), O_RDWR | O_CLOEXEC);
+  close_remote_fd();
+  if (local_fd < 0)
+  {
+    remote_control.munmap(pid, tid, remote_address.value(), size);
+    return Base::Status::fail("打开 {} 失败: {}", fd_path, strerror(errno));
+  }
+
+  void* local_address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, local_fd, 0);
+  if (local_address == MAP_FAILED)
+  {
+    close(local_fd);
+    remote_control.munmap(pid, tid, remote_address.value(), size);
+    return Base::Status::fail("本地映射环形缓冲区失败: {}", strerror(errno));
+  }
+
+  m_pid = pid;
+  m_local_fd = local_fd;
+  m_local_address = static_cast<uint8_t*>(local_address);
+  m_remote_address = remote_address.value();
+  m_size = size;
+
+  TraceRingHeader* ring_header = header();
+  memset(ring_header, 0, sizeof(TraceRingHeader));
+  ring_header->mask = CAPACITY - 1;
+  ring_header->record_size = sizeof(TraceRecord);
+
+  return Base::Status::success("环形缓冲区创建成功, 远程地址: 0x{:x}, 大小: 0x{:x}", m_remote_address, m_size);
+}
+
+void TraceRing::destroy()
+{
+  if (m_local_address != nullptr)
+  {
+    ::munmap(m_local_address, m_size);
+    m_local_address = nullptr;
+  }
+  if (m_local_fd >= 0)
+  {
+    close(m_local_fd);
+    m_local_fd = -1;
+  }
+  m_pid = -1;
+  m_remote_address = 0;
+  m_size = 0;
+}
+
+size_t TraceRing::drain(std::vector<TraceRecord>& records, size_t max_count)
+{
+  if (!is_ready()) return 0;
+
+  TraceRingHeader* ring_header = header();
+  uint64_t tail = __atomic_load_n(&ring_header->tail, __ATOMIC_RELAXED);
+
+  size_t count = 0;
+  while (count < max_count)
+  {
+    // 序号对上才说明蹦床已经写完这条记录
+    TraceRecord* record = record_at(tail);
+    if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != tail + 1)
+      break;
+
+    records.push_back(*record);
+    ++tail;
+    ++count;
+  }
+
+  __atomic_store_n(&ring_header->tail, tail, __ATOMIC_RELEASE);
+  return count;
+}
+
+uint64_t TraceRing::dropped() const
+{
+  if (!is_ready()) return 0;
+  return __atomic_load_n(&header()->dropped, __ATOMIC_RELAXED);
+}
+
+std::optional<std::vector<char>> TraceRing::build_trampoline(uint64_t trampoline_address, uint64_t hook_address,
+  uint32_t original_instruction, uint64_t ring_address, uint64_t hook_id, bool* clobbers_ip1)
+{
+  using Assembly::Arm64Writer;
+  Arm64Writer writer(trampoline_address);
+
+  // 保存 x0 ~ x30, nzcv, 原始 sp
+  writer.sub_imm(Arm64Writer::SP, Arm64Writer::SP, FRAME_SIZE);
+  for (uint32_t reg = 0; reg < 30; reg += 2)
+    writer.stp(reg, reg + 1, Arm64Writer::SP, reg * 8);
+  writer.str(Arm64Writer::LR, Arm64Writer::SP, FRAME_LR);
+  writer.mrs_nzcv(0);
+  writer.str(0, Arm64Writer::SP, FRAME_NZCV);
+  writer.add_imm(0, Arm64Writer::SP, FRAME_SIZE);
+  writer.str(0, Arm64Writer::SP, FRAME_SP);
+
+  // x0 = 头部, x1 = mask
+  writer.mov_u64(0, ring_address);
+  writer.ldr(1, 0, offsetof(TraceRingHeader, mask));
+
+  // 预留位置: x2 = head, 满了就跳到 full
+  size_t retry = writer.index();
+  writer.ldaxr(2, 0);
+  writer.ldr(3, 0, offsetof(TraceRingHeader, tail));
+  writer.sub_reg(4, 2, 3);
+  writer.cmp_reg(4, 1);
+  size_t branch_full = writer.index();
+  writer.nop();
+  writer.add_imm(5, 2, 1);
+  writer.stlxr(6, 5, 0);
+  writer.emit(Arm64Writer::encode_cbnz_w(6, (static_cast<int64_t>(retry) - static_cast<int64_t>(writer.index())) * 4));
+
+  // x7 = 记录地址 = 头部 + 64 + (head & mask) * record_size
+  writer.and_reg(7, 2, 1);
+  writer.ldr(8, 0, offsetof(TraceRingHeader, record_size));
+  writer.add_imm(9, 0, RECORDS_OFFSET);
+  writer.madd(7, 7, 8, 9);
+
+  // 固定字段
+  writer.mov_u64(10, hook_id);
+  writer.str(10, 7, offsetof(TraceRecord, hook_id));
+  writer.mov_u64(10, hook_address);
+  writer.str(10, 7, offsetof(TraceRecord, pc));
+  writer.ldr(10, Arm64Writer::SP, FRAME_SP);
+  writer.str(10, 7, offsetof(TraceRecord, sp));
+  writer.ldr(10, Arm64Writer::SP, FRAME_NZCV);
+  writer.str(10, 7, offsetof(TraceRecord, nzcv));
+  writer.mrs_tpidr_el0(10);
+  writer.str(10, 7, offsetof(TraceRecord, thread_pointer));
+
+  // 从栈上复制 x0 ~ x30
+  writer.add_imm(8, 7, offsetof(TraceRecord, regs));
+  writer.add_imm(9, Arm64Writer::SP, 0);
+  writer.movz(10, 31);
+  size_t copy = writer.index();
+  writer.ldr_post(11, 9, 8);
+  writer.str_post(11, 8, 8);
+  writer.sub_imm(10, 10, 1);
+  writer.emit(Arm64Writer::encode_cbnz_w(10, (static_cast<int64_t>(copy) - static_cast<int64_t>(writer.index())) * 4));
+
+  // 最后写序号提交记录, stlr 保证前面的写入先可见
+  writer.add_imm(5, 2, 1);
+  writer.stlr(5, 7);
+  size_t branch_restore = writer.index();
+  writer.nop();
+
+  // 缓冲区满: 丢弃计数 + 1
+  size_t full = writer.index();
+  writer.patch(branch_full, Arm64Writer::encode_b_cond(0x8 /* hi */, (static_cast<int64_t>(full) - static_cast<int64_t>(branch_full)) * 4));
+  writer.clrex();
+  writer.add_imm(3, 0, offsetof(TraceRingHeader, dropped));
+  size_t dropped_retry = writer.index();
+  writer.ldaxr(2, 3);
+  writer.add_imm(2, 2, 1);
+  writer.stlxr(4, 2, 3);
+  writer.emit(Arm64Writer::encode_cbnz_w(4, (static_cast<int64_t>(dropped_retry) - static_cast<int64_t>(writer.index())) * 4));
+
+  // 恢复现场
+  size_t restore = writer.index();
+  writer.patch(branch_restore, Arm64Writer::encode_b((static_cast<int64_t>(restore) - static_cast<int64_t>(branch_restore)) * 4));
+  writer.ldr(0, Arm64Writer::SP, FRAME_NZCV);
+  writer.msr_nzcv(0);
+  for (uint32_t reg = 0; reg < 30; reg += 2)
+    writer.ldp(reg, reg + 1, Arm64Writer::SP, reg * 8);
+  writer.ldr(Arm64Writer::LR, Arm64Writer::SP, FRAME_LR);
+  writer.add_imm(Arm64Writer::SP, Arm64Writer::SP, FRAME_SIZE);
+
+  // 执行原指令后跳回, 蹦床在 b 的范围内时直接用 b, 不破坏 x17
+  bool relocated_clobbers_ip1 = false;
+  if (!Assembly::Relocator::relocate(hook_address, original_instruction, writer, &relocated_clobbers_ip1))
+    return std::nullopt;
+  bool jump_back_reachable = Arm64Writer::is_b_reachable(writer.pc(), hook_address + 4);
+  if (jump_back_reachable)
+    writer.b(static_cast<int64_t>(hook_address + 4 - writer.pc()));
+  else
+    writer.absolute_jump(hook_address + 4);
+  if (clobbers_ip1) *clobbers_ip1 = relocated_clobbers_ip1 || !jump_back_reachable;
+
+  if (writer.size() > TRAMPOLINE_SIZE)
+  {
+    LOG_ERROR("蹦床大小 {} 超过上限 {}", writer.size(), TRAMPOLINE_SIZE);
+    return std::nullopt;
+  }
+
+  return writer.bytes();
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+#include "status.hpp"
+
+namespace Core
+{
+
+// 快速跟踪点命中一次写入的记录, 布局与蹦床代码一一对应, 不要随意调整
+struct TraceRecord
+{
+  uint64_t sequence;          // 提交序号, 等于写入位置 + 1, 用于判断记录是否写完
+  uint64_t hook_id;           // 断点 ID
+  uint64_t pc;                // 命中地址
+  uint64_t sp;                // 命中时的 sp
+  uint64_t nzcv;              // 命中时的条件标志
+  uint64_t thread_pointer;    // tpidr_el0, 用于区分线程
+  uint64_t regs[31];          // x0 ~ x30
+};
+
+// 共享环形缓冲区头部, 目标进程和调试器映射同一个 memfd
+struct TraceRingHeader
+{
+  uint64_t head;              // 生产者预留位置, 蹦床用独占访存自增
+  uint64_t tail;              // 消费者位置, 只有调试器写
+  uint64_t mask;              // 容量 - 1, 容量必须是 2 的幂
+  uint64_t record_size;       // 单条记录大小
+  uint64_t dropped;           // 缓冲区满时丢弃的记录数
+  uint64_t reserved[3];
+};
+
+// 快速跟踪点的共享内存环形缓冲区
+// 蹦床在目标进程内写, 调试器直接读本地映射, 整个过程不触发 SIGTRAP
+class TraceRing
+{
+private:
+  pid_t m_pid;                      // 目标进程
+  int m_local_fd;                   // 本地打开的 memfd
+  uint8_t* m_local_address;         // 本地映射地址
+  uint64_t m_remote_address;        // 目标进程中的映射地址
+  size_t m_size;                    // 映射大小
+
+  // 获取头部和记录
+  TraceRingHeader* header() const { return reinterpret_cast<TraceRingHeader*>(m_local_address); }
+  TraceRecord* record_at(uint64_t position) const;
+
+public:
+  // 环形缓冲区容量, 必须是 2 的幂
+  static constexpr uint64_t CAPACITY = 4096;
+
+  // 每个蹦床占用的最大字节数
+  static constexpr size_t TRAMPOLINE_SIZE = 512;
+
+  TraceRing();
+  ~TraceRing();
+
+  // 禁止拷贝
+  TraceRing(const TraceRing&) = delete;
+  TraceRing& operator=(const TraceRing&) = delete;
+
+  // 在目标进程中创建 memfd 并映射, 调试器通过 /proc/[pid]/fd 映射同一个文件
+  Base::Status create(pid_t pid, pid_t tid);
+
+  // 解除本地映射, 目标进程中的映射随进程释放
+  void destroy();
+
+  bool is_ready() const { return m_local_address != nullptr; }
+  pid_t pid() const { return m_pid; }
+  uint64_t remote_address() const { return m_remote_address; }
+
+  // 取出最多 max_count 条已提交的记录
+  size_t drain(std::vector<TraceRecord>& records, size_t max_count);
+
+  // 缓冲区满时被丢弃的记录数
+  uint64_t dropped() const;
+
+  // 生成蹦床: 保存寄存器 -> 写入环形缓冲区 -> 恢复寄存器 -> 执行重定位后的原指令 -> 跳回 hook_address + 4
+  // 恢复寄存器之后的代码会破坏 x17 时 clobbers_ip1 置为 true
+  static std::optional<std::vector<char>> build_trampoline(uint64_t trampoline_address, uint64_t hook_address,
+    uint32_t original_instruction, uint64_t ring_address, uint64_t hook_id, bool* clobbers_ip1 = nullptr);
+};
+
+}
@@ -1,7 +1,16 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstdint>
+#include <cstring>
 #include <dirent.h>
+#include <elf.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <thread>
 #include <vector>
 
+#include "file.hpp"
 #include "utils.hpp"
 #include "log.hpp"
 
@@ -87,6 +96,49 @@ pid_t waitpid_wrapper(pid_t pid, int* status, int __options)
   return wpid;
 }
 
+namespace
+{
+
+int g_child_signal_fd = -1;
+
+}
+
+void block_child_signal()
+{
+  if (g_child_signal_fd >= 0) return;
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  if (pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0)
+  {
+    LOG_ERROR("屏蔽 SIGCHLD 失败");
+    return;
+  }
+
+  g_child_signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (g_child_signal_fd < 0)
+    LOG_ERROR("创建 SIGCHLD 的 signalfd 失败, errno({}): {}", errno, strerror(errno));
+}
+
+bool wait_child_signal(int timeout_ms)
+{
+  if (g_child_signal_fd < 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 10)));
+    return false;
+  }
+
+  pollfd poll_fd = {g_child_signal_fd, POLLIN, 0};
+  int ret = poll(&poll_fd, 1, std::max(timeout_ms, 0));
+  if (ret <= 0) return false;
+
+  // 多个 SIGCHLD 会合并, 全部读出, 事件本身由之后的 waitpid 取
+  signalfd_siginfo info;
+  while (read(g_child_signal_fd, &info, sizeof(info)) == sizeof(info)) {}
+  return true;
+}
+
 long get_page_size()
 {
   static long page_size = sysconf(_SC_PAGE_SIZE);
@@ -174,4 +226,59 @@ std::string trim(const std::string& s)
   return s.substr(start, end - start);
 }
 
+std::optional<uint64_t> find_elf_symbol(const std::string& path, const std::string& name)
+{
+  auto file_opt = Base::File::open(path, false);
+  if (!file_opt || !file_opt->is_open()) return std::nullopt;
+  auto content_opt = file_opt->read();
+  if (!content_opt) return std::nullopt;
+  std::string_view data = content_opt.value();
+
+  // 只处理 64 位小端
+  if (data.size() < sizeof(Elf64_Ehdr) || memcmp(data.data(), ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64)
+  {
+    LOG_WARNING("{} 不是 64 位 ELF 文件", path);
+    return std::nullopt;
+  }
+  const auto* ehdr = reinterpret_cast<const Elf64_Ehdr*>(data.data());
+  auto in_file = [&data](uint64_t offset, uint64_t size) { return offset <= data.size() && size <= data.size() - offset; };
+
+  // 模块基址对应最低 PT_LOAD 段所在的页
+  uint64_t load_bias = UINT64_MAX;
+  if (in_file(ehdr->e_phoff, static_cast<uint64_t>(ehdr->e_phnum) * sizeof(Elf64_Phdr)))
+  {
+    const auto* phdrs = reinterpret_cast<const Elf64_Phdr*>(data.data() + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; ++i)
+    {
+      if (phdrs[i].p_type == PT_LOAD)
+        load_bias = std::min(load_bias, align_page_down(phdrs[i].p_vaddr));
+    }
+  }
+  if (load_bias == UINT64_MAX) return std::nullopt;
+
+  if (!in_file(ehdr->e_shoff, static_cast<uint64_t>(ehdr->e_shnum) * sizeof(Elf64_Shdr)))
+    return std::nullopt;
+  const auto* shdrs = reinterpret_cast<const Elf64_Shdr*>(data.data() + ehdr->e_shoff);
+  for (int i = 0; i < ehdr->e_shnum; ++i)
+  {
+    const Elf64_Shdr& symtab = shdrs[i];
+    if ((symtab.sh_type != SHT_SYMTAB && symtab.sh_type != SHT_DYNSYM) || symtab.sh_link >= ehdr->e_shnum) continue;
+    const Elf64_Shdr& strtab = shdrs[symtab.sh_link];
+    if (!in_file(symtab.sh_offset, symtab.sh_size) || !in_file(strtab.sh_offset, strtab.sh_size)) continue;
+
+    const auto* symbols = reinterpret_cast<const Elf64_Sym*>(data.data() + symtab.sh_offset);
+    std::string_view strings(data.data() + strtab.sh_offset, strtab.sh_size);
+    for (size_t index = 0; index < symtab.sh_size / sizeof(Elf64_Sym); ++index)
+    {
+      const Elf64_Sym& symbol = symbols[index];
+      if (symbol.st_value == 0 || symbol.st_name >= strings.size()) continue;
+      std::string_view symbol_name = strings.substr(symbol.st_name);
+      symbol_name = symbol_name.substr(0, symbol_name.find('\0'));
+      if (symbol_name == name)
+        return symbol.st_value - load_bias;
+    }
+  }
+  return std::nullopt;
+}
+
 }
@@ -5,6 +5,8 @@
 #include <sys/ptrace.h>
 #include <sys/wait.h>
 #include <dirent.h>
+#include <optional>
+#include <string>
 #include <unistd.h>
 
 #include "log.hpp"
@@ -64,6 +66,14 @@ bool ptrace_wrapper(int request, pid_t pid, void *address, void* data, size_t da
  */
 pid_t waitpid_wrapper(pid_t pid, int* status, int __options);
 
+// 屏蔽 SIGCHLD 并创建 signalfd, 被跟踪线程的每次状态变化都会让它可读
+// 必须在创建其他线程之前由主线程调用, 否则 SIGCHLD 可能被没有屏蔽它的线程按默认动作丢弃
+void block_child_signal();
+
+// 阻塞到收到 SIGCHLD 或超时, 返回是否收到; 调用前先用 WNOHANG 取完已有的事件
+// 没有调用过 block_child_signal 时最多等待 10 毫秒
+bool wait_child_signal(int timeout_ms);
+
 long get_page_size();
 
 // 对齐函数
@@ -227,5 +237,8 @@ std::optional<std::string> num_to_hex_str(T num, bool with_prefix = true)
 // 去除收尾空白字符
 std::string trim(const std::string& s);
 
+// 在 ELF 文件的 .symtab / .dynsym 中查找符号, 返回相对于最低 PT_LOAD 段的偏移, 加上模块基址就是运行时地址
+std::optional<uint64_t> find_elf_symbol(const std::string& path, const std::string& name);
+
 }
 
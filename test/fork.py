@@ -0,0 +1,94 @@
+from rpc_client import RPCClient
+import argparse
+import json
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    # 目标需要在运行中 fork 子进程, 子进程再 exec, 例如在 app 中调用 Runtime.exec
+    parser.add_argument("-t", "--target", default="com.example.andbgtest")
+    parser.add_argument("-w", "--wait", type=int, default=30, help="等待 fork 的秒数")
+    args = parser.parse_args()
+
+    # 配置服务器地址
+    SERVER_IP = "127.0.0.1"
+    SERVER_PORT = 5073
+
+    client = RPCClient(SERVER_IP, SERVER_PORT)
+
+    if not client.connect():
+        return
+
+    try:
+        print("\n附加父进程:")
+        response = client.send_command("attach", {"target": args.target})
+        print(f"服务器响应: {response}")
+
+        print("\n子进程保持跟踪, exec 之后暂停:")
+        response = client.send_command("set_follow_policy", {"fork": "keep", "stop_on_exec": True})
+        print(f"服务器响应: {response}")
+
+        response = client.send_command("resume")
+        print(f"服务器响应: {response}")
+
+        # 等待父进程 fork
+        print("\n等待 fork:")
+        children = []
+        deadline = time.time() + args.wait
+        while time.time() < deadline and not children:
+            response = client.send_command("wait_event", {"timeout": 1000})
+            print(f"服务器响应: {response}")
+
+            response = client.send_command("get_fork_children")
+            try:
+                children = json.loads(response)
+            except (TypeError, ValueError):
+                children = []
+
+            # 停在断点或信号上时继续运行父进程
+            if not children:
+                client.send_command("resume")
+
+        if not children:
+            print("没有等到子进程")
+            return
+        print(f"保持跟踪的子进程: {children}")
+
+        # 子进程交给新会话, 父进程所在的会话不变
+        print("\n接管子进程:")
+        response = client.send_command("adopt_fork_child", {"pid": children[0]})
+        print(f"服务器响应: {response}")
+        child_session = json.loads(response)["session"]
+
+        response = client.send_command("list_sessions")
+        print(f"服务器响应: {response}")
+
+        # 子进程 exec 后暂停, 事件属于子进程的会话
+        print("\n等待子进程 exec:")
+        response = client.send_command("select_session", {"session": child_session})
+        print(f"服务器响应: {response}")
+        response = client.send_command("resume")
+        print(f"服务器响应: {response}")
+        response = client.send_command("wait_event", {"timeout": 5000})
+        print(f"服务器响应: {response}")
+
+        response = client.send_command("get_thread_infos")
+        print(f"服务器响应: {response}")
+
+        print("\n分离子进程:")
+        response = client.send_command("detach")
+        print(f"服务器响应: {response}")
+
+        response = client.send_command("list_sessions")
+        print(f"服务器响应: {response}")
+
+        print("\n分离父进程:")
+        response = client.send_command("detach")
+        print(f"服务器响应: {response}")
+
+    finally:
+        client.disconnect()
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,121 @@
+from rpc_client import RPCClient
+import argparse
+import json
+
+# BreakpointType
+HARDWARE_WRITE = 3
+HARDWARE_READWRITE = 4
+
+
+def find_breakpoint(client, address):
+    response = client.send_command("get_breakpoints")
+    try:
+        for breakpoint in json.loads(response):
+            if breakpoint["address"] == address:
+                return breakpoint
+    except (TypeError, ValueError):
+        pass
+    return None
+
+
+def find_data_address(client):
+    # 默认观察 libc 的可写数据段, 进程中的线程会频繁访问
+    response = client.send_command("get_memory_regions")
+    try:
+        regions = json.loads(response)
+    except (TypeError, ValueError):
+        return None
+    for region in regions:
+        if region["permissions"].startswith("rw") and region["pathname"].endswith("libc.so"):
+            return region["start_address"]
+    return None
+
+
+def wait_hit(client, address, wait):
+    response = client.send_command("resume")
+    print(f"服务器响应: {response}")
+    response = client.send_command("wait_event", {"timeout": wait * 1000})
+    print(f"服务器响应: {response}")
+
+    breakpoint = find_breakpoint(client, address)
+    print(f"观察点: {breakpoint}")
+    return breakpoint
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-t", "--target", default="com.example.andbgtest")
+    parser.add_argument("-a", "--address", type=lambda value: int(value, 0), help="观察的地址, 默认使用 libc 的数据段")
+    parser.add_argument("-w", "--wait", type=int, default=10, help="等待命中的秒数")
+    args = parser.parse_args()
+
+    # 配置服务器地址
+    SERVER_IP = "127.0.0.1"
+    SERVER_PORT = 5073
+
+    client = RPCClient(SERVER_IP, SERVER_PORT)
+
+    if not client.connect():
+        return
+
+    try:
+        response = client.send_command("attach", {"target": args.target})
+        print(f"服务器响应: {response}")
+
+        address = args.address if args.address is not None else find_data_address(client)
+        if address is None:
+            print("没有找到可写的数据段")
+            return
+        print(f"观察地址: 0x{address:x}")
+
+        # 硬件观察点: 8 字节以内, 观察点寄存器直接编码
+        print("\n硬件写观察点:")
+        response = client.send_command("set_watchpoint", {"type": HARDWARE_WRITE, "address": address, "length": 8})
+        print(f"服务器响应: {response}")
+        breakpoint = wait_hit(client, address, args.wait)
+        if breakpoint is not None:
+            response = client.send_command("remove_breakpoint", {"breakpoint_id": breakpoint["id"]})
+            print(f"服务器响应: {response}")
+
+        # 页保护观察点: 24 字节不能用观察点寄存器编码, 改用页保护
+        print("\n页保护读写观察点:")
+        page_address = address + 0x40
+        response = client.send_command("set_watchpoint", {"type": HARDWARE_READWRITE, "address": page_address, "length": 24})
+        print(f"服务器响应: {response}")
+
+        # 忽略前 2 次命中, 由事件循环直接放行
+        breakpoint = find_breakpoint(client, page_address)
+        if breakpoint is not None:
+            response = client.send_command("set_ignore_count", {"breakpoint_id": breakpoint["id"], "count": 2})
+            print(f"服务器响应: {response}")
+
+        breakpoint = wait_hit(client, page_address, args.wait)
+
+        # 同一页上观察范围之外的访问也会缺页, 只计入 faults, 不算命中
+        response = client.send_command("get_page_watch_stats")
+        print(f"服务器响应: {response}")
+        try:
+            for stat in json.loads(response):
+                false_positives = stat["faults"] - stat["hits"]
+                print(f"页 0x{stat['page']:x}: 缺页 {stat['faults']} 次, 命中 {stat['hits']} 次, 误报 {false_positives} 次")
+                if false_positives < 0:
+                    print("错误: 命中次数超过缺页次数")
+        except (TypeError, ValueError):
+            print("解析页保护统计失败")
+
+        if breakpoint is not None:
+            response = client.send_command("remove_breakpoint", {"breakpoint_id": breakpoint["id"]})
+            print(f"服务器响应: {response}")
+
+        # 移除后页权限恢复, 统计清空
+        response = client.send_command("get_page_watch_stats")
+        print(f"服务器响应: {response}")
+
+        response = client.send_command("detach")
+        print(f"服务器响应: {response}")
+
+    finally:
+        client.disconnect()
+
+if __name__ == "__main__":
+    main()